@@ -131,11 +131,11 @@ disk_format_t applix_disk_format[] =
 };
 
 extern char *no_dsk_ptrackids[];
-extern FILE *infof;
-extern DSK_PDRIVER idrive;
-extern DSK_GEOMETRY dg;
-extern disk_t disk;
-extern xdg_t xdg;
+extern SESSION_LOCAL FILE *infof;
+extern SESSION_LOCAL DSK_PDRIVER idrive;
+extern SESSION_LOCAL DSK_GEOMETRY dg;
+extern SESSION_LOCAL disk_t disk;
+extern SESSION_LOCAL xdg_t xdg;
 
 #if 0
 //==============================================================================
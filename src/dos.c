@@ -81,6 +81,7 @@
 #include "dos.h"
 #include "ubeedisk.h"
 #include "functions.h"
+#include "simdrive.h"
 
 //==============================================================================
 // structures and variables
@@ -190,15 +191,15 @@ static char *dos_names[] =
  "msxdos"
 };
 
-static char msxdos2_vs[7];
+static SESSION_LOCAL char msxdos2_vs[7];
 
 extern char *no_dsk_ptrackids[];
-extern FILE *infof;
-extern DSK_PDRIVER idrive;
-extern DSK_GEOMETRY dg;
-extern disk_t disk;
-extern xdg_t xdg;
-extern dg_opts_t dg_opts;
+extern SESSION_LOCAL FILE *infof;
+extern SESSION_LOCAL DSK_PDRIVER idrive;
+extern SESSION_LOCAL DSK_GEOMETRY dg;
+extern SESSION_LOCAL disk_t disk;
+extern SESSION_LOCAL xdg_t xdg;
+extern SESSION_LOCAL dg_opts_t dg_opts;
 
 //==============================================================================
 // Detect failure message.
@@ -427,7 +428,7 @@ int dos_detect_format (void)
                  printf("dr=%d drive type=%c dg.dg_datarate=%d dg.dg_fm=%d\n",
                  dr, disk.idrive_type, dg.dg_datarate, dg.dg_fm);
 #endif
-                 dsk_err = dsk_psecid(idrive, &dg, 0, 0, &sector_id);
+                 dsk_err = sim_psecid(idrive, &dg, 0, 0, &sector_id);
 
                  if (! dsk_err)
                     break;
@@ -437,7 +438,7 @@ int dos_detect_format (void)
             {
              // check a single datarate
              dg.dg_datarate = xdg.dg_idatarate;
-             dsk_err = dsk_psecid(idrive, &dg, 0, 0, &sector_id);
+             dsk_err = sim_psecid(idrive, &dg, 0, 0, &sector_id);
             }
 
          if (! dsk_err)
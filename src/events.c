@@ -0,0 +1,477 @@
+//******************************************************************************
+//*                                 uBeeDisk                                   *
+//*                                                                            *
+//*     A tool for converting disks/images from one to another with auto       *
+//*                   detection options for Microbee disks.                    *
+//*                                                                            *
+//*                               events module                                *
+//*                                                                            *
+//*                       Copyright (C) 2008-2026 uBee                         *
+//******************************************************************************
+//
+// JSON lines event stream (--events).
+//
+// Each event is one JSON object on a line written to a file descriptor or
+// a file for a supervising program to follow.  Every object starts with the
+// time in milliseconds since the epoch ("ts"), the process ID ("pid") and
+// the event name ("event"), a "pair" number is added for events from a
+// --pair thread.
+//
+// Events are placed in a ring buffer and written out by a separate writer
+// thread so that a slow reader can never hold up the disk reads.  If the
+// ring fills the events are dropped and a "dropped" event with the count
+// is placed before the next event that fits.  Lines are written in whole
+// lines of no more than PIPE_BUF bytes where possible so that the events
+// of several processes (--batch) sharing a pipe are not mixed together.
+//
+// Under Windows the events are written directly.
+//
+//==============================================================================
+// ChangeLog (most recent entries are at top)
+//==============================================================================
+// v4.1.0 - 17 October 2026, uBee
+// - Initial file created.
+//==============================================================================
+/*
+ *  uBeeDisk - A tool for converting disks/images from one to another with
+ *  auto detection options for Microbee disks.
+ *  Copyright (C) 2008-2026 uBee
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+//==============================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#ifdef WIN32
+#include <io.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#include <signal.h>
+#include <limits.h>
+#include <pthread.h>
+#endif
+
+#include <libdsk.h>
+
+#include "events.h"
+#include "ubeedisk.h"
+#include "functions.h"
+
+//==============================================================================
+// structures and variables
+//==============================================================================
+#ifndef PIPE_BUF
+#define PIPE_BUF 512
+#endif
+
+static int events_fd = -1;
+static int events_close_fd;
+static int events_broken;
+
+static SESSION_LOCAL int events_pair;
+
+#ifndef WIN32
+static char events_ring[EVENTS_RING_SIZE];
+static int events_head;          // next byte to be added
+static int events_tail;          // next byte to be written
+static int events_used;
+static long events_dropped;
+static int events_quit;
+static int events_running;       // the writer thread has been started
+static pid_t events_pid;         // process the writer thread belongs to
+static pthread_t events_thread;
+static pthread_mutex_t events_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t events_cond = PTHREAD_COND_INITIALIZER;
+static int events_atfork;
+#endif
+
+//==============================================================================
+// Write a buffer to the events file descriptor.
+//
+//   pass: char *s
+//         int len
+// return: void
+//==============================================================================
+static void events_write (char *s, int len)
+{
+ int res;
+
+ while (len > 0 && ! events_broken)
+    {
+     res = write(events_fd, s, len);
+     if (res < 0)
+        {
+         if (errno == EINTR)
+            continue;
+         // the reader has gone away, the events are discarded from now on
+         events_broken = 1;
+         break;
+        }
+     s += res;
+     len -= res;
+    }
+}
+
+#ifndef WIN32
+//==============================================================================
+// Events writer thread.
+//
+// Takes whole lines from the ring and writes them out.  The ring is left
+// unlocked while writing so events can still be added.
+//
+//   pass: void *arg                    not used
+// return: void *                       NULL
+//==============================================================================
+static void *events_writer (void *arg)
+{
+ char buf[EVENTS_LINE_SIZE + PIPE_BUF];
+ int len;
+ int end;
+ int i;
+
+ pthread_mutex_lock(&events_mutex);
+ for (;;)
+    {
+     while (! events_used && ! events_quit)
+        pthread_cond_wait(&events_cond, &events_mutex);
+     if (! events_used)
+        break;
+
+     // copy out whole lines up to PIPE_BUF bytes, stopping at the end of
+     // the last line that fits.  A line longer than PIPE_BUF is taken on
+     // it's own
+     len = 0;
+     end = 0;
+     for (i = 0; i < events_used && i < (int)sizeof(buf); i++)
+        {
+         if (end && i >= PIPE_BUF)
+            break;
+         buf[i] = events_ring[(events_tail + i) % EVENTS_RING_SIZE];
+         if (buf[i] == '\n')
+            {
+             end = i + 1;
+             if (end >= PIPE_BUF)
+                break;
+            }
+        }
+     len = end? end : i;
+     events_tail = (events_tail + len) % EVENTS_RING_SIZE;
+     events_used -= len;
+     pthread_mutex_unlock(&events_mutex);
+
+     events_write(buf, len);
+
+     pthread_mutex_lock(&events_mutex);
+    }
+ pthread_mutex_unlock(&events_mutex);
+
+ return NULL;
+}
+
+//==============================================================================
+// Fork handlers.
+//
+// The ring is locked across a fork so a child never gets it in a locked
+// state.  A child (--batch worker) starts with an empty ring and starts
+// it's own writer thread when it adds it's first event.
+//
+//   pass: void
+// return: void
+//==============================================================================
+static void events_fork_prepare (void)
+{
+ pthread_mutex_lock(&events_mutex);
+}
+
+static void events_fork_parent (void)
+{
+ pthread_mutex_unlock(&events_mutex);
+}
+
+static void events_fork_child (void)
+{
+ events_head = 0;
+ events_tail = 0;
+ events_used = 0;
+ events_dropped = 0;
+ events_running = 0;
+ events_quit = 0;
+ pthread_mutex_unlock(&events_mutex);
+}
+
+//==============================================================================
+// Add a line to the ring.
+//
+// The writer thread is started if this process hasn't got one yet.
+//
+//   pass: char *s                      line to add
+//         int len
+// return: void
+//==============================================================================
+static void events_put (char *s, int len)
+{
+ char drop[100];
+ int dlen = 0;
+ int i;
+
+ pthread_mutex_lock(&events_mutex);
+
+ if (! events_running || events_pid != getpid())
+    {
+     events_pid = getpid();
+     events_quit = 0;
+     if (pthread_create(&events_thread, NULL, events_writer, NULL) != 0)
+        {
+         pthread_mutex_unlock(&events_mutex);
+         events_write(s, len);
+         return;
+        }
+     events_running = 1;
+    }
+
+ if (events_dropped)
+    dlen = snprintf(drop, sizeof(drop), "{\"ts\":%llu,\"pid\":%d,\"event\":"
+    "\"dropped\",\"count\":%ld}\n", (unsigned long long)time_get_ms(),
+    (int)getpid(), events_dropped);
+
+ if (events_used + dlen + len > EVENTS_RING_SIZE)
+    events_dropped++;
+ else
+    {
+     for (i = 0; i < dlen; i++)
+        {
+         events_ring[events_head] = drop[i];
+         events_head = (events_head + 1) % EVENTS_RING_SIZE;
+        }
+     for (i = 0; i < len; i++)
+        {
+         events_ring[events_head] = s[i];
+         events_head = (events_head + 1) % EVENTS_RING_SIZE;
+        }
+     events_used += dlen + len;
+     events_dropped = 0;
+     pthread_cond_signal(&events_cond);
+    }
+
+ pthread_mutex_unlock(&events_mutex);
+}
+#endif
+
+//==============================================================================
+// Open the events stream.
+//
+// The value is either a file descriptor number already opened by the
+// supervising program or a file name (a named pipe may be used).
+//
+//   pass: char *spec                   file descriptor number or file name
+// return: int                          0 if no error, else -1
+//==============================================================================
+int events_open (char *spec)
+{
+ char *p;
+ long fd;
+
+ fd = strtol(spec, &p, 10);
+ if (*spec && ! *p)
+    {
+     events_fd = (int)fd;
+     events_close_fd = 0;
+    }
+ else
+    {
+     events_fd = open(spec, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+     events_close_fd = 1;
+    }
+
+ if (events_fd < 0)
+    {
+     printf(APPNAME": unable to open events output '%s'\n", spec);
+     events_fd = -1;
+     return -1;
+    }
+
+#ifndef WIN32
+ // a reader that goes away must not terminate the program
+ signal(SIGPIPE, SIG_IGN);
+ if (! events_atfork)
+    {
+     pthread_atfork(events_fork_prepare, events_fork_parent,
+     events_fork_child);
+     events_atfork = 1;
+    }
+#endif
+
+ return 0;
+}
+
+//==============================================================================
+// Close the events stream.
+//
+// All events in the ring are written out before returning.  This is also
+// called by a --batch worker process before it exits.
+//
+//   pass: void
+// return: void
+//==============================================================================
+void events_close (void)
+{
+ if (events_fd == -1)
+    return;
+
+#ifndef WIN32
+ pthread_mutex_lock(&events_mutex);
+ if (events_running && events_pid == getpid())
+    {
+     events_quit = 1;
+     pthread_cond_signal(&events_cond);
+     pthread_mutex_unlock(&events_mutex);
+     pthread_join(events_thread, NULL);
+     pthread_mutex_lock(&events_mutex);
+     events_running = 0;
+
+     // events dropped since the last one that fitted are still reported
+     if (events_dropped)
+        {
+         char drop[100];
+         int dlen;
+
+         dlen = snprintf(drop, sizeof(drop), "{\"ts\":%llu,\"pid\":%d,"
+         "\"event\":\"dropped\",\"count\":%ld}\n",
+         (unsigned long long)time_get_ms(), (int)getpid(), events_dropped);
+         events_write(drop, dlen);
+         events_dropped = 0;
+        }
+    }
+ pthread_mutex_unlock(&events_mutex);
+#endif
+
+ if (events_close_fd)
+    close(events_fd);
+ events_fd = -1;
+}
+
+//==============================================================================
+// Test if events are being output.
+//
+//   pass: void
+// return: int                          1 if active
+//==============================================================================
+int events_active (void)
+{
+ return events_fd != -1 && ! events_broken;
+}
+
+//==============================================================================
+// Set the drive pair number added to the events of the calling thread.
+//
+//   pass: int pair                     pair number, 0 for none
+// return: void
+//==============================================================================
+void events_set_pair (int pair)
+{
+ events_pair = pair;
+}
+
+//==============================================================================
+// Emit an event.
+//
+// The fields are passed as printf() style JSON members without the braces,
+// i.e. "\"cyl\":%d,\"head\":%d".  Strings must be quoted with event_str().
+// If the fields don't fit in a line they are replaced with "truncated":true
+// so that the line is still valid JSON.
+//
+//   pass: char *name                   event name
+//         char *fmt, ...               event fields or NULL
+// return: void
+//==============================================================================
+void event_emit (char *name, char *fmt, ...)
+{
+ char s[EVENTS_LINE_SIZE];
+ va_list ap;
+ int len;
+ int res;
+
+ if (! events_active())
+    return;
+
+ len = snprintf(s, sizeof(s), "{\"ts\":%llu,\"pid\":%d,\"event\":\"%s\"",
+ (unsigned long long)time_get_ms(), (int)getpid(), name);
+ if (events_pair)
+    len += snprintf(s + len, sizeof(s) - len, ",\"pair\":%d", events_pair);
+
+ if (fmt && *fmt)
+    {
+     s[len] = ',';
+     va_start(ap, fmt);
+     res = vsnprintf(s + len + 1, sizeof(s) - len - 4, fmt, ap);
+     va_end(ap);
+     if (res < 0 || res >= (int)sizeof(s) - len - 4)
+        len += sprintf(s + len, ",\"truncated\":true");
+     else
+        len += res + 1;
+    }
+ s[len++] = '}';
+ s[len++] = '\n';
+ s[len] = 0;
+
+#ifdef WIN32
+ events_write(s, len);
+#else
+ events_put(s, len);
+#endif
+}
+
+//==============================================================================
+// Quote a string for use in an event.
+//
+// The string is placed in quotes with any characters that JSON requires
+// escaped.
+//
+//   pass: char *s                      string
+//         char *buf                    buffer for the quoted string
+//         int size                     size of buf
+// return: char *                       buf
+//==============================================================================
+char *event_str (char *s, char *buf, int size)
+{
+ unsigned char c;
+ int len = 0;
+
+ buf[len++] = '"';
+ while ((c = *s++) && len < size - 8)
+    {
+     if (c == '"' || c == '\\')
+        {
+         buf[len++] = '\\';
+         buf[len++] = c;
+        }
+     else if (c < 0x20)
+        len += sprintf(buf + len, "\\u%04x", c);
+     else
+        buf[len++] = c;
+    }
+ buf[len++] = '"';
+ buf[len] = 0;
+
+ return buf;
+}
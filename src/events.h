@@ -0,0 +1,17 @@
+/* Events header */
+
+#ifndef HEADER_EVENTS_H
+#define HEADER_EVENTS_H
+
+#define EVENTS_RING_SIZE 65536
+#define EVENTS_LINE_SIZE 4096
+
+int events_open (char *spec);
+void events_close (void);
+int events_active (void);
+void events_set_pair (int pair);
+void event_emit (char *name, char *fmt, ...)
+                __attribute__ ((format (printf, 2, 3)));
+char *event_str (char *s, char *buf, int size);
+
+#endif     /* HEADER_EVENTS_H */
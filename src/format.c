@@ -14,6 +14,10 @@
 //==============================================================================
 // ChangeLog (most recent entries are at top)
 //==============================================================================
+// v4.1.0 - 17 October 2026, uBee
+// - Added format_enum() for the --disk=bench process.
+// - The input drive reads use the sim_*() calls for the 'sim' input type.
+//
 // v4.0.0 - 25 January 2017, uBee
 // - Added GAP set and erase values to format_set_geometry().
 // - Added a ATTR_CACHER_OFF and ATTR_CACHEW_OFF option to the
@@ -100,6 +104,7 @@
 #include "format.h"
 #include "ubeedisk.h"
 #include "functions.h"
+#include "simdrive.h"
 
 #include "microbee.h"
 #include "applix.h"
@@ -107,8 +112,8 @@
 #include "fm.h"
 #include "various.h"
 
-extern sup_t input_sup;
-extern sup_t output_sup;
+extern SESSION_LOCAL sup_t input_sup;
+extern SESSION_LOCAL sup_t output_sup;
 
 extern disk_format_t microbee_disk_format[];
 extern disk_format_t applix_disk_format[];
@@ -116,10 +121,10 @@ extern disk_format_t dos_disk_format[];
 extern disk_format_t fm_disk_format[];
 extern disk_format_t various_disk_format[];
 
-extern DSK_PDRIVER idrive;
-extern DSK_GEOMETRY dg;
-extern disk_t disk;
-extern xdg_t xdg;
+extern SESSION_LOCAL DSK_PDRIVER idrive;
+extern SESSION_LOCAL DSK_GEOMETRY dg;
+extern SESSION_LOCAL disk_t disk;
+extern SESSION_LOCAL xdg_t xdg;
 
 //==============================================================================
 // structures and variables.
@@ -149,6 +154,16 @@ static disk_format_t *disk_formats[] =
  NULL
 };
 
+// --detect value for the formats in each disk_formats[] table
+static char *disk_formats_detect[] =
+{
+ "mbee",
+ "applix",
+ "dos",
+ "fm",
+ "various"
+};
+
 //==============================================================================
 // get drive ready.
 //
@@ -175,7 +190,7 @@ static void get_drive_ready (void)
 
  // some drives need this or the disk head won't get positioned and we end
  // up with no data error! (must be before close_reopen_pc_floppy_input_drive())
- dsk_err = dsk_psecid(idrive, &dg, 0, 0, &sector_id);
+ dsk_err = sim_psecid(idrive, &dg, 0, 0, &sector_id);
 
  // must close/reopen the input drive and restore settings if PC floppy
  close_reopen_pc_floppy_input_drive();
@@ -188,7 +203,7 @@ static void get_drive_ready (void)
 
  // don't use close_reopen_pc_floppy_input_drive() here! instead just
  // use a delay or the head will try to home constantly.
- sleep_ms(3000);
+ sim_sleep_ms(3000);
 }
 
 //==============================================================================
@@ -238,7 +253,7 @@ dsk_err_t read_sector_ids (int cyl, int head, int secsize, int *sizeok,
     dsk_err = DSK_ERR_NOTIMPL;
  else
     // read cylinder n, side n of the disk
-    dsk_err = dsk_ptrackids(idrive, &dg, cyl, head, count, &result);
+    dsk_err = sim_ptrackids(idrive, &dg, cyl, head, count, &result);
 
  if (dsk_err == DSK_ERR_NOTIMPL)
     {
@@ -295,11 +310,11 @@ dsk_err_t read_physical_sector (dsk_pcyl_t cyl, dsk_pcyl_t xcyl,
 
  get_drive_ready();
 
- dsk_err = dsk_xread(idrive, &dg, buffer, cyl, head, xcyl, xhead, psect,
+ dsk_err = sim_xread(idrive, &dg, buffer, cyl, head, xcyl, xhead, psect,
  dg.dg_secsize, NULL);
  
  if (dsk_err == DSK_ERR_NOTIMPL)
-    dsk_err = dsk_pread(idrive, &dg, buffer, cyl, head, psect);
+    dsk_err = sim_pread(idrive, &dg, buffer, cyl, head, psect);
 
  return dsk_err;
 }
@@ -441,6 +456,33 @@ void format_list_formats (void)
     printf("%-20.20s : %s\n", fname, fdesc);
 }
 
+//==============================================================================
+// Enumerate the built in disk formats.
+//
+//   pass: int n                        format number from 0
+//         char **detect                --detect value for the format
+// return: disk_format_t *              format, NULL if no more
+//==============================================================================
+disk_format_t *format_enum (int n, char **detect)
+{
+ disk_format_t *disk_format;
+ int i = 0;
+ int f;
+
+ while ((disk_format = disk_formats[i]))
+    {
+     for (f = 0; disk_format[f].name[0] != 0; f++)
+        if (n-- == 0)
+           {
+            *detect = disk_formats_detect[i];
+            return &disk_format[f];
+           }
+     i++;
+    }
+
+ return NULL;
+}
+
 //==============================================================================
 // List all disk types.
 //
@@ -78,6 +78,7 @@ dsk_err_t read_physical_sector (dsk_pcyl_t cyl, dsk_pcyl_t xcyl,
                                 int psect, uint8_t *buffer);
 int format_set_geometry (disk_format_t *disk_format);
 void format_list_formats (void);
+disk_format_t *format_enum (int n, char **detect);
 void format_list_types (void);
 int format_detect_disk (void);
 int format_set (char *format_id, int report);
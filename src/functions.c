@@ -14,6 +14,16 @@
 //==============================================================================
 // ChangeLog (most recent entries are at top)
 //==============================================================================
+// v4.1.0 - 17 October 2026, uBee
+// - Added time_get_ns() monotonic clock function.
+// - Added key_pending() and a key watcher thread so the copy loops only
+//   test a flag instead of calling get_key() for every sector.
+// - printfx() now serialises output from several threads.  Added
+//   console_lock(), console_unlock(), console_set_prefix() and
+//   console_set_clear() for sharing the console between drive threads.
+// - create_md5() now maps the file into memory and hashes it in place,
+//   added md5_hex().
+//
 // v4.0.0 - 25 January 2017, uBee
 // - Added endian support functions.
 // - Added get_colon_arguments(), get_gap_colon_arguments() and
@@ -88,6 +98,11 @@
 #include <termios.h>
 #include <sys/types.h>  // various type definitions, like pid_t
 #include <sys/time.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include <poll.h>
 #endif
 
 #ifdef __linux__
@@ -107,8 +122,21 @@
 //==============================================================================
 #ifdef WIN32
 #else
- static struct timeval tod;
  struct termios term, tOrg;
+
+// console output is shared by all threads
+static pthread_mutex_t console_mutex = PTHREAD_MUTEX_INITIALIZER;
+static void (*console_clear)(void);
+static SESSION_LOCAL char console_prefix[20];
+static SESSION_LOCAL int console_midline;
+
+// key watcher, key_watch_state is 0 not started, 1 running, -1 not used
+static pthread_t key_thread;
+static pthread_mutex_t key_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t key_cond = PTHREAD_COND_INITIALIZER;
+static volatile int key_ready;
+static int key_watch_quit;
+static int key_watch_state;
 #endif
 
 //==============================================================================
@@ -265,7 +293,91 @@ int get_key (void)
     return getch();
  return -1;
 }
+
+//==============================================================================
+// Test if a key may be waiting.
+//
+// kbhit() is cheap under Windows so get_key() is always tried.
+//
+//   pass: void
+// return: int                          1 if get_key() should be called
+//==============================================================================
+int key_pending (void)
+{
+ return 1;
+}
 #else
+//==============================================================================
+// Key watcher thread.
+//
+// Waits for stdin to become readable and sets key_ready.  Nothing is read
+// so the key is still there for get_key() or a prompt, the thread waits
+// until get_key() has been called before looking again.
+//
+//   pass: void *arg                    not used
+// return: void *                       NULL
+//==============================================================================
+static void *key_watch_thread (void *arg)
+{
+ struct pollfd pfd;
+ int res;
+
+ pfd.fd = fileno(stdin);
+ pfd.events = POLLIN;
+
+ pthread_mutex_lock(&key_mutex);
+ while (! key_watch_quit)
+    {
+     if (key_ready)
+        {
+         pthread_cond_wait(&key_cond, &key_mutex);
+         continue;
+        }
+     pthread_mutex_unlock(&key_mutex);
+
+     // the timeout is only so that a request to quit is seen
+     res = poll(&pfd, 1, 200);
+
+     pthread_mutex_lock(&key_mutex);
+     if (res > 0)
+        key_ready = 1;
+    }
+ pthread_mutex_unlock(&key_mutex);
+
+ return NULL;
+}
+
+//==============================================================================
+// Test if a key may be waiting.
+//
+// This is called for every sector read so it must not make any system
+// calls.  A key watcher thread is started on the first call and only the
+// flag it sets is tested here.  If stdin is not a terminal (or the thread
+// can't be started) 1 is always returned and get_key() polls as before.
+//
+//   pass: void
+// return: int                          1 if get_key() should be called
+//==============================================================================
+int key_pending (void)
+{
+ if (key_watch_state == 0)
+    {
+     key_watch_state = -1;
+     if (isatty(fileno(stdin)))
+        {
+         // single key presses must be seen without waiting for ENTER
+         tcsetattr(fileno(stdin), TCSANOW, &term);
+         if (pthread_create(&key_thread, NULL, key_watch_thread, NULL) == 0)
+            key_watch_state = 1;
+        }
+    }
+
+ if (key_watch_state != 1)
+    return 1;
+
+ return key_ready;
+}
+
 //==============================================================================
 // get_key() function for standard Unix like systems.  This works in a
 // similar way as for the WIN32 method.
@@ -289,6 +401,16 @@ int get_key (void)
 
  while (getchar() != -1)
     ;
+ clearerr(stdin);
+
+ // let the key watcher look for the next key
+ if (key_watch_state == 1)
+    {
+     pthread_mutex_lock(&key_mutex);
+     key_ready = 0;
+     pthread_cond_signal(&key_cond);
+     pthread_mutex_unlock(&key_mutex);
+    }
     
  switch (ch)
     {
@@ -315,19 +437,103 @@ int printfx (char * fmt, ...)
  int res;
  va_list ap;
  char buffer[100000];
+ char *s;
+ char *e;
 
  va_start(ap, fmt);
  vsnprintf(buffer, sizeof(buffer)-1, fmt, ap);
  buffer[sizeof(buffer)-1] = 0;
  va_end(ap);
 
+ pthread_mutex_lock(&console_mutex);
+
  tcsetattr(fileno(stdin), TCSANOW, &tOrg);
- res = fprintf(stdout, "%s", buffer);
+
+ // remove any status display before the output goes over it
+ if (console_clear)
+    (*console_clear)();
+
+ if (! console_prefix[0])
+    res = fprintf(stdout, "%s", buffer);
+ else
+    {
+     // each new line of output from this thread is prefixed
+     res = 0;
+     for (s = buffer; *s; s = e)
+        {
+         if (! console_midline)
+            fputs(console_prefix, stdout);
+         if ((e = strchr(s, '\n')) != NULL)
+            e++;
+         else
+            e = s + strlen(s);
+         fwrite(s, e - s, 1, stdout);
+         console_midline = (e[-1] != '\n');
+         res += e - s;
+        }
+     fflush(stdout);
+    }
+
  tcsetattr(fileno(stdin), TCSANOW, &term);
 
+ pthread_mutex_unlock(&console_mutex);
+
  return res;
 }
 
+//==============================================================================
+// Lock the console for output.
+//
+// Used by code that writes a status display directly to stdout so that the
+// output from other threads can't be mixed in with it.
+//
+//   pass: void
+// return: void
+//==============================================================================
+void console_lock (void)
+{
+ pthread_mutex_lock(&console_mutex);
+}
+
+//==============================================================================
+// Unlock the console.
+//
+//   pass: void
+// return: void
+//==============================================================================
+void console_unlock (void)
+{
+ pthread_mutex_unlock(&console_mutex);
+}
+
+//==============================================================================
+// Set a prefix for each line printed by the calling thread.
+//
+//   pass: char *prefix                 prefix string, "" for none
+// return: void
+//==============================================================================
+void console_set_prefix (char *prefix)
+{
+ snprintf(console_prefix, sizeof(console_prefix), "%s", prefix);
+ console_midline = 0;
+}
+
+//==============================================================================
+// Set a function to remove a status display before printing.
+//
+// The function is called with the console locked and must write directly to
+// stdout and not use printf().
+//
+//   pass: void (*clear)(void)          clear function, NULL for none
+// return: void
+//==============================================================================
+void console_set_clear (void (*clear)(void))
+{
+ pthread_mutex_lock(&console_mutex);
+ console_clear = clear;
+ pthread_mutex_unlock(&console_mutex);
+}
+
 //==============================================================================
 // fgets() wrapper.
 //
@@ -369,6 +575,33 @@ void sleep_ms (int ms)
 #endif            
 }
 
+//==============================================================================
+// Get the monotonic clock time in nanoseconds.
+//
+// Unlike time_get_ms() this is not upset by changes to the system time so
+// it's used for measuring intervals.
+//
+//   pass: void
+// return: uint64_t                     number of nanoseconds
+//==============================================================================
+uint64_t time_get_ns (void)
+{
+#ifdef WIN32
+ LARGE_INTEGER count;
+ static LARGE_INTEGER freq;
+
+ if (! freq.QuadPart)
+    QueryPerformanceFrequency(&freq);
+ QueryPerformanceCounter(&count);
+ return (uint64_t)((double)count.QuadPart * 1000000000.0 / freq.QuadPart);
+#else
+ struct timespec ts;
+
+ clock_gettime(CLOCK_MONOTONIC, &ts);
+ return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
 //==============================================================================
 // Get the current clock time in milliseconds
 //
@@ -380,6 +613,8 @@ uint64_t time_get_ms (void)
 #ifdef WIN32
  return (uint64_t)clock();
 #else
+ struct timeval tod;
+
  gettimeofday(&tod, NULL);
  return (((uint64_t)tod.tv_sec * 1000) + ((uint64_t)tod.tv_usec / 1000));
 #endif
@@ -962,9 +1197,29 @@ void file_name_part (char *pathfile, char *filename)
  strcpy(filename, pathfile+i);
 }
 
+//==============================================================================
+// Convert an MD5 message digest to a hex string.
+//
+//   pass: uint8_t *resblock            16 byte MD5 digest
+//         char *md5                    pointer to a 33 byte buffer for MD5
+// return: void
+//==============================================================================
+void md5_hex (uint8_t *resblock, char *md5)
+{
+ int i;
+
+ for (i = 0; i < 16; i++)
+    sprintf(md5 + i * 2, "%02x", resblock[i]);
+ md5[32] = 0;
+}
+
 //==============================================================================
 // Create an MD5 message digest.
 //
+// The file is mapped into memory and hashed in place if possible so that it
+// is read once without being copied through a stdio buffer, otherwise it is
+// read as a stream.
+//
 //   pass: char *filename               file to create MD5 for
 //         char *md5                    pointer to a 33 byte buffer for MD5
 // return: void
@@ -973,17 +1228,39 @@ void create_md5 (char *filename, char *md5)
 {
  FILE *fp;
  uint8_t resblock[16];
- int i;
+#ifndef WIN32
+ struct stat st;
+ void *m;
+ int fd;
+#endif
 
  md5[0] = 0;
+
+#ifndef WIN32
+ fd = open(filename, O_RDONLY);
+ if (fd == -1)
+    return;
+ if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+     m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+     if (m != MAP_FAILED)
+        {
+         madvise(m, st.st_size, MADV_SEQUENTIAL);
+         md5_buffer(m, st.st_size, resblock);
+         munmap(m, st.st_size);
+         close(fd);
+         md5_hex(resblock, md5);
+         return;
+        }
+    }
+ close(fd);
+#endif
+
  fp = fopen(filename, "rb");
  if (fp)
     {
      if (md5_stream(fp, &resblock) == 0)
-        {
-         for (i = 0; i < 16; i++)
-            sprintf(md5, "%s%02x", md5, resblock[i]);
-        } 
+        md5_hex(resblock, md5);
      fclose(fp);        
     } 
 }
@@ -1271,6 +1548,17 @@ void functions_init (void)
 void functions_deinit (void)
 {
 #ifndef WIN32
+ // stop the key watcher
+ if (key_watch_state == 1)
+    {
+     pthread_mutex_lock(&key_mutex);
+     key_watch_quit = 1;
+     pthread_cond_signal(&key_cond);
+     pthread_mutex_unlock(&key_mutex);
+     pthread_join(key_thread, NULL);
+     key_watch_state = -1;
+    }
+
  // re-enable the original stdin values
  tcsetattr(fileno(stdin), TCSANOW, &tOrg);
 #endif
@@ -53,6 +53,7 @@ int64_t big_endian_64 (int64_t n);
 uint64_t big_endian_u64 (uint64_t n);
 
 int get_key (void);
+int key_pending (void);
 #ifdef WIN32
 char *strcasestr (char *haystack, char *needle);
 int strverscmp (const char *s1, const char *s2);
@@ -60,9 +61,14 @@ int strverscmp (const char *s1, const char *s2);
 extern int printfx (char * fmt, ...)
                 __attribute__ ((format (printf, 1, 2)));
 char *fgetsx(char *s, int size, FILE *stream);
+void console_lock (void);
+void console_unlock (void);
+void console_set_prefix (char *prefix);
+void console_set_clear (void (*clear)(void));
 #endif
 void sleep_ms (int ms);
 uint64_t time_get_ms (void);
+uint64_t time_get_ns (void);
 void toupper_string (char *dest, char *src);
 void tolower_string (char *dest, char *src);
 int string_search (char *strg_array[], char *strg_find);
@@ -76,6 +82,7 @@ int get_int_arguments (char *parms, int *p, int max_ent, int max_val);
 int get_colon_arguments (char *parms, int *p, int max_ent, int max_val);
 int get_gap_colon_arguments (char *parms, int *p, int max_ent, int max_val);
 void file_name_part (char *pathfile, char *filename);
+void md5_hex (uint8_t *resblock, char *md5);
 void create_md5 (char *filename, char *md5);
 int check_os_version (void);
 void reset_drive (char *xtype, char *xfile);
@@ -0,0 +1,453 @@
+//******************************************************************************
+//*                                 uBeeDisk                                   *
+//*                                                                            *
+//*     A tool for converting disks/images from one to another with auto       *
+//*                   detection options for Microbee disks.                    *
+//*                                                                            *
+//*                                hash module                                 *
+//*                                                                            *
+//*                       Copyright (C) 2008-2026 uBee                         *
+//******************************************************************************
+//
+// Message digests for output images.
+//
+// Several digests may be computed together from the one pass over the
+// data.  MD5 and SHA-256 are always available (md5.c and sha256.c), BLAKE3
+// and xxHash3 are available if ubeedisk is built with the BLAKE3 and
+// xxHash libraries (make BLAKE3=1 XXHASH=1).
+//
+// When a closed file is hashed it is mapped into memory and each digest is
+// computed by its own thread.  If the BLAKE3 library was built with oneTBB
+// (make BLAKE3_TBB=1) BLAKE3 also hashes the image on several cores using
+// its tree mode.
+//
+//==============================================================================
+// ChangeLog (most recent entries are at top)
+//==============================================================================
+// v4.1.0 - 17 October 2026, uBee
+// - Initial file created.
+//==============================================================================
+/*
+ *  uBeeDisk - A tool for converting disks/images from one to another with
+ *  auto detection options for Microbee disks.
+ *  Copyright (C) 2008-2026 uBee
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+//==============================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifndef WIN32
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+
+#include <libdsk.h>
+
+#include "hash.h"
+#include "ubeedisk.h"
+#include "functions.h"
+
+//==============================================================================
+// structures and variables
+//==============================================================================
+static char *hash_names[] =
+{
+ "md5",
+ "sha256",
+ "blake3",
+ "xxh3",
+ ""
+};
+
+// size of each digest in bytes
+static int hash_sizes[] =
+{
+ 16,
+ 32,
+ 32,
+ 8
+};
+
+#ifndef WIN32
+typedef struct hash_job_t
+{
+ pthread_t thread;
+ int alg;
+ const void *data;
+ size_t len;
+ hash_res_t res;
+} hash_job_t;
+#endif
+
+//==============================================================================
+// Return the name of a digest algorithm.
+//
+//   pass: int alg                      HASH_* value
+// return: char *                       name
+//==============================================================================
+char *hash_name (int alg)
+{
+ return hash_names[alg];
+}
+
+//==============================================================================
+// Determine if a digest algorithm is built in.
+//
+//   pass: int alg                      HASH_* value
+// return: int                          1 if available, else 0
+//==============================================================================
+int hash_available (int alg)
+{
+ switch (alg)
+    {
+     case HASH_MD5 :
+     case HASH_SHA256 :
+        return 1;
+#ifdef HAVE_BLAKE3
+     case HASH_BLAKE3 :
+        return 1;
+#endif
+#ifdef HAVE_XXHASH
+     case HASH_XXH3 :
+        return 1;
+#endif
+    }
+
+ return 0;
+}
+
+//==============================================================================
+// Parse a comma separated list of digest names.
+//
+//   pass: char *list                   list of digest names
+// return: int                          HASH_BIT() values, -1 if error
+//==============================================================================
+int hash_parse (char *list)
+{
+ char s[100];
+ int algs = 0;
+ int alg;
+ int x;
+
+ while (list)
+    {
+     list = get_next_parameter(list, ',', s, &x, sizeof(s)-1);
+     alg = string_search(hash_names, s);
+     if (alg == -1)
+        return -1;
+     if (! hash_available(alg))
+        {
+         printf(APPNAME": '%s' digest support was not built in.\n", s);
+         return -1;
+        }
+     algs |= HASH_BIT(alg);
+    }
+
+ return algs;
+}
+
+//==============================================================================
+// Initialise a digest context.
+//
+//   pass: hash_ctx_t *ctx
+//         int algs                     HASH_BIT() values
+// return: void
+//==============================================================================
+void hash_init (hash_ctx_t *ctx, int algs)
+{
+ ctx->algs = algs;
+
+ if (algs & HASH_BIT(HASH_MD5))
+    md5_init_ctx(&ctx->md5);
+ if (algs & HASH_BIT(HASH_SHA256))
+    sha256_init_ctx(&ctx->sha256);
+#ifdef HAVE_BLAKE3
+ if (algs & HASH_BIT(HASH_BLAKE3))
+    blake3_hasher_init(&ctx->blake3);
+#endif
+#ifdef HAVE_XXHASH
+ ctx->xxh3 = NULL;
+ if (algs & HASH_BIT(HASH_XXH3))
+    {
+     ctx->xxh3 = XXH3_createState();
+     if (ctx->xxh3)
+        XXH3_64bits_reset(ctx->xxh3);
+    }
+#endif
+}
+
+//==============================================================================
+// Add data to a digest context.
+//
+//   pass: hash_ctx_t *ctx
+//         const void *data             data
+//         size_t len                   length of data
+// return: void
+//==============================================================================
+void hash_update (hash_ctx_t *ctx, const void *data, size_t len)
+{
+ if (ctx->algs & HASH_BIT(HASH_MD5))
+    md5_process_bytes(data, len, &ctx->md5);
+ if (ctx->algs & HASH_BIT(HASH_SHA256))
+    sha256_process_bytes(data, len, &ctx->sha256);
+#ifdef HAVE_BLAKE3
+ if (ctx->algs & HASH_BIT(HASH_BLAKE3))
+    {
+#ifdef HAVE_BLAKE3_TBB
+     // large blocks are hashed on several cores
+     if (len >= FAST_COPY_BLOCK)
+        blake3_hasher_update_tbb(&ctx->blake3, data, len);
+     else
+#endif
+        blake3_hasher_update(&ctx->blake3, data, len);
+    }
+#endif
+#ifdef HAVE_XXHASH
+ if (ctx->xxh3)
+    XXH3_64bits_update(ctx->xxh3, data, len);
+#endif
+}
+
+//==============================================================================
+// Finish a digest context and return the digests as hex strings.
+//
+// Digests not selected are returned as empty strings.
+//
+//   pass: hash_ctx_t *ctx
+//         hash_res_t *res              digests returned here
+// return: void
+//==============================================================================
+void hash_final (hash_ctx_t *ctx, hash_res_t *res)
+{
+ uint8_t resblock[HASH_COUNT][32];
+ int alg;
+ int i;
+
+ if (ctx->algs & HASH_BIT(HASH_MD5))
+    md5_finish_ctx(&ctx->md5, resblock[HASH_MD5]);
+ if (ctx->algs & HASH_BIT(HASH_SHA256))
+    sha256_finish_ctx(&ctx->sha256, resblock[HASH_SHA256]);
+#ifdef HAVE_BLAKE3
+ if (ctx->algs & HASH_BIT(HASH_BLAKE3))
+    blake3_hasher_finalize(&ctx->blake3, resblock[HASH_BLAKE3], 32);
+#endif
+#ifdef HAVE_XXHASH
+ if (ctx->xxh3)
+    {
+     // canonical (big endian) form as shown by xxhsum
+     XXH64_hash_t h = XXH3_64bits_digest(ctx->xxh3);
+     for (i = 0; i < 8; i++)
+        resblock[HASH_XXH3][i] = h >> (56 - i * 8);
+     XXH3_freeState(ctx->xxh3);
+     ctx->xxh3 = NULL;
+    }
+ else
+    ctx->algs &= ~HASH_BIT(HASH_XXH3);
+#endif
+
+ for (alg = 0; alg < HASH_COUNT; alg++)
+    {
+     res->digest[alg][0] = 0;
+     if (ctx->algs & HASH_BIT(alg))
+        for (i = 0; i < hash_sizes[alg]; i++)
+           sprintf(res->digest[alg] + i * 2, "%02x", resblock[alg][i]);
+    }
+}
+
+#ifndef WIN32
+//==============================================================================
+// Digest thread, computes one digest of a memory block.
+//
+//   pass: void *arg                    hash_job_t
+// return: void *                       NULL
+//==============================================================================
+static void *hash_thread (void *arg)
+{
+ hash_job_t *j = arg;
+ hash_ctx_t ctx;
+
+ hash_init(&ctx, HASH_BIT(j->alg));
+ hash_update(&ctx, j->data, j->len);
+ hash_final(&ctx, &j->res);
+
+ return NULL;
+}
+#endif
+
+//==============================================================================
+// Compute the digests of a file.
+//
+// The file is mapped into memory if possible and each digest is computed
+// by its own thread, otherwise the file is read as a stream.
+//
+//   pass: char *filename               file to hash
+//         int algs                     HASH_BIT() values
+//         hash_res_t *res              digests returned here
+// return: int                          0 if no error, else -1
+//==============================================================================
+int hash_file (char *filename, int algs, hash_res_t *res)
+{
+ hash_ctx_t ctx;
+ uint8_t *fbuf;
+ size_t n;
+ FILE *fp;
+ int alg;
+
+ memset(res, 0, sizeof(hash_res_t));
+
+#ifndef WIN32
+ hash_job_t job[HASH_COUNT];
+ struct stat st;
+ void *m;
+ int fd;
+ int x;
+
+ fd = open(filename, O_RDONLY);
+ if (fd == -1)
+    return -1;
+ if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+     m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+     if (m != MAP_FAILED)
+        {
+         madvise(m, st.st_size, MADV_SEQUENTIAL);
+         for (alg = 0; alg < HASH_COUNT; alg++)
+            {
+             job[alg].alg = -1;
+             if (! (algs & HASH_BIT(alg)))
+                continue;
+             job[alg].alg = alg;
+             job[alg].data = m;
+             job[alg].len = st.st_size;
+             // the last digest is done by this thread
+             x = algs & ~(HASH_BIT(alg + 1) - 1);
+             if (x && pthread_create(&job[alg].thread, NULL, hash_thread,
+                &job[alg]) == 0)
+                continue;
+             hash_thread(&job[alg]);
+             job[alg].alg = -2;
+            }
+         for (alg = 0; alg < HASH_COUNT; alg++)
+            {
+             if (job[alg].alg == -1)
+                continue;
+             if (job[alg].alg >= 0)
+                pthread_join(job[alg].thread, NULL);
+             strcpy(res->digest[alg], job[alg].res.digest[alg]);
+            }
+         munmap(m, st.st_size);
+         close(fd);
+         return 0;
+        }
+    }
+ close(fd);
+#endif
+
+ if (! (fp = fopen(filename, "rb")))
+    return -1;
+ if (! (fbuf = malloc(FAST_COPY_BLOCK)))
+    {
+     fclose(fp);
+     return -1;
+    }
+
+ hash_init(&ctx, algs);
+ while ((n = fread(fbuf, 1, FAST_COPY_BLOCK, fp)) > 0)
+    hash_update(&ctx, fbuf, n);
+ hash_final(&ctx, res);
+
+ free(fbuf);
+ fclose(fp);
+
+ return 0;
+}
+
+//==============================================================================
+// Digest microbenchmark.
+//
+// Reports the speed of each digest that is built in using a block of
+// pseudo random data held in memory.  The MD5 used for the 'info' file up to
+// now is the base for comparison.
+//
+//   pass: void
+// return: void
+//==============================================================================
+void hash_bench (void)
+{
+ size_t size = 64 * 1048576;
+ hash_ctx_t ctx;
+ hash_res_t res;
+ uint64_t t;
+ uint64_t ms;
+ uint64_t md5_ms = 0;
+ uint32_t x = 0x12345678;
+ uint32_t *p;
+ uint8_t *data;
+ size_t i;
+ int alg;
+
+ if (! (data = malloc(size)))
+    {
+     printf(APPNAME": hash_bench() - unable to allocate memory\n");
+     return;
+    }
+
+ // xorshift pseudo random data
+ p = (uint32_t *)data;
+ for (i = 0; i < size / 4; i++)
+    {
+     x ^= x << 13;
+     x ^= x >> 17;
+     x ^= x << 5;
+     p[i] = x;
+    }
+
+ printf("Digest speeds for %d MB held in memory:\n\n", (int)(size / 1048576));
+ printf("Digest   Time (ms)    MB/s   vs MD5\n");
+
+ for (alg = 0; alg < HASH_COUNT; alg++)
+    {
+     if (! hash_available(alg))
+        {
+         printf("%-8s not built in\n", hash_names[alg]);
+         continue;
+        }
+
+     t = time_get_ms();
+     hash_init(&ctx, HASH_BIT(alg));
+     hash_update(&ctx, data, size);
+     hash_final(&ctx, &res);
+     ms = time_get_ms() - t;
+     if (ms == 0)
+        ms = 1;
+     if (alg == HASH_MD5)
+        md5_ms = ms;
+
+     printf("%-8s %9d %7.1f %7.2fx", hash_names[alg], (int)ms,
+     (double)(size / 1048576) * 1000.0 / ms, (double)md5_ms / ms);
+     if (alg == HASH_SHA256)
+        printf("  (%s)", sha256_method());
+     printf("\n");
+    }
+
+ free(data);
+}
@@ -0,0 +1,56 @@
+/* Hash header */
+
+#ifndef HEADER_HASH_H
+#define HEADER_HASH_H
+
+#include "md5.h"
+#include "sha256.h"
+
+#ifdef HAVE_BLAKE3
+#include <blake3.h>
+#endif
+
+#ifdef HAVE_XXHASH
+#include <xxhash.h>
+#endif
+
+enum
+{
+ HASH_MD5,
+ HASH_SHA256,
+ HASH_BLAKE3,
+ HASH_XXH3,
+ HASH_COUNT
+};
+
+#define HASH_BIT(x) (1 << (x))
+#define HASH_DIGEST_MAX 65
+
+typedef struct hash_ctx_t
+{
+ int algs;
+ struct md5_ctx md5;
+ sha256_ctx_t sha256;
+#ifdef HAVE_BLAKE3
+ blake3_hasher blake3;
+#endif
+#ifdef HAVE_XXHASH
+ XXH3_state_t *xxh3;
+#endif
+} hash_ctx_t;
+
+typedef struct hash_res_t
+{
+ char digest[HASH_COUNT][HASH_DIGEST_MAX];
+} hash_res_t;
+
+char *hash_name (int alg);
+int hash_available (int alg);
+int hash_parse (char *list);
+void hash_init (hash_ctx_t *ctx, int algs);
+void hash_update (hash_ctx_t *ctx, const void *data, size_t len);
+void hash_final (hash_ctx_t *ctx, hash_res_t *res);
+int hash_file (char *filename, int algs, hash_res_t *res);
+void hash_bench (void);
+
+#endif     /* HEADER_HASH_H */
@@ -0,0 +1,452 @@
+//******************************************************************************
+//*                                 uBeeDisk                                   *
+//*                                                                            *
+//*     A tool for converting disks/images from one to another with auto       *
+//*                   detection options for Microbee disks.                    *
+//*                                                                            *
+//*                              info map module                               *
+//*                                                                            *
+//*                       Copyright (C) 2008-2026 uBee                         *
+//******************************************************************************
+//
+// Sector status map for the 'info' file.
+//
+// The map holds an entry for each track read with the track's geometry and
+// a status for each sector in physical sector order.  The map grows as
+// tracks are added so there is no limit on the number of tracks or sectors
+// per track other than the memory available.
+//
+// Each sector status is held as a one byte code.  The codes of the track
+// being read are kept unencoded so they can be set directly, when the next
+// track is added the codes are run-length encoded into the map data.  Runs
+// of good sectors become a run code followed by the run length, a track of
+// good sectors takes 2 or 3 bytes no matter how many sectors it has.
+//
+// Codes:
+//
+//   0-250    good sector, the number of retries needed (250 or more)
+//   251      run of good sectors read first time, followed by the run
+//            length 7 bits per byte least significant first with bit 7 set
+//            if another length byte follows
+//   254      read error
+//   255      sector not read
+//
+//==============================================================================
+// ChangeLog (most recent entries are at top)
+//==============================================================================
+// v4.1.0 - 17 October 2026, uBee
+// - Initial file created.
+//==============================================================================
+/*
+ *  uBeeDisk - A tool for converting disks/images from one to another with
+ *  auto detection options for Microbee disks.
+ *  Copyright (C) 2008-2026 uBee
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+//==============================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "infomap.h"
+
+//==============================================================================
+// structures and variables
+//==============================================================================
+#define CODE_RETRY_MAX 250
+#define CODE_RUN       251
+#define CODE_ERROR     254
+#define CODE_NOTREAD   255
+
+// shortest run of good sectors that is encoded as a run
+#define RUN_MIN 3
+
+//==============================================================================
+// Convert a sector status value to a status code.
+//
+//   pass: int status                   status value
+// return: uint8_t                      status code
+//==============================================================================
+static uint8_t info_code (int status)
+{
+ if (status == INFO_ERROR)
+    return CODE_ERROR;
+ if (status == INFO_NOTREAD || status < 0)
+    return CODE_NOTREAD;
+ if (status > CODE_RETRY_MAX)
+    return CODE_RETRY_MAX;
+ return status;
+}
+
+//==============================================================================
+// Convert a status code to a sector status value.
+//
+//   pass: uint8_t code                 status code
+// return: int                          status value
+//==============================================================================
+static int info_status (uint8_t code)
+{
+ if (code == CODE_ERROR)
+    return INFO_ERROR;
+ if (code == CODE_NOTREAD)
+    return INFO_NOTREAD;
+ return code;
+}
+
+//==============================================================================
+// Make sure the map data can hold another n bytes.
+//
+//   pass: info_map_t *m
+//         size_t n                     number of bytes
+// return: int                          0 if no error, else -1
+//==============================================================================
+static int info_data_alloc (info_map_t *m, size_t n)
+{
+ uint8_t *temp;
+ size_t size;
+
+ if (m->data_len + n <= m->data_size)
+    return 0;
+
+ size = m->data_size * 2 + n + 4096;
+ if ((temp = realloc(m->data, size)) == NULL)
+    return -1;
+ m->data = temp;
+ m->data_size = size;
+
+ return 0;
+}
+
+//==============================================================================
+// Run-length encode the status codes of a track.
+//
+// The encoded length is never more than the number of codes.
+//
+//   pass: uint8_t *codes               status codes
+//         int n                        number of codes
+//         uint8_t *out                 encoded output
+// return: size_t                       encoded length
+//==============================================================================
+static size_t info_encode (uint8_t *codes, int n, uint8_t *out)
+{
+ size_t len = 0;
+ int run;
+ int i = 0;
+
+ while (i < n)
+    {
+     for (run = 0; i + run < n && codes[i + run] == 0; run++)
+        ;
+
+     if (run >= RUN_MIN)
+        {
+         out[len++] = CODE_RUN;
+         i += run;
+         while (run > 0x7f)
+            {
+             out[len++] = (run & 0x7f) | 0x80;
+             run >>= 7;
+            }
+         out[len++] = run;
+        }
+     else
+        out[len++] = codes[i++];
+    }
+
+ return len;
+}
+
+//==============================================================================
+// Decode the run-length encoded status codes of a track.
+//
+//   pass: uint8_t *in                  encoded codes
+//         size_t len                   encoded length
+//         uint8_t *codes               status codes output
+//         int n                        number of codes
+// return: void
+//==============================================================================
+static void info_decode (uint8_t *in, size_t len, uint8_t *codes, int n)
+{
+ size_t pos = 0;
+ int run;
+ int shift;
+ int i = 0;
+
+ while (pos < len && i < n)
+    {
+     if (in[pos] != CODE_RUN)
+        {
+         codes[i++] = in[pos++];
+         continue;
+        }
+
+     pos++;
+     run = 0;
+     shift = 0;
+     while (pos < len)
+        {
+         run |= (in[pos] & 0x7f) << shift;
+         shift += 7;
+         if (! (in[pos++] & 0x80))
+            break;
+        }
+
+     while (run-- && i < n)
+        codes[i++] = 0;
+    }
+
+ // a short or damaged track is filled as not read
+ while (i < n)
+    codes[i++] = CODE_NOTREAD;
+}
+
+//==============================================================================
+// Empty the map.
+//
+// The memory already allocated is kept for the next use.
+//
+//   pass: info_map_t *m
+// return: void
+//==============================================================================
+void info_map_clear (info_map_t *m)
+{
+ m->count = 0;
+ m->data_len = 0;
+ m->cur_open = 0;
+}
+
+//==============================================================================
+// Release the memory used by the map.
+//
+//   pass: info_map_t *m
+// return: void
+//==============================================================================
+void info_map_free (info_map_t *m)
+{
+ free(m->tracks);
+ free(m->data);
+ free(m->cur);
+ memset(m, 0, sizeof(info_map_t));
+}
+
+//==============================================================================
+// Encode the codes of the last track added into the map data.
+//
+//   pass: info_map_t *m
+// return: int                          0 if no error, else -1
+//==============================================================================
+int info_map_close (info_map_t *m)
+{
+ info_track_t *tp;
+
+ if (! m->cur_open)
+    return 0;
+
+ tp = &m->tracks[m->count - 1];
+ if (info_data_alloc(m, tp->sectors) == -1)
+    return -1;
+
+ tp->pos = m->data_len;
+ tp->len = info_encode(m->cur, tp->sectors, m->data + m->data_len);
+ m->data_len += tp->len;
+ m->cur_open = 0;
+
+ return 0;
+}
+
+//==============================================================================
+// Add a track to the map.
+//
+// The previous track is encoded and all the sectors of the new track are
+// set to 'not read'.
+//
+//   pass: info_map_t *m
+//         int cyl                      cylinder number
+//         int head                     physical side of disk
+//         int secbase                  first sector number
+//         int sectors                  number of sectors
+//         int secsize                  sector size
+// return: int                          track index, -1 if error
+//==============================================================================
+int info_map_add (info_map_t *m, int cyl, int head, int secbase,
+                  int sectors, int secsize)
+{
+ info_track_t *temp;
+ info_track_t *tp;
+ uint8_t *cur;
+
+ if (sectors < 0 || info_map_close(m) == -1)
+    return -1;
+
+ if (m->count == m->size)
+    {
+     temp = realloc(m->tracks, sizeof(info_track_t) * (m->size + 200));
+     if (! temp)
+        return -1;
+     m->tracks = temp;
+     m->size += 200;
+    }
+
+ if (sectors > m->cur_size)
+    {
+     if ((cur = realloc(m->cur, sectors)) == NULL)
+        return -1;
+     m->cur = cur;
+     m->cur_size = sectors;
+    }
+
+ tp = &m->tracks[m->count++];
+ tp->cyl = cyl;
+ tp->head = head;
+ tp->secbase = secbase;
+ tp->sectors = sectors;
+ tp->secsize = secsize;
+ tp->pos = 0;
+ tp->len = 0;
+
+ memset(m->cur, CODE_NOTREAD, sectors);
+ m->cur_open = 1;
+
+ return m->count - 1;
+}
+
+//==============================================================================
+// Get a sector status.
+//
+//   pass: info_map_t *m
+//         int trk                      track index
+//         int sect                     physical sector index in the track
+// return: int                          status value, -1 if no such sector
+//==============================================================================
+int info_map_get (info_map_t *m, int trk, int sect)
+{
+ info_track_t *tp;
+ uint8_t *codes;
+ int status;
+
+ if (trk < 0 || trk >= m->count || sect < 0 ||
+     sect >= m->tracks[trk].sectors)
+    return -1;
+
+ if (m->cur_open && trk == m->count - 1)
+    return info_status(m->cur[sect]);
+
+ tp = &m->tracks[trk];
+ if ((codes = malloc(tp->sectors)) == NULL)
+    return -1;
+ info_decode(m->data + tp->pos, tp->len, codes, tp->sectors);
+ status = info_status(codes[sect]);
+ free(codes);
+
+ return status;
+}
+
+//==============================================================================
+// Set a sector status.
+//
+// A track that has already been encoded is decoded, changed and encoded
+// again.  The new encoding replaces the old one if it fits, otherwise it is
+// added to the end of the map data.
+//
+//   pass: info_map_t *m
+//         int trk                      track index
+//         int sect                     physical sector index in the track
+//         int status                   status value
+// return: int                          0 if no error, else -1
+//==============================================================================
+int info_map_set (info_map_t *m, int trk, int sect, int status)
+{
+ info_track_t *tp;
+ uint8_t *codes;
+ uint8_t *out;
+ size_t len;
+
+ if (trk < 0 || trk >= m->count || sect < 0 ||
+     sect >= m->tracks[trk].sectors)
+    return -1;
+
+ if (m->cur_open && trk == m->count - 1)
+    {
+     m->cur[sect] = info_code(status);
+     return 0;
+    }
+
+ tp = &m->tracks[trk];
+ if ((codes = malloc(tp->sectors * 2)) == NULL)
+    return -1;
+ out = codes + tp->sectors;
+
+ info_decode(m->data + tp->pos, tp->len, codes, tp->sectors);
+ codes[sect] = info_code(status);
+ len = info_encode(codes, tp->sectors, out);
+
+ if (len > tp->len)
+    {
+     if (info_data_alloc(m, len) == -1)
+        {
+         free(codes);
+         return -1;
+        }
+     tp->pos = m->data_len;
+     m->data_len += len;
+    }
+
+ memcpy(m->data + tp->pos, out, len);
+ tp->len = len;
+ free(codes);
+
+ return 0;
+}
+
+//==============================================================================
+// Get the status of all the sectors of a track.
+//
+//   pass: info_map_t *m
+//         int trk                      track index
+//         int *status                  status values output (sectors)
+// return: int                          0 if no error, else -1
+//==============================================================================
+int info_map_track (info_map_t *m, int trk, int *status)
+{
+ info_track_t *tp;
+ uint8_t *codes;
+ int i;
+
+ if (trk < 0 || trk >= m->count)
+    return -1;
+
+ tp = &m->tracks[trk];
+ if (tp->sectors == 0)
+    return 0;
+
+ if (m->cur_open && trk == m->count - 1)
+    codes = m->cur;
+ else
+    {
+     if ((codes = malloc(tp->sectors)) == NULL)
+        return -1;
+     info_decode(m->data + tp->pos, tp->len, codes, tp->sectors);
+    }
+
+ for (i = 0; i < tp->sectors; i++)
+    status[i] = info_status(codes[i]);
+
+ if (codes != m->cur)
+    free(codes);
+
+ return 0;
+}
@@ -0,0 +1,46 @@
+/* Info map header */
+
+#ifndef HEADER_INFOMAP_H
+#define HEADER_INFOMAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// sector status values, 0-250 are the number of retries needed
+#define INFO_ERROR 1000
+#define INFO_NOTREAD 1001
+
+typedef struct info_track_t
+{
+ int cyl;
+ int head;
+ int secbase;
+ int sectors;
+ int secsize;
+ size_t pos;           // encoded status codes in the map data
+ size_t len;
+} info_track_t;
+
+typedef struct info_map_t
+{
+ info_track_t *tracks;
+ int count;
+ int size;
+ uint8_t *data;        // encoded status codes of the closed tracks
+ size_t data_len;
+ size_t data_size;
+ uint8_t *cur;         // status codes of the last track until it's closed
+ int cur_size;
+ int cur_open;
+} info_map_t;
+
+void info_map_clear (info_map_t *m);
+void info_map_free (info_map_t *m);
+int info_map_add (info_map_t *m, int cyl, int head, int secbase,
+                  int sectors, int secsize);
+int info_map_close (info_map_t *m);
+int info_map_get (info_map_t *m, int trk, int sect);
+int info_map_set (info_map_t *m, int trk, int sect, int status);
+int info_map_track (info_map_t *m, int trk, int *status);
+
+#endif     /* HEADER_INFOMAP_H */
@@ -12,6 +12,26 @@
 //==============================================================================
 // ChangeLog (most recent entries are at top)
 //==============================================================================
+// v4.1.0 - 17 October 2026, uBee
+// - Added --pipeline option.
+// - Added --batch, --batch-report and --jobs options.
+// - Added --fastcopy option.
+// - Added --deferred option.
+// - Added --obuffer option.
+// - Added --hash and --hashbench options.
+// - Added --checkpoint and --resume options.
+// - Added --vote and --vote-mode options.
+// - Added --sidecar option.
+// - Added --pair option.
+// - Added --autodisk option.
+// - Added --events option.
+// - Added --profile option.
+// - Added --sim option and the 'sim' input type.
+// - Added 'bench' to the --disk processes.
+// - Added --trace option and the 'replay' input type.
+// - Added 'plan' to the --disk processes and the --turnaround option.
+// - Added 'calibrate' to the --disk processes and the --skewprof option.
+//
 // v4.0.1 - 28 December 2023, Tony Sanchez
 // - Change to options_getoptstr() to work around clang strict array bounds check on MacOS
 //==============================================================================
@@ -155,6 +175,8 @@
 #include "format.h"
 #include "getopt.h"
 #include "strverscmp.h"
+#include "hash.h"
+#include "sidecar.h"
 
 //==============================================================================
 // structures and variables
@@ -162,11 +184,15 @@
 static struct option long_options[] =
 {
  {"append-error",    no_argument,       0, OPT_APPENDERR  },
+ {"autodisk",        required_argument, 0, OPT_AUTODISK   },
  {"autorate",        required_argument, 0, OPT_AUTORATE   },
  {"autorateip",      required_argument, 0, OPT_AUTORATEIP }, 
  {"autorateop",      required_argument, 0, OPT_AUTORATEOP },
+ {"batch",           required_argument, 0, OPT_BATCH      },
+ {"batch-report",    required_argument, 0, OPT_BATCHREP   },
  {"cacher",          required_argument, 0, OPT_CACHER     },
  {"cachew",          required_argument, 0, OPT_CACHEW     },
+ {"checkpoint",      required_argument, 0, OPT_CHECKPOINT },
  {"config",          required_argument, 0, OPT_CONFIG     },
  {"confv",           required_argument, 0, OPT_CONFV      },
  {"count",           required_argument, 0, OPT_COUNT      },
@@ -174,6 +200,7 @@ static struct option long_options[] =
  {"datarate",        required_argument, 0, OPT_DATARATE   }, // option (-d)
  {"datarateip",      required_argument, 0, OPT_DATARATEIP },
  {"datarateop",      required_argument, 0, OPT_DATARATEOP },
+ {"deferred",        required_argument, 0, OPT_DEFERRED   },
  {"description",     required_argument, 0, OPT_DESCRIPT   },
  {"detect",          required_argument, 0, OPT_DETECT     },
  {"disk",            required_argument, 0, OPT_DISK       },
@@ -183,6 +210,8 @@ static struct option long_options[] =
  {"echoq",           required_argument, 0, OPT_ECHOQ      },
  {"entdesc",         required_argument, 0, OPT_ENTDESC    },
  {"erase",           required_argument, 0, OPT_ERASE      },
+ {"events",          required_argument, 0, OPT_EVENTS     },
+ {"fastcopy",        required_argument, 0, OPT_FASTCOPY   },
  {"fdwa",            required_argument, 0, OPT_FDWA_ALL   },
  {"fdwa1",           required_argument, 0, OPT_FDWA_1     }, 
  {"fdwa2",           required_argument, 0, OPT_FDWA_2     },
@@ -196,6 +225,8 @@ static struct option long_options[] =
  {"forceside",       required_argument, 0, OPT_FORCESIDE  },
  {"format",          required_argument, 0, OPT_FORMAT     }, // option (-f)
  {"gapset",          required_argument, 0, OPT_GAPSET     },
+ {"hash",            required_argument, 0, OPT_HASH       },
+ {"hashbench",       no_argument,       0, OPT_HASHBENCH  },
  {"heads",           required_argument, 0, OPT_HEADS      }, // option (-h)
  {"help",            no_argument,       0, OPT_HELP       },
  {"idstep",          required_argument, 0, OPT_IDSTEP     },
@@ -227,6 +258,7 @@ static struct option long_options[] =
  {"iside",           required_argument, 0, OPT_ISIDE      },
  {"it",              required_argument, 0, OPT_ITYPE      }, // option (-i)
  {"itype",           required_argument, 0, OPT_ITYPE      }, // option (-i)
+ {"jobs",            required_argument, 0, OPT_JOBS       },
  {"lcon",            no_argument,       0, OPT_LCON       },
  {"lconw",           no_argument,       0, OPT_LCONW      },
  {"lcons",           required_argument, 0, OPT_LCONS      },
@@ -237,15 +269,20 @@ static struct option long_options[] =
  {"noformat",        required_argument, 0, OPT_NOFORMAT   }, // option (-n)
  {"noskip",          required_argument, 0, OPT_NOSKIP     },
  {"nomulti",         required_argument, 0, OPT_NOMULTI    },
+ {"obuffer",         required_argument, 0, OPT_OBUFFER    },
  {"odstep",          required_argument, 0, OPT_ODSTEP     },
  {"of",              required_argument, 0, OPT_OF         },
  {"ofile",           required_argument, 0, OPT_OF         }, 
  {"oside",           required_argument, 0, OPT_OSIDE      },
  {"ot",              required_argument, 0, OPT_OTYPE      }, // option (-o)
  {"otype",           required_argument, 0, OPT_OTYPE      }, // option (-o)
+ {"pair",            required_argument, 0, OPT_PAIR       },
+ {"pipeline",        required_argument, 0, OPT_PIPELINE   },
+ {"profile",         required_argument, 0, OPT_PROFILE    },
  {"pskew",           required_argument, 0, OPT_PSKEW      },
  {"pskew0",          required_argument, 0, OPT_PSKEW0     },
  {"pskew1",          required_argument, 0, OPT_PSKEW1     },
+ {"resume",          required_argument, 0, OPT_RESUME     },
  {"retry-l1",        required_argument, 0, OPT_RETRY_L1   },
  {"retry-l2",        required_argument, 0, OPT_RETRY_L2   },
  {"retry",           required_argument, 0, OPT_RETRY_L2   },
@@ -257,13 +294,18 @@ static struct option long_options[] =
  {"secsize",         required_argument, 0, OPT_SECSIZE    },
  {"sectors",         required_argument, 0, OPT_SECTORS    }, // option (-s)
  {"side1as0",        required_argument, 0, OPT_SIDE1AS0   },
+ {"sidecar",         required_argument, 0, OPT_SIDECAR    },
  {"sidedness",       required_argument, 0, OPT_SIDEDNESS  },
  {"sideoffs",        required_argument, 0, OPT_SIDEOFFS   }, 
  {"signature",       required_argument, 0, OPT_SIGNATURE  },
+ {"sim",             required_argument, 0, OPT_SIM        },
  {"skew",            required_argument, 0, OPT_SKEW       },  
  {"skew-ofs",        required_argument, 0, OPT_SKEW_OFS   },  
+ {"skewprof",        required_argument, 0, OPT_SKEWPROF   },
  {"start",           required_argument, 0, OPT_START      },
  {"sfmode",          required_argument, 0, OPT_SFMODE     },
+ {"trace",           required_argument, 0, OPT_TRACE      },
+ {"turnaround",      required_argument, 0, OPT_TURNAROUND },
  {"usage",           no_argument,       0, OPT_HELP       },
  {"unattended",      required_argument, 0, OPT_UNATTENDED },
  {"unattended-rab",  required_argument, 0, OPT_UNATTRAB   },
@@ -273,6 +315,8 @@ static struct option long_options[] =
  {"varuset",         required_argument, 0, OPT_VARUSET    },
  {"verbose",         required_argument, 0, OPT_VERBOSE    },
  {"version",         no_argument,       0, OPT_VERSION    }, // option (-v)
+ {"vote",            required_argument, 0, OPT_VOTE       },
+ {"vote-mode",       required_argument, 0, OPT_VOTEMODE   },
  {0,                 0,                 0, 0              }
 };
 
@@ -341,8 +385,8 @@ extern char userhome[];
 
 extern char *buffer_args[];
 
-extern disk_t disk;
-extern dg_opts_t dg_opts;
+extern SESSION_LOCAL disk_t disk;
+extern SESSION_LOCAL dg_opts_t dg_opts;
 
 static char *options_malloc (int size);
 
@@ -1036,6 +1080,13 @@ static void options_usage (void)
 "  --append-error          This option is used to append the error log to the\n"
 "                          'info' file instead of creating an 'err' file.\n"
 "\n"
+"  --autodisk=x            When copying several disks with --count, wait for\n"
+"                          the next disk to be inserted and start copying it\n"
+"                          instead of prompting for ENTER if x=on.  The input\n"
+"                          drive is kept open between disks.  Requires a\n"
+"                          floppy or remote input whose driver reports the\n"
+"                          drive ready status.  Default is off.\n"
+"\n"
 "  --autorate=x            Test if drive is a 5.25\" HD or 5.25\" DD type if\n"
 "                          x=on, if x=off no drive type detection will be used.\n"
 "                          When enabled and the drive is a HD type and has less\n"
@@ -1046,6 +1097,18 @@ static void options_usage (void)
 "  --autorateip=x          Same as --autorate but sets input autorate only.\n"
 "  --autorateop=x          Same as --autorate but sets output autorate only.\n"
 "\n"
+"  --batch=x               Convert a batch of image files.  x is a directory\n"
+"                          (all files except 'info' and 'err' files) or a\n"
+"                          wildcard pattern (Unices only, quote it).  The --of\n"
+"                          option is used as the output pattern and must\n"
+"                          contain '@b' for the input base name.  Disk\n"
+"                          descriptions are not prompted for, errors are\n"
+"                          handled unattended and existing output files are\n"
+"                          skipped unless --force is used.\n"
+"\n"
+"  --batch-report=fn       Write the --batch results and summary to file fn as\n"
+"                          well as to stdout.\n"
+"\n"
 "  --cacher=x              Enable/Disable Track caching for reads. This option\n"
 "                          is only supported by some devices (i.e. Floppyio).\n"
 "                          x=off to disable, x=on to enable. Default setting\n"
@@ -1055,6 +1118,13 @@ static void options_usage (void)
 "                          x=off to disable, x=on to enable. Default setting\n"
 "                          depends on the device.\n"
 "\n"
+"  --checkpoint=x          Keep a checkpoint journal '<ofile>.ckpt' while\n"
+"                          copying to an image file if x=on.  Each completed\n"
+"                          track and deferred sector result is recorded and\n"
+"                          flushed to disk so that an interrupted copy can be\n"
+"                          continued with --resume.  The journal is removed\n"
+"                          when the copy completes.  Default is off.\n"
+"\n"
 "  --config=file           Allows an alternative configuration file to be used\n"
 "                          or if file='none' then no configuration file will be\n"
 "                          used.  This option if used must be the first option\n"
@@ -1088,6 +1158,13 @@ static void options_usage (void)
 "  --datarateip=x          Same as --datarate but sets input datarate only.\n"
 "  --datarateop=x          Same as --datarate but sets output datarate only.\n"
 "\n"
+"  --deferred=x            Defer the retrying of sector read errors during a\n"
+"                          copy in unattended mode if x=on.  The whole disk is\n"
+"                          read first with minimal retries and the failed\n"
+"                          sectors are queued, these are then retried in\n"
+"                          cylinder order using the full unattended retry\n"
+"                          method.  Default is off.\n"
+"\n"
 "  --description=str       Set/override the format description.\n"
 "\n"
 "  --detect=x              Use disk format detection. x determines what disks\n"
@@ -1115,6 +1192,20 @@ static void options_usage (void)
 "                          format : format disk tracks.\n"
 "                          speed  : check rotational speed of drive.\n"
 "                          clean  : clean disk drive heads.\n"
+"                          bench  : benchmark the per track helpers for the\n"
+"                                   --format or all built in formats, or\n"
+"                                   write a synthetic raw image of the\n"
+"                                   --format if --of is given.  Results are\n"
+"                                   JSON lines, see 'make bench'.\n"
+"                          plan   : predict the revolutions and time to read\n"
+"                                   a track and disk with the skew values of\n"
+"                                   the --format or all built in formats and\n"
+"                                   show the quickest skew values, see\n"
+"                                   --turnaround.\n"
+"                          calibrate : time track reads of a known good\n"
+"                                   disk with each skew value and first\n"
+"                                   sector and save the quickest for the\n"
+"                                   drive and format, see --skewprof.\n"
 "\n"
 "  --diskdesc=x            Pass a disk description. Repeat this option for as\n"
 "                          many lines of text that are required.  Each line may\n"
@@ -1141,6 +1232,27 @@ static void options_usage (void)
 "                          the entire track to the same value.  The 'n' value\n"
 "                          should not be a special controller value.\n"
 "\n"
+"  --events=x              Write a stream of events for a supervising program\n"
+"                          to x.  If x is a number it's used as an already\n"
+"                          open file descriptor, otherwise x is a file name\n"
+"                          (or named pipe) to be created.  Each event is a\n"
+"                          JSON object on a line of it's own with the members\n"
+"                          \"ts\" (milliseconds since the epoch), \"pid\",\n"
+"                          \"event\" and \"pair\" for --pair threads.  Events\n"
+"                          are: copy_start, detect, track_start, track_done,\n"
+"                          sector_retry, sector_error, abort, phase (open,\n"
+"                          copy, deferred, fill and info times) and summary.\n"
+"                          Events are written by a separate thread and are\n"
+"                          dropped (and a 'dropped' event written) rather\n"
+"                          than slowing the copy down if the reader is slow.\n"
+"\n"
+"  --fastcopy=x            Enable/disable the fast image to image copy if x=on\n"
+"                          or x=off.  When both input and output are image\n"
+"                          files (raw, dsk, edsk, imd) of the same geometry and\n"
+"                          the format has nothing that alters the data or IDs\n"
+"                          whole tracks are moved in bulk, raw to raw copies\n"
+"                          are done as a single file copy.  Default is on.\n"
+"\n"
 "  --fdwa1=x               This option may be used to enable/disable some PC\n"
 "                          only floppy disk access work-around #1 code. If\n"
 "                          enabled the input drive is closed then reopened at\n"
@@ -1190,6 +1302,14 @@ static void options_usage (void)
 "  --gapset=pe:v,[pe:v...] Set number of format GAP/SYNC bytes for format gaps.\n"
 "                          See the README file for usage.\n"
 "\n"
+"  --hash=x[,x...]         Select the digests of the output image written to\n"
+"                          the 'info' file.  x=md5, sha256, blake3 or xxh3.\n"
+"                          blake3 and xxh3 are only available if built with\n"
+"                          the BLAKE3 and xxHash libraries.  Default is md5.\n"
+"\n"
+"  --hashbench             Report the speed of each digest that is available\n"
+"                          and exit.\n"
+"\n"
 "  --heads=n, -h           Set/override the number of heads.\n"
 "\n"
 "  --help                  Send this help information to stdout.\n"
@@ -1233,11 +1353,22 @@ static void options_usage (void)
 "                          logical, floppy, ntwdm, myz80, cfi, qm, teledisk,\n"
 "                          imd, nanowasp, rcpmfs, remote.\n"
 "\n"
+"                          If 'sim' is specified for x then the input file is\n"
+"                          read through a simulated floppy drive, see --sim.\n"
+"\n"
+"                          If 'replay' is specified for x then the input file\n"
+"                          is a trace recorded with --trace and the input\n"
+"                          drive calls are replayed from it, see --trace.\n"
+"\n"
 "                          If 'fd' is specified for x then this will be\n"
 "                          translated to the host system's floppy driver. On\n"
 "                          Windows this is 'ntwdm' and Unices is the 'floppy'\n"
 "                          driver.  This is useful for making scripts portable.\n"
 "\n"
+"  --jobs=n                Number of --batch conversions to run at the same\n"
+"                          time (Unices only).  n=0 uses one for each CPU\n"
+"                          (default).\n"
+"\n"
 "  --lcon                  List the [section] names found in the configuration\n"
 "                          file.\n"
 "  --lconw                 Same as --lcon option except uses a wide format.\n"
@@ -1273,6 +1404,15 @@ static void options_usage (void)
 "  --noskip=n              Set/Override no skipping of deleted data. Set n=1\n"
 "                          to prevent or n=0 to allow skipping.\n"
 "\n"
+"  --obuffer=n             Buffer raw image output using up to n MB of memory\n"
+"                          so it is written directly using large sequential\n"
+"                          writes without the format fill pass.  Other image\n"
+"                          types are built in a temporary file in $TMPDIR or\n"
+"                          /tmp, which must have room for the whole image, and\n"
+"                          copied to the output in n MB blocks when closed.\n"
+"                          The format fill still runs for these.  Not used for\n"
+"                          floppy and remote output types.  Default is 0 (off).\n"
+"\n"
 "  --odstep=x              Determine if the output drive should use double\n"
 "                          stepping.  x=on to enable, x=off to disable.\n"
 "                          Default is off. (auto detection may set to on)\n"
@@ -1299,12 +1439,42 @@ static void options_usage (void)
 "                          Windows this is 'ntwdm' and Unices is the 'floppy'\n"
 "                          driver.  This is useful for making scripts portable.\n"
 "\n"
+"  --pair=in,out           Copy from several drives at once.  Each --pair gives\n"
+"                          the input and output names for one drive and up to\n"
+"                          8 may be used, these replace --if and --of.  Every\n"
+"                          pair is copied by it's own thread with the same\n"
+"                          options, a status line is shown for each pair and\n"
+"                          keys 1-8 start the next disk when using --count.\n"
+"                          Errors are handled unattended and disk descriptions\n"
+"                          are not prompted for (Unices only).\n"
+"\n"
+"  --pipeline=n            Use a pipelined copy where n is the number of track\n"
+"                          buffers (1-64) placed between the reading of the\n"
+"                          input and a separate writer thread.  Formatting and\n"
+"                          writing of the output then overlaps with reading of\n"
+"                          the next tracks.  n=0 disables (default).\n"
+"\n"
+"  --profile=x             Collect a timing profile of each copy if x=on.  The\n"
+"                          time spent and number of calls for sector ID reads,\n"
+"                          track reads, single sector reads, error re-seeks,\n"
+"                          settle delays, formatting, writing and the image\n"
+"                          digests are shown at the end of the copy along with\n"
+"                          the slowest tracks.  The 'info' file has a TIMING\n"
+"                          section with the times of every track.  Default is\n"
+"                          off.\n"
+"\n"
 "  --pskew=n,n,n...        Set physical sector skewing for track formatting. A\n"
 "                          maximum of 256 values are allowed. This will be used\n"
 "                          by side 0 and side 1 of the disk.\n"
 "  --pskew0=n,n,n...       As for --pskew but values applies to side 0 only.\n"
 "  --pskew1=n,n,n...       As for --pskew but values applies to side 1 only.\n"
 "\n"
+"  --resume=x              Resume an interrupted copy from the checkpoint\n"
+"                          journal if x=on.  The image file and journal must\n"
+"                          be from an earlier copy of the same input and\n"
+"                          format.  The last recorded track is copied again.\n"
+"                          Checkpointing is enabled.  Default is off.\n"
+"\n"
 "  --retry-l1=n            Set the number of read tries at the lowest level\n"
 "                          before level 2 comes into play. Default value is 30\n"
 "                          for a 'copy' and 5 for a 'scan/speed' command.  1 is\n"
@@ -1341,6 +1511,11 @@ static void options_usage (void)
 "                          header uses 0 instead of 1. n=0 indicates the side\n"
 "                          information matches the head 1 number.\n"
 "\n"
+"  --sidecar=x[,x...]      Also write the 'info' file information in a\n"
+"                          structured form for cataloguing programs.  x=json\n"
+"                          for '<ofile>.info.json', x=cbor for a compact binary\n"
+"                          '<ofile>.info.cbor' or x=none (default).\n"
+"\n"
 #if 0
 "  --sidedness=x           Set/override the sidedness of the disk. The allowed\n"
 "                          values are:\n"
@@ -1363,10 +1538,21 @@ static void options_usage (void)
 "  --signature=name        The archiver's signature can appear in the 'info'\n"
 "                          file by setting a name.\n"
 "\n"
+"  --sim=file              Drive profile for the simulated drive input type\n"
+"                          (--itype=sim).  The input image is read as if it\n"
+"                          was in a floppy drive with the rotational speed,\n"
+"                          step and settle times, sector interleave and skew,\n"
+"                          side IDs, sector read errors and weak sectors set in\n"
+"                          the profile so the copy can be tried and timed\n"
+"                          without a drive.  The simulated drive time is\n"
+"                          reported after each copy.  See the simdrive.c source\n"
+"                          for the profile settings.\n"
+"\n"
 "  --skew=n                Set/override the skew value used by the track read\n"
 "                          process. This value when correctly set can greatly\n"
 "                          improve the disk reading speed during the copy\n"
-"                          process. The default skew is set to 2.\n"
+"                          process. The default skew is set to 2.  See\n"
+"                          --disk=plan for the quickest values.\n"
 "  --skew-ofs=n            Set/override the first physical sector number read in\n"
 "                          a track read process. The first physical sector will\n"
 "                          be this value added to the sector base value at the\n"
@@ -1374,10 +1560,31 @@ static void options_usage (void)
 "                          (--secbase=1) and n=0 the first sector read will be\n"
 "                          1. The default value is 1.\n"
 "\n"
+"  --skewprof=x            Enable/disable the use of the skew values saved by\n"
+"                          --disk=calibrate for the input drive and format if\n"
+"                          x=on to enable, x=off to disable.  The values are\n"
+"                          kept in ~/.ubeedisk/skew.prof and are not used if\n"
+"                          --skew or --skew-ofs is given.  Default is on.\n"
+"\n"
 "  --start=n               Set/override the start cylinder/track for processes.\n"
 "                          Default this value is set to 0 cylinders but tracks\n"
 "                          may also be specified by using --sfmode.\n"
 "\n"
+"  --trace=file            Record a trace of the LibDsk calls made to the input\n"
+"                          and output drives with the time each took, the\n"
+"                          sector IDs and an MD5 of the data.  The sector data\n"
+"                          read is kept the first time it is seen.  The trace\n"
+"                          can be replayed with --itype=replay --if=file to\n"
+"                          repeat a copy without the drive or image, each copy\n"
+"                          takes the next disk from the trace and the replayed\n"
+"                          drive time is reported after the copy.  The output\n"
+"                          drive calls are not replayed.  Can not be used with\n"
+"                          --pair or --batch.\n"
+"\n"
+"  --turnaround=n          Host and controller turnaround time in microseconds\n"
+"                          between reading one sector and being ready to read\n"
+"                          the next used by --disk=plan.  The default is 1000.\n"
+"\n"
 "  --unattended=x          Use this option to enable/disable automated error\n"
 "                          handling. x=on to enable, x=off to disable.\n"
 "                          Default is off.\n"
@@ -1399,10 +1606,23 @@ static void options_usage (void)
 "                               processes intended to convey general information\n"
 "                               will be output.\n"
 "                          1  : Normal program output reporting (default).\n"
+"                               The copy progress line is updated 10 times a\n"
+"                               second and shows the position, sectors and KB\n"
+"                               read per second, retries and time remaining.\n"
 "                          >1 : Additional reporting levels.\n"
 "\n"
 "  --version, -v           Output the program version number to stdout.\n"
 "\n"
+"  --vote=n                Read a sector n times (2-15) and take a byte-wise\n"
+"                          majority vote of the data when the sector needed\n"
+"                          retries to read.  The agreement of the reads is\n"
+"                          recorded in the 'info' file.  n=0 disables\n"
+"                          (default).\n"
+"  --vote-mode=x           Select the sectors to vote on.  x=retried for only\n"
+"                          the sectors that needed retries (default), x=track\n"
+"                          for all the good sectors on a track where any\n"
+"                          sector needed retries or had an error.\n"
+"\n"
 "If you have any new feature suggestions, bug reports, etc. then post a new\n"
 "topic at www.microbee-mspp.org.au\n";
  printf("%s", usage);
@@ -1502,6 +1722,9 @@ void options_getopt (int argc, char *argv[])
   "format",
   "speed",
   "clean",
+  "bench",
+  "plan",
+  "calibrate",
   ""
  };
 
@@ -1542,6 +1765,13 @@ char *sidedness_args[] =
   ""
  };
 
+ char *vote_mode_args[] =
+ {
+  "retried",
+  "track",
+  ""
+ };
+
  int i;
  int c;
  int x;
@@ -1639,6 +1869,9 @@ char *sidedness_args[] =
              case OPT_APPENDERR :
                 disk.append_error = 1;
                 break;
+             case OPT_AUTODISK :
+                set_int_from_list(&disk.autodisk, offon_args);
+                break;
              case OPT_AUTORATE :
                 set_int_from_list(&disk.iautorate, offon_args);
                 set_int_from_list(&disk.oautorate, offon_args);
@@ -1649,12 +1882,21 @@ char *sidedness_args[] =
              case OPT_AUTORATEOP :
                 set_int_from_list(&disk.oautorate, offon_args);
                 break;
+             case OPT_BATCH :
+                strcpy(disk.batch, e_optarg);
+                break;
+             case OPT_BATCHREP :
+                strcpy(disk.batch_report, e_optarg);
+                break;
              case OPT_CACHER :
                 set_int_from_list(&disk.cacher, offon_args);             
                 break;
              case OPT_CACHEW :
                 set_int_from_list(&disk.cachew, offon_args);
                 break;
+             case OPT_CHECKPOINT :
+                set_int_from_list(&disk.checkpoint, offon_args);
+                break;
              case OPT_CONFIG :
                 strncpy(config_file, e_optarg, sizeof(config_file));
                 config_file[sizeof(config_file)-1] = 0;
@@ -1683,6 +1925,9 @@ char *sidedness_args[] =
                 tolower_string(e_optarg, e_optarg);
                 set_int_from_list(&dg_opts.odatarate, datarate_args);
                 break;
+             case OPT_DEFERRED :
+                set_int_from_list(&disk.deferred, offon_args);
+                break;
              case OPT_DESCRIPT :
                 strcpy(dg_opts.format_name, e_optarg);
                 break;
@@ -1719,6 +1964,12 @@ char *sidedness_args[] =
              case OPT_ERASE :   
                 set_int_from_arg(&disk.erase, 0, 255);
                 break;
+             case OPT_EVENTS :
+                strcpy(disk.events, e_optarg);
+                break;
+             case OPT_FASTCOPY :
+                set_int_from_list(&disk.fastcopy, offon_args);
+                break;
              case OPT_FDWA_ALL :
                 set_int_from_list(&disk.fd_workaround1, offon_args);
                 disk.fd_workaround2 = disk.fd_workaround1;
@@ -1763,6 +2014,22 @@ char *sidedness_args[] =
                 if (get_gap_colon_arguments(e_optarg, disk.gap_set, 4, 0x3fff) == -1)
                    param_error_mesg();
                 break;
+             case OPT_HASH :
+                tolower_string(e_optarg, e_optarg);
+                x = hash_parse(e_optarg);
+                if (x == -1)
+                   {
+                    printf(PARMERR_MESG, (char *)long_options[long_index].name,
+                    e_optarg);
+                    exitstatus = 1;
+                   }
+                else
+                   disk.hash = x;
+                break;
+             case OPT_HASHBENCH :
+                hash_bench();
+                exitstatus = 1;
+                break;
              case OPT_HEADS :
                 set_int_from_arg(&dg_opts.heads, 0, 1000000);
                 break;
@@ -1896,6 +2163,9 @@ char *sidedness_args[] =
                 strcpy(disk.itype, e_optarg);
                 tolower_string(disk.itype, disk.itype);
                 break;
+             case OPT_JOBS :
+                set_int_from_arg(&disk.jobs, 0, BATCH_JOBS_MAX);
+                break;
              case OPT_LCON :
                 for (i = list_config_start; i < ndefsc; i++)
                    printf("%s\n", ndefsv[i]);
@@ -1946,6 +2216,9 @@ char *sidedness_args[] =
              case OPT_NOSKIP :
                 set_int_from_arg(&dg_opts.noskip, 0, 1);
                 break;
+             case OPT_OBUFFER :
+                set_int_from_arg(&disk.obuffer, 0, 1024);
+                break;
              case OPT_ODSTEP :
                 set_int_from_list(&disk.odstep, offon_args);
                 break;
@@ -1959,6 +2232,19 @@ char *sidedness_args[] =
                 strcpy(disk.otype, e_optarg);
                 tolower_string(disk.otype, disk.otype);
                 break;
+             case OPT_PAIR :
+                if (disk.pairs == PAIRS_MAX ||
+                   strlen(e_optarg) >= sizeof(disk.pair[0]))
+                   param_error_mesg();
+                else
+                   strcpy(disk.pair[disk.pairs++], e_optarg);
+                break;
+             case OPT_PIPELINE :
+                set_int_from_arg(&disk.pipeline, 0, PIPELINE_MAX);
+                break;
+             case OPT_PROFILE :
+                set_int_from_list(&disk.profile, offon_args);
+                break;
              case OPT_PSKEW :
                 if (get_int_arguments(e_optarg, disk.pskew0,
                 PSKEW_SIZE, 255) != -1)
@@ -1984,6 +2270,9 @@ char *sidedness_args[] =
                 else
                    param_error_mesg();
                 break;                
+             case OPT_RESUME :
+                set_int_from_list(&disk.resume, offon_args);
+                break;
              case OPT_RETRY_L1 :
                 set_int_from_arg(&disk.retries_l1, 1, 1000);
                 break;
@@ -2019,6 +2308,14 @@ char *sidedness_args[] =
              case OPT_SIDE1AS0 :
                 set_int_from_arg(&dg_opts.side1as0, 0, 1);
                 break;
+             case OPT_SIDECAR :
+                tolower_string(e_optarg, e_optarg);
+                x = sidecar_parse(e_optarg);
+                if (x == -1)
+                   param_error_mesg();
+                else
+                   disk.sidecar = x;
+                break;
              case OPT_SIDEDNESS :
 #if 0
                 set_int_from_list(&dg_opts.sidedness, sidedness_args);
@@ -2032,18 +2329,30 @@ char *sidedness_args[] =
              case OPT_SIGNATURE :
                 strcpy(disk.signature, e_optarg);
                 break;
+             case OPT_SIM :
+                strcpy(disk.sim, e_optarg);
+                break;
              case OPT_SKEW :
                 set_int_from_arg(&dg_opts.skew_val, 1, 1000000);
                 break;
              case OPT_SKEW_OFS :
                 set_int_from_arg(&dg_opts.skew_ofs, 0, 1000000);
                 break;
+             case OPT_SKEWPROF :
+                set_int_from_list(&disk.skewprof, offon_args);
+                break;
              case OPT_START :
                 set_int_from_arg(&disk.start, 0, 1000000);
                 break;
              case OPT_SFMODE :
                 set_int_from_list(&disk.sfmode, sfmode_args);
                 break;
+             case OPT_TRACE :
+                strcpy(disk.trace, e_optarg);
+                break;
+             case OPT_TURNAROUND :
+                set_int_from_arg(&disk.turnaround, 0, 1000000);
+                break;
              case OPT_VERSION :
                 printf(APPVER"\n");
                 exitstatus = 1;
@@ -2070,6 +2379,15 @@ char *sidedness_args[] =
              case OPT_VERBOSE :
                 set_int_from_arg(&disk.verbose, 0, 1000000);
                 break;
+             case OPT_VOTE :
+                if (int_arg != 1)
+                   set_int_from_arg(&disk.vote, 0, VOTE_MAX);
+                else
+                   param_error_mesg();
+                break;
+             case OPT_VOTEMODE :
+                set_int_from_list(&disk.vote_mode, vote_mode_args);
+                break;
             }
         }
     }
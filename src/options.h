@@ -18,11 +18,15 @@ int options_process (int argc, char *argv[]);
 enum
 {
  OPT_APPENDERR=OPT_GROUP_CONTROL,
+ OPT_AUTODISK,
  OPT_AUTORATE,
  OPT_AUTORATEIP,
  OPT_AUTORATEOP,
+ OPT_BATCH,
+ OPT_BATCHREP,
  OPT_CACHER,
  OPT_CACHEW,
+ OPT_CHECKPOINT,
  OPT_CONFIG,
  OPT_CONFV, 
  OPT_COUNT,
@@ -30,6 +34,7 @@ enum
  OPT_DATARATE,
  OPT_DATARATEIP, 
  OPT_DATARATEOP,
+ OPT_DEFERRED,
  OPT_DESCRIPT,
  OPT_DETECT,
  OPT_DISK,
@@ -39,6 +44,8 @@ enum
  OPT_ECHOQ,
  OPT_ENTDESC,
  OPT_ERASE,
+ OPT_EVENTS,
+ OPT_FASTCOPY,
  OPT_FDWA_ALL,
  OPT_FDWA_1,
  OPT_FDWA_2, 
@@ -52,6 +59,8 @@ enum
  OPT_FORCESIDE,
  OPT_FORMAT,
  OPT_GAPSET,
+ OPT_HASH,
+ OPT_HASHBENCH,
  OPT_HEADS,
  OPT_HELP,
  OPT_IDSTEP,
@@ -60,6 +69,7 @@ enum
  OPT_INFO,
  OPT_ISIDE,
  OPT_ITYPE,
+ OPT_JOBS,
  OPT_LCON,
  OPT_LCONW,
  OPT_LCONS,
@@ -70,13 +80,18 @@ enum
  OPT_NOFORMAT,
  OPT_NOMULTI,
  OPT_NOSKIP,
+ OPT_OBUFFER,
  OPT_ODSTEP,
  OPT_OF,
  OPT_OSIDE,
  OPT_OTYPE,
+ OPT_PAIR,
+ OPT_PIPELINE,
+ OPT_PROFILE,
  OPT_PSKEW,
  OPT_PSKEW0,
  OPT_PSKEW1,
+ OPT_RESUME,
  OPT_RETRY_L1,
  OPT_RETRY_L2,
  OPT_RWGAP,
@@ -87,13 +102,18 @@ enum
  OPT_SECSIZE,
  OPT_SECTORS,
  OPT_SIDE1AS0,
+ OPT_SIDECAR,
  OPT_SIDEDNESS,
  OPT_SIDEOFFS, 
  OPT_SIGNATURE,
+ OPT_SIM,
  OPT_SKEW,
  OPT_SKEW_OFS,
+ OPT_SKEWPROF,
  OPT_START,
  OPT_SFMODE,
+ OPT_TRACE,
+ OPT_TURNAROUND,
  OPT_UNATTENDED,
  OPT_UNATTRAB,
  OPT_UNATTRPS,
@@ -101,7 +121,9 @@ enum
  OPT_VARSET,
  OPT_VARUSET,
  OPT_VERBOSE,
- OPT_VERSION
+ OPT_VERSION,
+ OPT_VOTE,
+ OPT_VOTEMODE
 };
 
 enum
@@ -0,0 +1,436 @@
+//******************************************************************************
+//*                                 uBeeDisk                                   *
+//*                                                                            *
+//*     A tool for converting disks/images from one to another with auto       *
+//*                   detection options for Microbee disks.                    *
+//*                                                                            *
+//*                              profile module                                *
+//*                                                                            *
+//*                       Copyright (C) 2008-2026 uBee                         *
+//******************************************************************************
+//
+// Copy timing profile (--profile).
+//
+// The time spent and the number of calls are collected for each part of a
+// disk copy (sector ID reads, buffered track reads, single sector reads,
+// error re-seeks, settle delays, formatting, writing and image digests) in
+// total and for each track.  The times use a monotonic clock so they are
+// not upset by changes to the system time.  A simulated drive adds the time
+// the drive would have taken (see profile_set_offset()).
+//
+// Times for tracks other than the one being read (i.e. those written by the
+// pipeline writer thread) are passed the track they belong to.
+//
+//==============================================================================
+// ChangeLog (most recent entries are at top)
+//==============================================================================
+// v4.1.0 - 17 October 2026, uBee
+// - Initial file created.
+//==============================================================================
+/*
+ *  uBeeDisk - A tool for converting disks/images from one to another with
+ *  auto detection options for Microbee disks.
+ *  Copyright (C) 2008-2026 uBee
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+//==============================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <libdsk.h>
+
+#include "profile.h"
+#include "ubeedisk.h"
+#include "functions.h"
+
+//==============================================================================
+// structures and variables
+//==============================================================================
+static char *profile_names[] =
+{
+ "Sector ID reads",
+ "Track reads",
+ "Sector reads",
+ "Error re-seeks",
+ "Settle delays",
+ "Track formats",
+ "Track writes",
+ "Image digests"
+};
+
+// short names for the per track table columns
+static char *profile_cols[] =
+{
+ "SecID",
+ "Track",
+ "Sector",
+ "Seek",
+ "Settle",
+ "Format",
+ "Write",
+ "Digest"
+};
+
+static uint64_t (*profile_offset)(void);
+
+#ifdef WIN32
+#define profile_lock(p)
+#define profile_unlock(p)
+#else
+#define profile_lock(p) pthread_mutex_lock(&(p)->mutex)
+#define profile_unlock(p) pthread_mutex_unlock(&(p)->mutex)
+#endif
+
+//==============================================================================
+// Set a function returning time to be added to the clock.
+//
+// The simulated drive (--itype=sim) uses this so the profile shows the
+// time a real drive would have taken and not only the time actually spent.
+// The offset is per thread so it must only ever increase in each thread.
+//
+//   pass: uint64_t (*offset)(void)     offset function, NULL for none
+// return: void
+//==============================================================================
+void profile_set_offset (uint64_t (*offset)(void))
+{
+ profile_offset = offset;
+}
+
+//==============================================================================
+// Get the profile clock time.
+//
+//   pass: void
+// return: uint64_t                     time in nanoseconds
+//==============================================================================
+uint64_t profile_time (void)
+{
+ if (profile_offset)
+    return time_get_ns() + profile_offset();
+ return time_get_ns();
+}
+
+//==============================================================================
+// Start collecting a profile.
+//
+// Any previous profile values are cleared.
+//
+//   pass: profile_t *p
+// return: void
+//==============================================================================
+void profile_start (profile_t *p)
+{
+#ifndef WIN32
+ if (! p->mutex_init)
+    {
+     pthread_mutex_init(&p->mutex, NULL);
+     p->mutex_init = 1;
+    }
+#endif
+
+ memset(p->ns, 0, sizeof(p->ns));
+ memset(p->calls, 0, sizeof(p->calls));
+ p->count = 0;
+ p->cur = -1;
+ p->wall = 0;
+ p->start = profile_time();
+ p->active = 1;
+}
+
+//==============================================================================
+// Stop collecting a profile.
+//
+// The total time and the time of the last track are brought up to date.
+// This may be called again later to update the values.
+//
+//   pass: profile_t *p                 profile or NULL
+// return: void
+//==============================================================================
+void profile_stop (profile_t *p)
+{
+ uint64_t now;
+
+ if (! p || ! p->active)
+    return;
+
+ now = profile_time();
+
+ profile_lock(p);
+ if (p->cur != -1)
+    {
+     p->tracks[p->cur].wall += now - p->cur_start;
+     p->cur = -1;
+    }
+ p->wall = now - p->start;
+ profile_unlock(p);
+}
+
+//==============================================================================
+// Release the memory used by a profile.
+//
+//   pass: profile_t *p
+// return: void
+//==============================================================================
+void profile_free (profile_t *p)
+{
+ free(p->tracks);
+ p->tracks = NULL;
+ p->count = 0;
+ p->size = 0;
+ p->active = 0;
+}
+
+//==============================================================================
+// Get a track entry, the track table is grown as needed.
+//
+// The profile must be locked.
+//
+//   pass: profile_t *p
+//         int trk                      logical track
+// return: profile_trk_t *              track entry, NULL if no memory
+//==============================================================================
+static profile_trk_t *profile_trk (profile_t *p, int trk)
+{
+ profile_trk_t *temp;
+ int size;
+
+ if (trk < 0)
+    return NULL;
+
+ if (trk >= p->size)
+    {
+     size = trk + 200;
+     if ((temp = realloc(p->tracks, sizeof(profile_trk_t) * size)) == NULL)
+        return NULL;
+     p->tracks = temp;
+     p->size = size;
+    }
+
+ if (trk >= p->count)
+    {
+     memset(&p->tracks[p->count], 0,
+     sizeof(profile_trk_t) * (trk + 1 - p->count));
+     while (p->count <= trk)
+        {
+         p->tracks[p->count].cyl = -1;
+         p->count++;
+        }
+    }
+
+ return &p->tracks[trk];
+}
+
+//==============================================================================
+// Begin timing a phase.
+//
+//   pass: profile_t *p                 profile or NULL
+// return: uint64_t                     start time, 0 if not profiling
+//==============================================================================
+uint64_t profile_begin (profile_t *p)
+{
+ if (! p || ! p->active)
+    return 0;
+ return profile_time();
+}
+
+//==============================================================================
+// End timing a phase.
+//
+//   pass: profile_t *p                 profile or NULL
+//         int phase                    PROFILE_* value
+//         int trk                      logical track, -1 for the track
+//                                      being read (if any)
+//         uint64_t t                   start time from profile_begin()
+// return: void
+//==============================================================================
+void profile_end (profile_t *p, int phase, int trk, uint64_t t)
+{
+ profile_trk_t *tp;
+ uint64_t ns;
+
+ if (! p || ! p->active || ! t)
+    return;
+
+ ns = profile_time() - t;
+
+ profile_lock(p);
+ p->ns[phase] += ns;
+ p->calls[phase]++;
+ if (trk == -1)
+    trk = p->cur;
+ if ((tp = profile_trk(p, trk)) != NULL)
+    {
+     tp->ns[phase] += ns;
+     tp->calls[phase]++;
+    }
+ profile_unlock(p);
+}
+
+//==============================================================================
+// Start reading a new track.
+//
+// The time since the previous track was started is added to that track.
+//
+//   pass: profile_t *p                 profile or NULL
+//         int trk                      logical track
+//         int cyl                      cylinder number
+//         int head                     physical side of disk
+// return: void
+//==============================================================================
+void profile_track (profile_t *p, int trk, int cyl, int head)
+{
+ profile_trk_t *tp;
+ uint64_t now;
+
+ if (! p || ! p->active)
+    return;
+
+ now = profile_time();
+
+ profile_lock(p);
+ if (p->cur != -1)
+    p->tracks[p->cur].wall += now - p->cur_start;
+ p->cur = -1;
+ if ((tp = profile_trk(p, trk)) != NULL)
+    {
+     tp->cyl = cyl;
+     tp->head = head;
+     p->cur = trk;
+     p->cur_start = now;
+    }
+ profile_unlock(p);
+}
+
+//==============================================================================
+// Output a line to a file or the console.
+//
+//   pass: FILE *f                      file, NULL for the console
+//         char *s
+// return: void
+//==============================================================================
+static void profile_out (FILE *f, char *s)
+{
+ if (f)
+    fputs(s, f);
+ else
+    printf("%s", s);
+}
+
+//==============================================================================
+// Report the profile.
+//
+// The time and calls for each phase are listed.  For a file (the 'info'
+// file TIMING section) the times of every track are then listed, for the
+// console only the slowest tracks are.
+//
+//   pass: profile_t *p
+//         FILE *f                      file, NULL for the console
+// return: void
+//==============================================================================
+void profile_report (profile_t *p, FILE *f)
+{
+ profile_trk_t *tp;
+ int slow[PROFILE_SLOWEST];
+ char s[500];
+ int len;
+ int i;
+ int x;
+ int n;
+
+ if (! p->active)
+    return;
+
+ if (f)
+    {
+     profile_out(f, "TIMING\n");
+     profile_out(f, "------\n");
+    }
+ else
+    profile_out(f, "\nTiming profile:\n");
+
+ snprintf(s, sizeof(s), "Total time         %.3f s\n\n",
+ (double)p->wall / 1e9);
+ profile_out(f, s);
+
+ profile_out(f, "Phase                  Calls    Total ms    Avg ms    Time\n");
+ for (i = 0; i < PROFILE_COUNT; i++)
+    {
+     if (! p->calls[i])
+        continue;
+     snprintf(s, sizeof(s), "%-18s %9lu %11.1f %9.2f  %5.1f%%\n",
+     profile_names[i], p->calls[i], (double)p->ns[i] / 1e6,
+     (double)p->ns[i] / 1e6 / p->calls[i],
+     p->wall? (double)p->ns[i] * 100.0 / p->wall : 0.0);
+     profile_out(f, s);
+    }
+
+ if (! p->count)
+    return;
+
+ // the console only lists the slowest tracks
+ if (! f)
+    {
+     n = 0;
+     for (i = 0; i < p->count; i++)
+        {
+         if (p->tracks[i].cyl == -1)
+            continue;
+         for (x = n; x > 0 && p->tracks[slow[x-1]].wall <
+              p->tracks[i].wall; x--)
+            if (x < PROFILE_SLOWEST)
+               slow[x] = slow[x-1];
+         if (x < PROFILE_SLOWEST)
+            {
+             slow[x] = i;
+             if (n < PROFILE_SLOWEST)
+                n++;
+            }
+        }
+     profile_out(f, "\nSlowest tracks     Cylinder  Head    Time ms\n");
+     for (i = 0; i < n; i++)
+        {
+         tp = &p->tracks[slow[i]];
+         snprintf(s, sizeof(s), "                   %8d  %4d  %9.1f\n",
+         tp->cyl, tp->head, (double)tp->wall / 1e6);
+         profile_out(f, s);
+        }
+     return;
+    }
+
+ profile_out(f,
+"\nThe time in ms of each track, 'Time' is from the start of reading the\n"
+"track to the start of the next.  Formats and writes done by the pipeline\n"
+"writer thread overlap the reading of later tracks.\n\n");
+
+ len = sprintf(s, "Cylinder  Head    Time");
+ for (i = 0; i < PROFILE_COUNT; i++)
+    len += sprintf(s + len, " %7s", profile_cols[i]);
+ sprintf(s + len, "\n");
+ profile_out(f, s);
+
+ for (i = 0; i < p->count; i++)
+    {
+     tp = &p->tracks[i];
+     if (tp->cyl == -1)
+        continue;
+     len = sprintf(s, "%4d       %d  %7.1f", tp->cyl, tp->head,
+     (double)tp->wall / 1e6);
+     for (x = 0; x < PROFILE_COUNT; x++)
+        len += sprintf(s + len, " %7.1f", (double)tp->ns[x] / 1e6);
+     sprintf(s + len, "\n");
+     profile_out(f, s);
+    }
+}
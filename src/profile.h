@@ -0,0 +1,66 @@
+/* Profile header */
+
+#ifndef HEADER_PROFILE_H
+#define HEADER_PROFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef WIN32
+#include <pthread.h>
+#endif
+
+enum
+{
+ PROFILE_SECID,
+ PROFILE_TRACK,
+ PROFILE_SECTOR,
+ PROFILE_SEEK,
+ PROFILE_SETTLE,
+ PROFILE_FORMAT,
+ PROFILE_WRITE,
+ PROFILE_HASH,
+ PROFILE_COUNT
+};
+
+// number of slowest tracks listed on the console
+#define PROFILE_SLOWEST 5
+
+typedef struct profile_trk_t
+{
+ int cyl;
+ int head;
+ uint64_t ns[PROFILE_COUNT];
+ unsigned int calls[PROFILE_COUNT];
+ uint64_t wall;        // time from the start of this track to the next
+}profile_trk_t;
+
+typedef struct profile_t
+{
+ int active;
+ uint64_t ns[PROFILE_COUNT];
+ unsigned long calls[PROFILE_COUNT];
+ profile_trk_t *tracks;  // indexed by logical track
+ int count;
+ int size;
+ int cur;              // logical track being read, -1 if none
+ uint64_t cur_start;
+ uint64_t start;
+ uint64_t wall;
+#ifndef WIN32
+ pthread_mutex_t mutex;  // the pipeline writer thread also adds times
+ int mutex_init;
+#endif
+}profile_t;
+
+void profile_set_offset (uint64_t (*offset)(void));
+uint64_t profile_time (void);
+void profile_start (profile_t *p);
+void profile_stop (profile_t *p);
+void profile_free (profile_t *p);
+uint64_t profile_begin (profile_t *p);
+void profile_end (profile_t *p, int phase, int trk, uint64_t t);
+void profile_track (profile_t *p, int trk, int cyl, int head);
+void profile_report (profile_t *p, FILE *f);
+
+#endif     /* HEADER_PROFILE_H */
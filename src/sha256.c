@@ -0,0 +1,449 @@
+//******************************************************************************
+//*                                 uBeeDisk                                   *
+//*                                                                            *
+//*     A tool for converting disks/images from one to another with auto       *
+//*                   detection options for Microbee disks.                    *
+//*                                                                            *
+//*                               sha256 module                                *
+//*                                                                            *
+//*                       Copyright (C) 2008-2026 uBee                         *
+//******************************************************************************
+//
+// Functions to compute SHA-256 message digests of memory blocks according
+// to the definition of SHA-256 in FIPS 180-4.
+//
+// The block function has three versions.  A portable C version is always
+// built.  On x86 hosts a version using the SHA extensions (SHA-NI) is built
+// and used if the CPU reports them at run time.  On ARM hosts built for a
+// CPU with the ARMv8 cryptographic extensions (-march=armv8-a+crypto) a
+// version using those is used instead of the C version.
+//
+//==============================================================================
+// ChangeLog (most recent entries are at top)
+//==============================================================================
+// v4.1.0 - 17 October 2026, uBee
+// - Initial file created.
+//==============================================================================
+/*
+ *  uBeeDisk - A tool for converting disks/images from one to another with
+ *  auto detection options for Microbee disks.
+ *  Copyright (C) 2008-2026 uBee
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+//==============================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SHA256_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && \
+    (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2))
+#define SHA256_ARM
+#include <arm_neon.h>
+#endif
+
+#include "sha256.h"
+
+static void sha256_blocks_c (uint32_t *state, const uint8_t *data,
+                             size_t blocks);
+
+//==============================================================================
+// structures and variables
+//==============================================================================
+static const uint32_t K[64] =
+{
+ 0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+ 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+ 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+ 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+ 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+ 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+ 0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+ 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+ 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+ 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+ 0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+ 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+ 0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+ 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+ 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+ 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static void (*sha256_blocks)(uint32_t *state, const uint8_t *data,
+                             size_t blocks);
+static char *sha256_method_name = "C";
+
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+//==============================================================================
+// Process SHA-256 blocks (portable C version).
+//
+//   pass: uint32_t *state              8 word hash state
+//         const uint8_t *data          data to process
+//         size_t blocks                number of 64 byte blocks
+// return: void
+//==============================================================================
+static void sha256_blocks_c (uint32_t *state, const uint8_t *data,
+                             size_t blocks)
+{
+ uint32_t w[64];
+ uint32_t a, b, c, d, e, f, g, h;
+ uint32_t t1, t2;
+ int i;
+
+ while (blocks--)
+    {
+     for (i = 0; i < 16; i++)
+        w[i] = (uint32_t)data[i*4] << 24 | (uint32_t)data[i*4+1] << 16 |
+               (uint32_t)data[i*4+2] << 8 | data[i*4+3];
+     for (i = 16; i < 64; i++)
+        w[i] = w[i-16] + w[i-7] +
+               (ROR(w[i-15], 7) ^ ROR(w[i-15], 18) ^ (w[i-15] >> 3)) +
+               (ROR(w[i-2], 17) ^ ROR(w[i-2], 19) ^ (w[i-2] >> 10));
+
+     a = state[0];
+     b = state[1];
+     c = state[2];
+     d = state[3];
+     e = state[4];
+     f = state[5];
+     g = state[6];
+     h = state[7];
+
+     for (i = 0; i < 64; i++)
+        {
+         t1 = h + (ROR(e, 6) ^ ROR(e, 11) ^ ROR(e, 25)) +
+              ((e & f) ^ (~e & g)) + K[i] + w[i];
+         t2 = (ROR(a, 2) ^ ROR(a, 13) ^ ROR(a, 22)) +
+              ((a & b) ^ (a & c) ^ (b & c));
+         h = g;
+         g = f;
+         f = e;
+         e = d + t1;
+         d = c;
+         c = b;
+         b = a;
+         a = t1 + t2;
+        }
+
+     state[0] += a;
+     state[1] += b;
+     state[2] += c;
+     state[3] += d;
+     state[4] += e;
+     state[5] += f;
+     state[6] += g;
+     state[7] += h;
+
+     data += 64;
+    }
+}
+
+#ifdef SHA256_X86
+//==============================================================================
+// Process SHA-256 blocks (x86 SHA extensions version).
+//
+// Each pass of the loop does 4 rounds, the message schedule for the
+// following rounds is worked out as it goes using the last 4 groups.
+//
+//   pass: uint32_t *state              8 word hash state
+//         const uint8_t *data          data to process
+//         size_t blocks                number of 64 byte blocks
+// return: void
+//==============================================================================
+__attribute__((target("sha,sse4.1,ssse3")))
+static void sha256_blocks_shani (uint32_t *state, const uint8_t *data,
+                                 size_t blocks)
+{
+ const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                     0x0405060700010203ULL);
+ __m128i state0;
+ __m128i state1;
+ __m128i abef;
+ __m128i cdgh;
+ __m128i m[4];
+ __m128i t;
+ int i;
+
+ // the state is held as ABEF and CDGH for the SHA instructions
+ t = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xb1);
+ state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]),
+          0x1b);
+ state0 = _mm_alignr_epi8(t, state1, 8);
+ state1 = _mm_blend_epi16(state1, t, 0xf0);
+
+ while (blocks--)
+    {
+     abef = state0;
+     cdgh = state1;
+
+     for (i = 0; i < 16; i++)
+        {
+         if (i < 4)
+            m[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)
+                   (data + i * 16)), mask);
+         else
+            {
+             t = _mm_sha256msg1_epu32(m[i & 3], m[(i + 1) & 3]);
+             t = _mm_add_epi32(t, _mm_alignr_epi8(m[(i + 3) & 3],
+                 m[(i + 2) & 3], 4));
+             m[i & 3] = _mm_sha256msg2_epu32(t, m[(i + 3) & 3]);
+            }
+         t = _mm_add_epi32(m[i & 3], _mm_loadu_si128((const __m128i *)
+             &K[i * 4]));
+         state1 = _mm_sha256rnds2_epu32(state1, state0, t);
+         t = _mm_shuffle_epi32(t, 0x0e);
+         state0 = _mm_sha256rnds2_epu32(state0, state1, t);
+        }
+
+     state0 = _mm_add_epi32(state0, abef);
+     state1 = _mm_add_epi32(state1, cdgh);
+
+     data += 64;
+    }
+
+ t = _mm_shuffle_epi32(state0, 0x1b);
+ state1 = _mm_shuffle_epi32(state1, 0xb1);
+ state0 = _mm_blend_epi16(t, state1, 0xf0);
+ state1 = _mm_alignr_epi8(state1, t, 8);
+
+ _mm_storeu_si128((__m128i *)&state[0], state0);
+ _mm_storeu_si128((__m128i *)&state[4], state1);
+}
+#endif
+
+#ifdef SHA256_ARM
+//==============================================================================
+// Process SHA-256 blocks (ARMv8 cryptographic extensions version).
+//
+//   pass: uint32_t *state              8 word hash state
+//         const uint8_t *data          data to process
+//         size_t blocks                number of 64 byte blocks
+// return: void
+//==============================================================================
+static void sha256_blocks_arm (uint32_t *state, const uint8_t *data,
+                               size_t blocks)
+{
+ uint32x4_t state0 = vld1q_u32(&state[0]);
+ uint32x4_t state1 = vld1q_u32(&state[4]);
+ uint32x4_t abcd;
+ uint32x4_t efgh;
+ uint32x4_t m[4];
+ uint32x4_t t;
+ uint32x4_t s0;
+ int i;
+
+ while (blocks--)
+    {
+     abcd = state0;
+     efgh = state1;
+
+     for (i = 0; i < 16; i++)
+        {
+         if (i < 4)
+            m[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + i * 16)));
+         else
+            m[i & 3] = vsha256su1q_u32(vsha256su0q_u32(m[i & 3],
+                       m[(i + 1) & 3]), m[(i + 2) & 3], m[(i + 3) & 3]);
+         t = vaddq_u32(m[i & 3], vld1q_u32(&K[i * 4]));
+         s0 = state0;
+         state0 = vsha256hq_u32(state0, state1, t);
+         state1 = vsha256h2q_u32(state1, s0, t);
+        }
+
+     state0 = vaddq_u32(state0, abcd);
+     state1 = vaddq_u32(state1, efgh);
+
+     data += 64;
+    }
+
+ vst1q_u32(&state[0], state0);
+ vst1q_u32(&state[4], state1);
+}
+#endif
+
+//==============================================================================
+// Select the block function to be used.
+//
+//   pass: void
+// return: void
+//==============================================================================
+static void sha256_select (void)
+{
+#ifdef SHA256_X86
+ unsigned int a, b, c, d;
+#endif
+
+ if (sha256_blocks)
+    return;
+
+#ifdef SHA256_X86
+ // SHA (CPUID.7.0:EBX bit 29), SSE4.1 and SSSE3 (CPUID.1:ECX bits 19, 9)
+ if (__get_cpuid(1, &a, &b, &c, &d) && (c & (1 << 19)) && (c & (1 << 9)) &&
+    __get_cpuid_count(7, 0, &a, &b, &c, &d) && (b & (1 << 29)))
+    {
+     sha256_method_name = "SHA-NI";
+     sha256_blocks = sha256_blocks_shani;
+     return;
+    }
+#endif
+
+#ifdef SHA256_ARM
+ sha256_method_name = "ARMv8 crypto";
+ sha256_blocks = sha256_blocks_arm;
+ return;
+#endif
+
+ sha256_blocks = sha256_blocks_c;
+}
+
+//==============================================================================
+// Return the name of the SHA-256 method in use.
+//
+//   pass: void
+// return: char *                       method name
+//==============================================================================
+char *sha256_method (void)
+{
+ sha256_select();
+ return sha256_method_name;
+}
+
+//==============================================================================
+// Initialise a SHA-256 context.
+//
+//   pass: sha256_ctx_t *ctx
+// return: void
+//==============================================================================
+void sha256_init_ctx (sha256_ctx_t *ctx)
+{
+ static const uint32_t h[8] =
+ {
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+  0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+ };
+
+ sha256_select();
+
+ memcpy(ctx->state, h, sizeof(h));
+ ctx->total = 0;
+ ctx->buflen = 0;
+}
+
+//==============================================================================
+// Add bytes to a SHA-256 context.
+//
+//   pass: const void *buffer           data
+//         size_t len                   length of data
+//         sha256_ctx_t *ctx
+// return: void
+//==============================================================================
+void sha256_process_bytes (const void *buffer, size_t len, sha256_ctx_t *ctx)
+{
+ const uint8_t *p = buffer;
+ size_t n;
+
+ ctx->total += len;
+
+ // complete a partly filled block first
+ if (ctx->buflen)
+    {
+     n = 64 - ctx->buflen;
+     if (n > len)
+        n = len;
+     memcpy(ctx->buffer + ctx->buflen, p, n);
+     ctx->buflen += n;
+     p += n;
+     len -= n;
+     if (ctx->buflen < 64)
+        return;
+     sha256_blocks(ctx->state, ctx->buffer, 1);
+     ctx->buflen = 0;
+    }
+
+ // whole blocks are processed in place
+ if (len >= 64)
+    {
+     sha256_blocks(ctx->state, p, len / 64);
+     p += len & ~(size_t)63;
+     len &= 63;
+    }
+
+ memcpy(ctx->buffer, p, len);
+ ctx->buflen = len;
+}
+
+//==============================================================================
+// Finish a SHA-256 context and return the digest.
+//
+//   pass: sha256_ctx_t *ctx
+//         void *resbuf                 32 byte digest returned here
+// return: void *                       resbuf
+//==============================================================================
+void *sha256_finish_ctx (sha256_ctx_t *ctx, void *resbuf)
+{
+ uint64_t bits = ctx->total * 8;
+ uint8_t *r = resbuf;
+ int i;
+
+ // pad with a 1 bit then 0s, the length goes in the last 8 bytes
+ ctx->buffer[ctx->buflen++] = 0x80;
+ if (ctx->buflen > 56)
+    {
+     memset(ctx->buffer + ctx->buflen, 0, 64 - ctx->buflen);
+     sha256_blocks(ctx->state, ctx->buffer, 1);
+     ctx->buflen = 0;
+    }
+ memset(ctx->buffer + ctx->buflen, 0, 56 - ctx->buflen);
+
+ for (i = 0; i < 8; i++)
+    ctx->buffer[56 + i] = bits >> (56 - i * 8);
+ sha256_blocks(ctx->state, ctx->buffer, 1);
+
+ for (i = 0; i < 8; i++)
+    {
+     r[i*4] = ctx->state[i] >> 24;
+     r[i*4+1] = ctx->state[i] >> 16;
+     r[i*4+2] = ctx->state[i] >> 8;
+     r[i*4+3] = ctx->state[i];
+    }
+
+ return resbuf;
+}
+
+//==============================================================================
+// Compute the SHA-256 digest of a memory block.
+//
+//   pass: const void *buffer           data
+//         size_t len                   length of data
+//         void *resbuf                 32 byte digest returned here
+// return: void *                       resbuf
+//==============================================================================
+void *sha256_buffer (const void *buffer, size_t len, void *resbuf)
+{
+ sha256_ctx_t ctx;
+
+ sha256_init_ctx(&ctx);
+ sha256_process_bytes(buffer, len, &ctx);
+ return sha256_finish_ctx(&ctx, resbuf);
+}
@@ -0,0 +1,25 @@
+/* SHA256 header */
+
+#ifndef HEADER_SHA256_H
+#define HEADER_SHA256_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SHA256_DIGEST_SIZE 32
+
+typedef struct sha256_ctx_t
+{
+ uint32_t state[8];
+ uint64_t total;
+ size_t buflen;
+ uint8_t buffer[64];
+} sha256_ctx_t;
+
+void sha256_init_ctx (sha256_ctx_t *ctx);
+void sha256_process_bytes (const void *buffer, size_t len, sha256_ctx_t *ctx);
+void *sha256_finish_ctx (sha256_ctx_t *ctx, void *resbuf);
+void *sha256_buffer (const void *buffer, size_t len, void *resbuf);
+char *sha256_method (void);
+
+#endif     /* HEADER_SHA256_H */
@@ -0,0 +1,419 @@
+//******************************************************************************
+//*                                 uBeeDisk                                   *
+//*                                                                            *
+//*     A tool for converting disks/images from one to another with auto       *
+//*                   detection options for Microbee disks.                    *
+//*                                                                            *
+//*                               sidecar module                               *
+//*                                                                            *
+//*                       Copyright (C) 2008-2026 uBee                         *
+//******************************************************************************
+//
+// Structured 'info' sidecar files.
+//
+// The same sequence of calls writes either a JSON file (RFC 8259) or a CBOR
+// file (RFC 8949).  Maps and arrays are opened with sidecar_map() and
+// sidecar_array() and closed with sidecar_end(), a key is passed for each
+// item in a map and NULL for items in an array.  CBOR maps and arrays use
+// the indefinite length encoding so that no item counts are needed before
+// the items are written.
+//
+// The JSON output is indented for reading, arrays of numbers and strings
+// are kept on one line so that a track's sector status map is one line.
+//
+//==============================================================================
+// ChangeLog (most recent entries are at top)
+//==============================================================================
+// v4.1.0 - 17 October 2026, uBee
+// - Initial file created.
+//==============================================================================
+/*
+ *  uBeeDisk - A tool for converting disks/images from one to another with
+ *  auto detection options for Microbee disks.
+ *  Copyright (C) 2008-2026 uBee
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+//==============================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <libdsk.h>
+
+#include "sidecar.h"
+#include "ubeedisk.h"
+#include "functions.h"
+
+//==============================================================================
+// structures and variables
+//==============================================================================
+static char *sidecar_names[] =
+{
+ "json",
+ "cbor",
+ ""
+};
+
+// CBOR major types
+#define CBOR_UINT   0
+#define CBOR_NINT   1
+#define CBOR_TEXT   3
+#define CBOR_ARRAY  4
+#define CBOR_MAP    5
+
+#define CBOR_FALSE  0xf4
+#define CBOR_TRUE   0xf5
+#define CBOR_INDEF  0x1f
+#define CBOR_BREAK  0xff
+
+//==============================================================================
+// Return the file name extension used for a sidecar format.
+//
+//   pass: int fmt                      SIDECAR_* value
+// return: char *                       extension
+//==============================================================================
+char *sidecar_ext (int fmt)
+{
+ return sidecar_names[fmt];
+}
+
+//==============================================================================
+// Parse a comma separated list of sidecar formats.
+//
+//   pass: char *list                   list of format names or 'none'
+// return: int                          SIDECAR_BIT() values, -1 if error
+//==============================================================================
+int sidecar_parse (char *list)
+{
+ char s[100];
+ int fmts = 0;
+ int fmt;
+ int x;
+
+ if (strcmp(list, "none") == 0)
+    return 0;
+
+ while (list)
+    {
+     list = get_next_parameter(list, ',', s, &x, sizeof(s)-1);
+     fmt = string_search(sidecar_names, s);
+     if (fmt == -1)
+        return -1;
+     fmts |= SIDECAR_BIT(fmt);
+    }
+
+ return fmts;
+}
+
+//==============================================================================
+// Write a CBOR item head.
+//
+//   pass: sidecar_t *sc
+//         int major                    CBOR major type
+//         uint64_t value               argument value
+// return: void
+//==============================================================================
+static void cbor_head (sidecar_t *sc, int major, uint64_t value)
+{
+ uint8_t b[9];
+ int n;
+ int i;
+
+ major <<= 5;
+
+ if (value < 24)
+    {
+     fputc(major | (int)value, sc->f);
+     return;
+    }
+
+ if (value < 0x100)
+    {
+     b[0] = major | 24;
+     n = 1;
+    }
+ else if (value < 0x10000)
+    {
+     b[0] = major | 25;
+     n = 2;
+    }
+ else if (value < 0x100000000ULL)
+    {
+     b[0] = major | 26;
+     n = 4;
+    }
+ else
+    {
+     b[0] = major | 27;
+     n = 8;
+    }
+
+ // the argument is big endian
+ for (i = n; i > 0; i--)
+    {
+     b[i] = value & 0xff;
+     value >>= 8;
+    }
+
+ fwrite(b, n + 1, 1, sc->f);
+}
+
+//==============================================================================
+// Write a string as a CBOR text string or a JSON string.
+//
+//   pass: sidecar_t *sc
+//         char *s                      string
+// return: void
+//==============================================================================
+static void sidecar_string (sidecar_t *sc, const char *s)
+{
+ unsigned char c;
+
+ if (sc->fmt == SIDECAR_CBOR)
+    {
+     cbor_head(sc, CBOR_TEXT, strlen(s));
+     fputs(s, sc->f);
+     return;
+    }
+
+ fputc('"', sc->f);
+ while ((c = *s++))
+    {
+     if (c == '"' || c == '\\')
+        fprintf(sc->f, "\\%c", c);
+     else if (c == '\n')
+        fputs("\\n", sc->f);
+     else if (c == '\t')
+        fputs("\\t", sc->f);
+     else if (c < 0x20)
+        fprintf(sc->f, "\\u%04x", c);
+     else
+        fputc(c, sc->f);
+    }
+ fputc('"', sc->f);
+}
+
+//==============================================================================
+// Start a new item in the current map or array.
+//
+// The JSON separator, new line and indenting are written for the item.
+// Items in a map and maps or arrays in an array are placed on new lines.
+//
+//   pass: sidecar_t *sc
+//         char *key                    key if in a map, else NULL
+//         int container                1 if the item is a map or array
+// return: void
+//==============================================================================
+static void sidecar_item (sidecar_t *sc, char *key, int container)
+{
+ int cur = sc->depth - 1;
+
+ if (sc->depth == 0)
+    return;
+
+ if (sc->fmt == SIDECAR_JSON)
+    {
+     if (sc->is_map[cur] || container)
+        {
+         fprintf(sc->f, "%s\n%*s", sc->items[cur]? "," : "",
+         sc->depth * 2, "");
+         sc->lines[cur] = 1;
+        }
+     else if (sc->items[cur])
+        fputs(", ", sc->f);
+    }
+
+ if (key && sc->is_map[cur])
+    {
+     sidecar_string(sc, key);
+     if (sc->fmt == SIDECAR_JSON)
+        fputs(": ", sc->f);
+    }
+
+ sc->items[cur]++;
+}
+
+//==============================================================================
+// Open a map or array.
+//
+//   pass: sidecar_t *sc
+//         char *key                    key if in a map, else NULL
+//         int is_map                   1 for a map, 0 for an array
+// return: void
+//==============================================================================
+static void sidecar_open_container (sidecar_t *sc, char *key, int is_map)
+{
+ if (sc->depth == SIDECAR_DEPTH)
+    return;
+
+ sidecar_item(sc, key, 1);
+
+ if (sc->fmt == SIDECAR_CBOR)
+    fputc(((is_map? CBOR_MAP : CBOR_ARRAY) << 5) | CBOR_INDEF, sc->f);
+ else
+    fputc(is_map? '{' : '[', sc->f);
+
+ sc->items[sc->depth] = 0;
+ sc->is_map[sc->depth] = is_map;
+ sc->lines[sc->depth] = 0;
+ sc->depth++;
+}
+
+//==============================================================================
+// Create a sidecar file.
+//
+//   pass: sidecar_t *sc
+//         char *filename
+//         int fmt                      SIDECAR_* value
+// return: int                          0 if no error, else -1
+//==============================================================================
+int sidecar_open (sidecar_t *sc, char *filename, int fmt)
+{
+ memset(sc, 0, sizeof(sidecar_t));
+ sc->fmt = fmt;
+
+ if ((sc->f = fopen(filename, (fmt == SIDECAR_CBOR)? "wb" : "w")) == NULL)
+    return -1;
+
+ return 0;
+}
+
+//==============================================================================
+// Close a sidecar file.
+//
+// Any maps or arrays still open are closed first.
+//
+//   pass: sidecar_t *sc
+// return: int                          0 if no error, else -1
+//==============================================================================
+int sidecar_close (sidecar_t *sc)
+{
+ int res;
+
+ while (sc->depth)
+    sidecar_end(sc);
+
+ res = ferror(sc->f);
+ if (fclose(sc->f) != 0)
+    res = -1;
+ sc->f = NULL;
+
+ return res? -1 : 0;
+}
+
+//==============================================================================
+// Open a map.
+//
+//   pass: sidecar_t *sc
+//         char *key                    key if in a map, else NULL
+// return: void
+//==============================================================================
+void sidecar_map (sidecar_t *sc, char *key)
+{
+ sidecar_open_container(sc, key, 1);
+}
+
+//==============================================================================
+// Open an array.
+//
+//   pass: sidecar_t *sc
+//         char *key                    key if in a map, else NULL
+// return: void
+//==============================================================================
+void sidecar_array (sidecar_t *sc, char *key)
+{
+ sidecar_open_container(sc, key, 0);
+}
+
+//==============================================================================
+// Close the current map or array.
+//
+//   pass: sidecar_t *sc
+// return: void
+//==============================================================================
+void sidecar_end (sidecar_t *sc)
+{
+ int cur = sc->depth - 1;
+
+ if (sc->depth == 0)
+    return;
+
+ if (sc->fmt == SIDECAR_CBOR)
+    fputc(CBOR_BREAK, sc->f);
+ else
+    {
+     if (sc->lines[cur])
+        fprintf(sc->f, "\n%*s", cur * 2, "");
+     fputc(sc->is_map[cur]? '}' : ']', sc->f);
+     if (cur == 0)
+        fputc('\n', sc->f);
+    }
+
+ sc->depth--;
+}
+
+//==============================================================================
+// Write an integer item.
+//
+//   pass: sidecar_t *sc
+//         char *key                    key if in a map, else NULL
+//         long long value
+// return: void
+//==============================================================================
+void sidecar_int (sidecar_t *sc, char *key, long long value)
+{
+ sidecar_item(sc, key, 0);
+
+ if (sc->fmt == SIDECAR_JSON)
+    fprintf(sc->f, "%lld", value);
+ else if (value >= 0)
+    cbor_head(sc, CBOR_UINT, (uint64_t)value);
+ else
+    cbor_head(sc, CBOR_NINT, (uint64_t)(-1 - value));
+}
+
+//==============================================================================
+// Write a string item.
+//
+//   pass: sidecar_t *sc
+//         char *key                    key if in a map, else NULL
+//         const char *value
+// return: void
+//==============================================================================
+void sidecar_str (sidecar_t *sc, char *key, const char *value)
+{
+ sidecar_item(sc, key, 0);
+ sidecar_string(sc, value);
+}
+
+//==============================================================================
+// Write a boolean item.
+//
+//   pass: sidecar_t *sc
+//         char *key                    key if in a map, else NULL
+//         int value
+// return: void
+//==============================================================================
+void sidecar_bool (sidecar_t *sc, char *key, int value)
+{
+ sidecar_item(sc, key, 0);
+
+ if (sc->fmt == SIDECAR_JSON)
+    fputs(value? "true" : "false", sc->f);
+ else
+    fputc(value? CBOR_TRUE : CBOR_FALSE, sc->f);
+}
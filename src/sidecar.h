@@ -0,0 +1,39 @@
+/* Sidecar header */
+
+#ifndef HEADER_SIDECAR_H
+#define HEADER_SIDECAR_H
+
+#include <stdio.h>
+
+enum
+{
+ SIDECAR_JSON,
+ SIDECAR_CBOR,
+ SIDECAR_COUNT
+};
+
+#define SIDECAR_BIT(x) (1 << (x))
+#define SIDECAR_DEPTH 16
+
+typedef struct sidecar_t
+{
+ FILE *f;
+ int fmt;
+ int depth;
+ int items[SIDECAR_DEPTH];    // items written at each level
+ int is_map[SIDECAR_DEPTH];   // level is a map, else an array
+ int lines[SIDECAR_DEPTH];    // JSON items at this level are on new lines
+} sidecar_t;
+
+char *sidecar_ext (int fmt);
+int sidecar_parse (char *list);
+int sidecar_open (sidecar_t *sc, char *filename, int fmt);
+int sidecar_close (sidecar_t *sc);
+void sidecar_map (sidecar_t *sc, char *key);
+void sidecar_array (sidecar_t *sc, char *key);
+void sidecar_end (sidecar_t *sc);
+void sidecar_int (sidecar_t *sc, char *key, long long value);
+void sidecar_str (sidecar_t *sc, char *key, const char *value);
+void sidecar_bool (sidecar_t *sc, char *key, int value);
+
+#endif     /* HEADER_SIDECAR_H */
@@ -0,0 +1,1234 @@
+//******************************************************************************
+//*                                 uBeeDisk                                   *
+//*                                                                            *
+//*     A tool for converting disks/images from one to another with auto       *
+//*                   detection options for Microbee disks.                    *
+//*                                                                            *
+//*                          simulated drive module                            *
+//*                                                                            *
+//*                       Copyright (C) 2008-2026 uBee                         *
+//******************************************************************************
+//
+// Simulated floppy drive (--itype=sim).
+//
+// A disk image is read as if it was in a real floppy drive so the retry,
+// unattended, detection, scan and speed code can be tried and timed without
+// any drive hardware.  The drive is described by a profile file (--sim)
+// with one 'key=value' setting per line, '#' starts a comment:
+//
+//   type=x          image type (dsk, edsk, raw, ...), default is to let
+//                   LibDsk work it out
+//   rpm=n           rotational speed, default 300
+//   step=n          ms to step one cylinder, default 6
+//   settle=n        ms for the head to settle after stepping, default 15
+//   interleave=n    physical sector interleave of each track, default 1
+//   skew=n          sectors each cylinder is rotated by, default 0
+//   side1as0=x      side 1 sector IDs have a side ID of 0 if x=on (as on
+//                   Microbee disks), default off
+//   error=p         probability of any sector read failing, default 0
+//   bad=c,h,s[,p]   sector s (physical number) on cylinder c head h fails
+//                   with probability p, default 1 (may be repeated)
+//   weak=c,h,s[,p]  sector s is weak, the data differs each time it's read
+//                   and it fails with probability p, default 0.5 (may be
+//                   repeated)
+//   firstread=x     the first read after the drive is opened fails if x=on
+//                   (as some drives do before the head has settled)
+//   seed=n          random number seed so runs can be repeated, default 1
+//   scale=n         part of the drive's time that is really waited, 0 for
+//                   none (default) to 1 for real time
+//
+// The drive keeps track of the head position and where each sector is
+// under the head from the time.  Steps, settling, waiting for a sector to
+// come around, sector transfers, missing sectors (2 revolutions) and the
+// 'settle' delays of the read code all take drive time.  The drive time
+// that is not really waited is added to the clock seen by --profile so it
+// shows the time a real drive would have taken.
+//
+// LibDsk does not allow other drivers to be added so the input drive calls
+// that the simulation needs to see use the sim_*() functions in place of the
+// dsk_*() ones, these pass straight on to LibDsk if the drive is not being
+// simulated.  LibDsk's own retries (--retry-l1) are not simulated.
+//
+// The sim_*() calls also record the input drive calls to a trace (--trace)
+// and replay them from one (--itype=replay, see trace.c).  A replayed call
+// takes the drive time it took when it was recorded, a call that is not in
+// the trace fails as a missing sector.
+//
+//==============================================================================
+// ChangeLog (most recent entries are at top)
+//==============================================================================
+// v4.1.0 - 17 October 2026, uBee
+// - Added trace recording and the replay drive (sim_replay_open()).
+// - Initial file created.
+//==============================================================================
+/*
+ *  uBeeDisk - A tool for converting disks/images from one to another with
+ *  auto detection options for Microbee disks.
+ *  Copyright (C) 2008-2026 uBee
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+//==============================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include <libdsk.h>
+
+#include "simdrive.h"
+#include "trace.h"
+#include "ubeedisk.h"
+#include "functions.h"
+
+//==============================================================================
+// structures and variables
+//==============================================================================
+static SESSION_LOCAL sim_t sim;
+
+//==============================================================================
+// Get a random number.
+//
+//   pass: void
+// return: double                       0 to less than 1
+//==============================================================================
+static double sim_random (void)
+{
+ // xorshift64*
+ sim.rng ^= sim.rng >> 12;
+ sim.rng ^= sim.rng << 25;
+ sim.rng ^= sim.rng >> 27;
+ return ((sim.rng * 2685821657736338717ULL) >> 11) *
+        (1.0 / 9007199254740992.0);
+}
+
+//==============================================================================
+// Get the drive's clock.
+//
+//   pass: void
+// return: uint64_t                     time in nanoseconds
+//==============================================================================
+static uint64_t sim_now (void)
+{
+ return time_get_ns() + sim.delay_ns;
+}
+
+//==============================================================================
+// Spend some drive time.
+//
+// The part of the time set by 'scale' is really waited, the rest is only
+// added to the clock.
+//
+//   pass: uint64_t ns                  drive time
+// return: void
+//==============================================================================
+static void sim_wait (uint64_t ns)
+{
+ uint64_t real;
+
+ sim.drive_ns += ns;
+
+ real = (uint64_t)(ns * sim.scale);
+ if (real >= 1000000)
+    {
+     sleep_ms((int)(real / 1000000));
+     real = (real / 1000000) * 1000000;
+    }
+ else
+    real = 0;
+
+ sim.delay_ns += ns - real;
+}
+
+//==============================================================================
+// Get the time of one revolution.
+//
+//   pass: void
+// return: uint64_t                     time in nanoseconds
+//==============================================================================
+static uint64_t sim_rev_ns (void)
+{
+ return (uint64_t)(60000000000.0 / sim.rpm);
+}
+
+//==============================================================================
+// Move the head to a cylinder.
+//
+// If the head position is not known the drive is recalibrated first.
+//
+//   pass: dsk_pcyl_t cyl
+// return: void
+//==============================================================================
+static void sim_seek (dsk_pcyl_t cyl)
+{
+ int steps;
+
+ if (sim.cyl == (int)cyl)
+    return;
+
+ if (sim.cyl == -1)
+    steps = cyl + 80;
+ else
+    steps = abs((int)cyl - sim.cyl);
+
+ sim_wait((uint64_t)((steps * sim.step_ms + sim.settle_ms) * 1000000.0));
+ sim.cyl = cyl;
+ sim.seeks++;
+}
+
+//==============================================================================
+// Work out the physical layout of a track.
+//
+// slot[i] is the position around the track of sector index i and inv[] is
+// the sector index at each position.
+//
+//   pass: int n                        sectors on the track
+//         dsk_pcyl_t cyl
+//         int *slot
+//         int *inv
+// return: void
+//==============================================================================
+static void sim_layout (int n, dsk_pcyl_t cyl, int *slot, int *inv)
+{
+ char used[SIM_SECTORS_MAX];
+ int p = 0;
+ int i;
+
+ memset(used, 0, sizeof(used));
+
+ for (i = 0; i < n; i++)
+    {
+     while (used[p])
+        p = (p + 1) % n;
+     used[p] = 1;
+     slot[i] = (p + cyl * sim.skew) % n;
+     inv[slot[i]] = i;
+     p = (p + sim.interleave) % n;
+    }
+}
+
+//==============================================================================
+// Wait for a position on the track to come under the head.
+//
+//   pass: int n                        sectors on the track
+//         int pos                      sector position
+// return: void
+//==============================================================================
+static void sim_wait_slot (int n, int pos)
+{
+ uint64_t rev = sim_rev_ns();
+ uint64_t start = rev * pos / n;
+ uint64_t cur = sim_now() % rev;
+
+ sim_wait((start + rev - cur) % rev);
+}
+
+//==============================================================================
+// Get the side ID recorded on a side.
+//
+//   pass: dsk_phead_t head
+// return: int
+//==============================================================================
+static int sim_side_id (dsk_phead_t head)
+{
+ return sim.side1as0? 0 : head;
+}
+
+//==============================================================================
+// Find a sector's error settings.
+//
+//   pass: int cyl
+//         int head
+//         int sect                     physical sector number
+// return: sim_sect_t *                 NULL if none
+//==============================================================================
+static sim_sect_t *sim_sect_find (int cyl, int head, int sect)
+{
+ int i;
+
+ for (i = 0; i < sim.sects_count; i++)
+    if (sim.sects[i].cyl == cyl && sim.sects[i].head == head &&
+        sim.sects[i].sect == sect)
+       return &sim.sects[i];
+
+ return NULL;
+}
+
+//==============================================================================
+// Apply the error settings to a sector just read.
+//
+// A weak sector has a few bits changed each time.  A failed read has some
+// bytes damaged.
+//
+//   pass: int cyl
+//         int head
+//         int sect                     physical sector number
+//         uint8_t *p                   sector data
+//         size_t len
+// return: dsk_err_t                    DSK_ERR_OK or DSK_ERR_DATAERR
+//==============================================================================
+static dsk_err_t sim_sect_read (int cyl, int head, int sect, uint8_t *p,
+                                size_t len)
+{
+ sim_sect_t *s;
+ double prob = sim.error;
+ int i;
+ int n;
+
+ sim.reads++;
+
+ if ((s = sim_sect_find(cyl, head, sect)) != NULL)
+    {
+     prob = s->prob;
+     if (s->weak && len)
+        {
+         n = 1 + (int)(sim_random() * 4);
+         for (i = 0; i < n; i++)
+            p[(size_t)(sim_random() * len)] ^= 1 << (int)(sim_random() * 8);
+        }
+    }
+
+ if (prob <= 0.0 || sim_random() >= prob)
+    return DSK_ERR_OK;
+
+ if (len)
+    p[(size_t)(sim_random() * len)] ^= 0xff;
+ sim.errors++;
+
+ return DSK_ERR_DATAERR;
+}
+
+//==============================================================================
+// Get an on/off profile value.
+//
+//   pass: char *s
+// return: int                          1 if on, 0 if off, -1 if neither
+//==============================================================================
+static int sim_onoff (char *s)
+{
+ if (! strcmp(s, "on") || ! strcmp(s, "1"))
+    return 1;
+ if (! strcmp(s, "off") || ! strcmp(s, "0"))
+    return 0;
+ return -1;
+}
+
+//==============================================================================
+// Add a failing or weak sector from the profile.
+//
+//   pass: char *s                      'c,h,s[,p]' value
+//         int weak
+// return: int                          0 if no error, else -1
+//==============================================================================
+static int sim_sect_add (char *s, int weak)
+{
+ sim_sect_t *temp;
+ sim_sect_t e;
+ int n;
+
+ memset(&e, 0, sizeof(e));
+ e.prob = weak? 0.5 : 1.0;
+ e.weak = weak;
+
+ n = sscanf(s, "%d,%d,%d,%lf", &e.cyl, &e.head, &e.sect, &e.prob);
+ if (n < 3)
+    return -1;
+
+ if (sim.sects_count == sim.sects_size)
+    {
+     temp = realloc(sim.sects, sizeof(sim_sect_t) * (sim.sects_size + 50));
+     if (! temp)
+        return -1;
+     sim.sects = temp;
+     sim.sects_size += 50;
+    }
+ sim.sects[sim.sects_count++] = e;
+
+ return 0;
+}
+
+//==============================================================================
+// Read a drive profile.
+//
+//   pass: char *profile                profile file name
+// return: int                          0 if no error, else -1
+//==============================================================================
+static int sim_profile_read (char *profile)
+{
+ FILE *f;
+ char line[500];
+ char *key;
+ char *val;
+ char *p;
+ int lnum = 0;
+ int err;
+
+ if ((f = fopen(profile, "r")) == NULL)
+    {
+     printf(APPNAME": unable to open simulated drive profile '%s'\n",
+     profile);
+     return -1;
+    }
+
+ while (fgets(line, sizeof(line), f))
+    {
+     lnum++;
+     if ((p = strchr(line, '#')) != NULL)
+        *p = 0;
+     for (p = line + strlen(line); p > line && isspace((int)p[-1]); p--)
+        ;
+     *p = 0;
+     for (key = line; isspace((int)*key); key++)
+        ;
+     if (! *key)
+        continue;
+
+     err = 0;
+     if ((val = strchr(key, '=')) == NULL)
+        err = 1;
+     else
+        {
+         *val++ = 0;
+         if (! strcmp(key, "type"))
+            snprintf(sim.type, sizeof(sim.type), "%s", val);
+         else if (! strcmp(key, "rpm"))
+            err = ((sim.rpm = atof(val)) <= 0.0);
+         else if (! strcmp(key, "step"))
+            err = ((sim.step_ms = atof(val)) < 0.0);
+         else if (! strcmp(key, "settle"))
+            err = ((sim.settle_ms = atof(val)) < 0.0);
+         else if (! strcmp(key, "scale"))
+            err = ((sim.scale = atof(val)) < 0.0 || sim.scale > 1.0);
+         else if (! strcmp(key, "interleave"))
+            err = ((sim.interleave = atoi(val)) < 1);
+         else if (! strcmp(key, "skew"))
+            err = ((sim.skew = atoi(val)) < 0);
+         else if (! strcmp(key, "side1as0"))
+            err = ((sim.side1as0 = sim_onoff(val)) == -1);
+         else if (! strcmp(key, "error"))
+            err = ((sim.error = atof(val)) < 0.0 || sim.error > 1.0);
+         else if (! strcmp(key, "bad"))
+            err = (sim_sect_add(val, 0) == -1);
+         else if (! strcmp(key, "weak"))
+            err = (sim_sect_add(val, 1) == -1);
+         else if (! strcmp(key, "firstread"))
+            err = ((sim.firstread = sim_onoff(val)) == -1);
+         else if (! strcmp(key, "seed"))
+            sim.seed = strtoull(val, NULL, 10);
+         else
+            err = 1;
+        }
+
+     if (err)
+        {
+         printf(APPNAME": simulated drive profile '%s' line %d is not"
+         " valid\n", profile, lnum);
+         fclose(f);
+         return -1;
+        }
+    }
+
+ fclose(f);
+ return 0;
+}
+
+//==============================================================================
+// Open a simulated drive.
+//
+// The profile is read and the image is opened.  The drive time and counts
+// carry on from any earlier opening, see sim_reset_stats().
+//
+//   pass: DSK_PDRIVER *drive           drive opened
+//         char *file                   image file name
+//         char *profile                profile file name or empty
+//         char *comp                   compression type or NULL
+// return: int                          0 if no error, else -1
+//==============================================================================
+int sim_open (DSK_PDRIVER *drive, char *file, char *profile, char *comp)
+{
+ dsk_err_t dsk_err;
+
+ sim_detach();
+
+ *sim.type = 0;
+ sim.rpm = 300.0;
+ sim.step_ms = 6.0;
+ sim.settle_ms = 15.0;
+ sim.scale = 0.0;
+ sim.interleave = 1;
+ sim.skew = 0;
+ sim.side1as0 = 0;
+ sim.error = 0.0;
+ sim.firstread = 0;
+ sim.sects_count = 0;
+ sim.seed = 1;
+ sim.replay = 0;
+
+ if (profile && *profile && sim_profile_read(profile) == -1)
+    return -1;
+
+ dsk_err = dsk_open(drive, file, *sim.type? sim.type : NULL, comp);
+ if (dsk_err != DSK_ERR_OK)
+    {
+     printf(APPNAME": sim_open() - %s\n", dsk_strerror(dsk_err));
+     return -1;
+    }
+
+ if (! sim.rng)
+    sim.rng = sim.seed? sim.seed : 1;
+ sim.drive = *drive;
+ sim.cyl = -1;
+ sim.first = sim.firstread;
+
+ return 0;
+}
+
+//==============================================================================
+// Stop simulating.
+//
+// Called before the input drive is opened so a closed simulated drive is
+// never mistaken for the next drive opened.
+//
+//   pass: void
+// return: void
+//==============================================================================
+void sim_detach (void)
+{
+ sim.drive = NULL;
+ sim.replay = 0;
+
+ if (*sim.temp)
+    {
+     remove(sim.temp);
+     *sim.temp = 0;
+    }
+}
+
+//==============================================================================
+// Test if a drive is being simulated.
+//
+//   pass: void
+// return: int                          1 if simulating
+//==============================================================================
+int sim_active (void)
+{
+ return sim.drive != NULL;
+}
+
+//==============================================================================
+// Reset the drive time, counts and random numbers.
+//
+// Called at the start of each copy so each copy is simulated the same.
+//
+//   pass: void
+// return: void
+//==============================================================================
+void sim_reset_stats (void)
+{
+ sim.drive_ns = 0;
+ sim.seeks = 0;
+ sim.reads = 0;
+ sim.errors = 0;
+ sim.unmatched = 0;
+ sim.rng = sim.seed? sim.seed : 1;
+}
+
+//==============================================================================
+// Report the drive time and counts.
+//
+//   pass: void
+// return: void
+//==============================================================================
+void sim_report (void)
+{
+ if (! sim_active())
+    return;
+
+ if (sim.replay)
+    {
+     printf("\nReplayed drive: %.3f s drive time, %lu calls, %lu not in the"
+     " trace\n", (double)sim.drive_ns / 1e9, sim.reads, sim.unmatched);
+     return;
+    }
+
+ printf("\nSimulated drive: %.3f s drive time, %lu seeks, %lu sector reads,"
+ " %lu read errors\n", (double)sim.drive_ns / 1e9, sim.seeks, sim.reads,
+ sim.errors);
+}
+
+//==============================================================================
+// Get the drive time that was not really waited by this thread.
+//
+//   pass: void
+// return: uint64_t                     nanoseconds
+//==============================================================================
+uint64_t sim_delay_ns (void)
+{
+ return sim.delay_ns;
+}
+
+//==============================================================================
+// Get the clock time including the simulated drive time.
+//
+// Only for measuring intervals.
+//
+//   pass: void
+// return: uint64_t                     milliseconds
+//==============================================================================
+uint64_t sim_time_ms (void)
+{
+ return (time_get_ns() + sim.delay_ns) / 1000000;
+}
+
+//==============================================================================
+// Sleep, a simulated drive only spends drive time.
+//
+//   pass: int ms
+// return: void
+//==============================================================================
+void sim_sleep_ms (int ms)
+{
+ if (sim_active())
+    sim_wait((uint64_t)ms * 1000000);
+ else
+    sleep_ms(ms);
+}
+
+//==============================================================================
+// Read the next sector ID to pass under the head.
+//
+//   pass: as for dsk_psecid()
+// return: dsk_err_t
+//==============================================================================
+static dsk_err_t sim_psecid_drive (DSK_PDRIVER self,
+                                   const DSK_GEOMETRY *geom, dsk_pcyl_t cyl,
+                                   dsk_phead_t head, DSK_FORMAT *result)
+{
+ int slot[SIM_SECTORS_MAX];
+ int inv[SIM_SECTORS_MAX];
+ uint64_t rev;
+ int n = geom->dg_sectors;
+ int pos;
+
+ if (! self || self != sim.drive)
+    return dsk_psecid(self, geom, cyl, head, result);
+
+ if (n < 1 || n > SIM_SECTORS_MAX)
+    return DSK_ERR_NOADDR;
+
+ sim_seek(cyl);
+ sim_layout(n, cyl, slot, inv);
+
+ // the next sector to start after the current position
+ rev = sim_rev_ns();
+ pos = (int)(((sim_now() % rev) * n + rev - 1) / rev) % n;
+ sim_wait_slot(n, pos);
+ sim_wait(rev / n / 10);
+
+ result->fmt_cylinder = cyl;
+ result->fmt_head = sim_side_id(head);
+ result->fmt_sector = inv[pos] + geom->dg_secbase;
+ result->fmt_secsize = geom->dg_secsize;
+
+ return DSK_ERR_OK;
+}
+
+//==============================================================================
+// Read all the sector IDs of a track in physical order.
+//
+//   pass: as for dsk_ptrackids()
+// return: dsk_err_t
+//==============================================================================
+static dsk_err_t sim_ptrackids_drive (DSK_PDRIVER self,
+                                      const DSK_GEOMETRY *geom,
+                                      dsk_pcyl_t cyl, dsk_phead_t head,
+                                      dsk_psect_t *count, DSK_FORMAT **result)
+{
+ int slot[SIM_SECTORS_MAX];
+ int inv[SIM_SECTORS_MAX];
+ DSK_FORMAT *ids;
+ int n = geom->dg_sectors;
+ int i;
+
+ if (! self || self != sim.drive)
+    return dsk_ptrackids(self, geom, cyl, head, count, result);
+
+ if (n < 1 || n > SIM_SECTORS_MAX)
+    return DSK_ERR_NOADDR;
+
+ if ((ids = malloc(sizeof(DSK_FORMAT) * n)) == NULL)
+    return DSK_ERR_NOMEM;
+
+ sim_seek(cyl);
+ sim_layout(n, cyl, slot, inv);
+
+ // wait for the index hole then read the whole track
+ sim_wait_slot(n, 0);
+ sim_wait(sim_rev_ns());
+
+ for (i = 0; i < n; i++)
+    {
+     ids[i].fmt_cylinder = cyl;
+     ids[i].fmt_head = sim_side_id(head);
+     ids[i].fmt_sector = inv[i] + geom->dg_secbase;
+     ids[i].fmt_secsize = geom->dg_secsize;
+    }
+
+ *count = n;
+ *result = ids;
+
+ return DSK_ERR_OK;
+}
+
+//==============================================================================
+// Read a sector.
+//
+// The sector IDs must match those expected or the sector is not found after
+// 2 revolutions.
+//
+//   pass: as for dsk_xread()
+// return: dsk_err_t
+//==============================================================================
+static dsk_err_t sim_xread_drive (DSK_PDRIVER self,
+                                  const DSK_GEOMETRY *geom, void *buf,
+                                  dsk_pcyl_t cyl, dsk_phead_t head,
+                                  dsk_pcyl_t cyl_expected,
+                                  dsk_phead_t head_expected,
+                                  dsk_psect_t sector, size_t sector_len,
+                                  int *deleted)
+{
+ int slot[SIM_SECTORS_MAX];
+ int inv[SIM_SECTORS_MAX];
+ dsk_err_t dsk_err;
+ int n = geom->dg_sectors;
+ int i = sector - geom->dg_secbase;
+
+ if (! self || self != sim.drive)
+    return dsk_xread(self, geom, buf, cyl, head, cyl_expected,
+    head_expected, sector, sector_len, deleted);
+
+ sim_seek(cyl);
+
+ if (sim.first)
+    {
+     sim.first = 0;
+     sim_wait(sim_rev_ns());
+     return DSK_ERR_NOTRDY;
+    }
+
+ if (n < 1 || n > SIM_SECTORS_MAX || i < 0 || i >= n ||
+     cyl_expected != cyl || (int)head_expected != sim_side_id(head))
+    {
+     sim_wait(sim_rev_ns() * 2);
+     return DSK_ERR_NOADDR;
+    }
+
+ sim_layout(n, cyl, slot, inv);
+ sim_wait_slot(n, slot[i]);
+ sim_wait(sim_rev_ns() / n);
+
+ // the image may not hold the IDs the drive has, so fall back to reading
+ // it by position
+ dsk_err = dsk_xread(self, geom, buf, cyl, head, cyl_expected,
+ head_expected, sector, sector_len, deleted);
+ if (dsk_err != DSK_ERR_OK)
+    dsk_err = dsk_pread(self, geom, buf, cyl, head, sector);
+ if (dsk_err != DSK_ERR_OK)
+    return dsk_err;
+
+ return sim_sect_read(cyl, head, sector, buf, sector_len);
+}
+
+//==============================================================================
+// Read a sector.
+//
+//   pass: as for dsk_pread()
+// return: dsk_err_t
+//==============================================================================
+static dsk_err_t sim_pread_drive (DSK_PDRIVER self,
+                                  const DSK_GEOMETRY *geom, void *buf,
+                                  dsk_pcyl_t cyl, dsk_phead_t head,
+                                  dsk_psect_t sector)
+{
+ if (! self || self != sim.drive)
+    return dsk_pread(self, geom, buf, cyl, head, sector);
+
+ return sim_xread_drive(self, geom, buf, cyl, head, cyl, sim_side_id(head),
+ sector, geom->dg_secsize, NULL);
+}
+
+//==============================================================================
+// Read a whole track from the index hole.
+//
+//   pass: as for dsk_ptread()
+// return: dsk_err_t
+//==============================================================================
+static dsk_err_t sim_ptread_drive (DSK_PDRIVER self,
+                                   const DSK_GEOMETRY *geom, void *buf,
+                                   dsk_pcyl_t cyl, dsk_phead_t head)
+{
+ dsk_err_t dsk_err;
+ dsk_err_t res = DSK_ERR_OK;
+ uint8_t *p;
+ int n = geom->dg_sectors;
+ int i;
+
+ if (! self || self != sim.drive)
+    return dsk_ptread(self, geom, buf, cyl, head);
+
+ sim_seek(cyl);
+ sim_wait_slot(n? n : 1, 0);
+ sim_wait(sim_rev_ns());
+
+ for (i = 0; i < n; i++)
+    {
+     p = (uint8_t *)buf + geom->dg_secsize * i;
+     dsk_err = dsk_pread(self, geom, p, cyl, head, geom->dg_secbase + i);
+     if (dsk_err == DSK_ERR_OK)
+        dsk_err = sim_sect_read(cyl, head, geom->dg_secbase + i, p,
+        geom->dg_secsize);
+     if (dsk_err != DSK_ERR_OK)
+        res = dsk_err;
+    }
+
+ return res;
+}
+
+//==============================================================================
+// Get the drive status.
+//
+//   pass: as for dsk_drive_status()
+// return: dsk_err_t
+//==============================================================================
+static dsk_err_t sim_drive_status_drive (DSK_PDRIVER self,
+                                         const DSK_GEOMETRY *geom,
+                                         dsk_phead_t head,
+                                         unsigned char *status)
+{
+ if (! self || self != sim.drive)
+    return dsk_drive_status(self, geom, head, status);
+
+ *status = DSK_ST3_READY;
+ if (sim.cyl == 0)
+    *status |= DSK_ST3_TRACK0;
+
+ return DSK_ERR_OK;
+}
+
+//==============================================================================
+// Open a drive replaying a recorded trace (--itype=replay).
+//
+// The trace must already be loaded (trace_replay_open()).  LibDsk still
+// needs a drive for the settings the copy makes so an empty raw image is
+// created in a temporary file for it.
+//
+//   pass: DSK_PDRIVER *drive           drive opened
+// return: int                          0 if no error, else -1
+//==============================================================================
+int sim_replay_open (DSK_PDRIVER *drive)
+{
+ dsk_err_t dsk_err;
+ char *tmpdir = getenv("TMPDIR");
+#ifndef WIN32
+ int fd;
+#endif
+
+ sim_detach();
+
+ if (! trace_replaying())
+    {
+     printf(APPNAME": sim_replay_open() - no trace loaded\n");
+     return -1;
+    }
+
+#ifdef WIN32
+ snprintf(sim.temp, sizeof(sim.temp), "%s", tmpnam(NULL));
+#else
+ snprintf(sim.temp, sizeof(sim.temp), "%s/ubeedisk-XXXXXX",
+ (tmpdir && *tmpdir)? tmpdir : "/tmp");
+ if ((fd = mkstemp(sim.temp)) != -1)
+    close(fd);
+#endif
+
+ dsk_err = dsk_creat(drive, sim.temp, "raw", NULL);
+ if (dsk_err != DSK_ERR_OK)
+    {
+     printf(APPNAME": sim_replay_open() - %s\n", dsk_strerror(dsk_err));
+     remove(sim.temp);
+     *sim.temp = 0;
+     return -1;
+    }
+#ifndef WIN32
+ // the file is not needed once it's open
+ remove(sim.temp);
+ *sim.temp = 0;
+#endif
+
+ sim.rpm = 300.0;
+ sim.scale = 0.0;
+ sim.drive = *drive;
+ sim.replay = 1;
+
+ return 0;
+}
+
+//==============================================================================
+// Spend the time a replayed call took.
+//
+// A call that is not in the trace takes 2 revolutions, as for a sector
+// that is not found.
+//
+//   pass: trace_call_t *c              call or NULL
+// return: void
+//==============================================================================
+static void sim_replay_wait (trace_call_t *c)
+{
+ sim.reads++;
+ if (c)
+    sim_wait((uint64_t)c->us * 1000);
+ else
+    {
+     sim.unmatched++;
+     sim_wait(sim_rev_ns() * 2);
+    }
+}
+
+//==============================================================================
+// Record an input drive call (--trace).
+//
+//   pass: trace_call_t *c
+//         uint64_t t                   sim_now() at the start of the call
+// return: void
+//==============================================================================
+static void sim_record (trace_call_t *c, uint64_t t)
+{
+ c->us = (sim_now() - t) / 1000;
+ trace_record(c);
+}
+
+//==============================================================================
+// Test if a call is to be replayed.
+//
+//   pass: DSK_PDRIVER self
+// return: int
+//==============================================================================
+static int sim_replaying (DSK_PDRIVER self)
+{
+ return self && self == sim.drive && sim.replay;
+}
+
+//==============================================================================
+// Read the next sector ID to pass under the head.
+//
+// The sim_*() input drive calls below are replayed from a trace, simulated
+// or passed on to LibDsk and recorded if a trace is being recorded.
+//
+//   pass: as for dsk_psecid()
+// return: dsk_err_t
+//==============================================================================
+dsk_err_t sim_psecid (DSK_PDRIVER self, const DSK_GEOMETRY *geom,
+                      dsk_pcyl_t cyl, dsk_phead_t head, DSK_FORMAT *result)
+{
+ trace_call_t c;
+ trace_call_t *r;
+ uint64_t t;
+
+ if (sim_replaying(self))
+    {
+     r = trace_replay_find(TRACE_PSECID, cyl, head, 0, 0, 0);
+     sim_replay_wait(r);
+     if (! r)
+        return DSK_ERR_NOADDR;
+     if (r->err == DSK_ERR_OK && r->count > 0)
+        *result = r->ids[0];
+     return r->err;
+    }
+
+ t = sim_now();
+ memset(&c, 0, sizeof(c));
+ c.err = sim_psecid_drive(self, geom, cyl, head, result);
+ if (trace_recording())
+    {
+     c.call = TRACE_PSECID;
+     c.cyl = cyl;
+     c.head = head;
+     if (c.err == DSK_ERR_OK)
+        {
+         c.count = 1;
+         c.ids = result;
+        }
+     sim_record(&c, t);
+    }
+
+ return c.err;
+}
+
+//==============================================================================
+// Read all the sector IDs of a track in physical order.
+//
+//   pass: as for dsk_ptrackids()
+// return: dsk_err_t
+//==============================================================================
+dsk_err_t sim_ptrackids (DSK_PDRIVER self, const DSK_GEOMETRY *geom,
+                         dsk_pcyl_t cyl, dsk_phead_t head,
+                         dsk_psect_t *count, DSK_FORMAT **result)
+{
+ trace_call_t c;
+ trace_call_t *r;
+ uint64_t t;
+
+ if (sim_replaying(self))
+    {
+     r = trace_replay_find(TRACE_PTRACKIDS, cyl, head, 0, 0, 0);
+     sim_replay_wait(r);
+     if (! r)
+        return DSK_ERR_NOTIMPL;
+     if (r->err != DSK_ERR_OK)
+        return r->err;
+     if ((*result = malloc(sizeof(DSK_FORMAT) * (r->count + 1))) == NULL)
+        return DSK_ERR_NOMEM;
+     memcpy(*result, r->ids, sizeof(DSK_FORMAT) * r->count);
+     *count = r->count;
+     return DSK_ERR_OK;
+    }
+
+ t = sim_now();
+ memset(&c, 0, sizeof(c));
+ c.err = sim_ptrackids_drive(self, geom, cyl, head, count, result);
+ if (trace_recording())
+    {
+     c.call = TRACE_PTRACKIDS;
+     c.cyl = cyl;
+     c.head = head;
+     if (c.err == DSK_ERR_OK)
+        {
+         c.count = *count;
+         c.ids = *result;
+        }
+     sim_record(&c, t);
+    }
+
+ return c.err;
+}
+
+//==============================================================================
+// Serve a replayed sector read.
+//
+//   pass: trace_call_t *r              call or NULL
+//         void *buf
+//         size_t len                   sector length
+//         int *deleted                 deleted data flag or NULL
+// return: dsk_err_t
+//==============================================================================
+static dsk_err_t sim_replay_read (trace_call_t *r, void *buf, size_t len,
+                                  int *deleted)
+{
+ sim_replay_wait(r);
+ if (! r)
+    return DSK_ERR_NOADDR;
+
+ if (r->data)
+    memcpy(buf, r->data, (r->len < len)? r->len : len);
+ if (deleted)
+    *deleted = r->count;
+
+ return r->err;
+}
+
+//==============================================================================
+// Test if the data of a sector read is to be recorded.
+//
+// LibDsk returns the data of a sector with a CRC error.
+//
+//   pass: dsk_err_t err
+// return: int
+//==============================================================================
+static int sim_record_data (dsk_err_t err)
+{
+ return err == DSK_ERR_OK || err == DSK_ERR_DATAERR;
+}
+
+//==============================================================================
+// Read a sector.
+//
+//   pass: as for dsk_xread()
+// return: dsk_err_t
+//==============================================================================
+dsk_err_t sim_xread (DSK_PDRIVER self, const DSK_GEOMETRY *geom, void *buf,
+                     dsk_pcyl_t cyl, dsk_phead_t head,
+                     dsk_pcyl_t cyl_expected, dsk_phead_t head_expected,
+                     dsk_psect_t sector, size_t sector_len, int *deleted)
+{
+ trace_call_t c;
+ trace_call_t *r;
+ uint64_t t;
+
+ if (sim_replaying(self))
+    {
+     // the recording drive may only have had dsk_pread()
+     r = trace_replay_find(TRACE_XREAD, cyl, head, cyl_expected,
+     head_expected, sector);
+     if (! r)
+        r = trace_replay_find(TRACE_PREAD, cyl, head, 0, 0, sector);
+     return sim_replay_read(r, buf, sector_len, deleted);
+    }
+
+ t = sim_now();
+ memset(&c, 0, sizeof(c));
+ c.err = sim_xread_drive(self, geom, buf, cyl, head, cyl_expected,
+ head_expected, sector, sector_len, deleted);
+ if (trace_recording())
+    {
+     c.call = TRACE_XREAD;
+     c.cyl = cyl;
+     c.head = head;
+     c.xcyl = cyl_expected;
+     c.xhead = head_expected;
+     c.sect = sector;
+     c.count = deleted? *deleted : 0;
+     if (sim_record_data(c.err))
+        {
+         c.len = sector_len;
+         c.data = buf;
+        }
+     sim_record(&c, t);
+    }
+
+ return c.err;
+}
+
+//==============================================================================
+// Read a sector.
+//
+//   pass: as for dsk_pread()
+// return: dsk_err_t
+//==============================================================================
+dsk_err_t sim_pread (DSK_PDRIVER self, const DSK_GEOMETRY *geom, void *buf,
+                     dsk_pcyl_t cyl, dsk_phead_t head, dsk_psect_t sector)
+{
+ trace_call_t c;
+ trace_call_t *r;
+ uint64_t t;
+
+ if (sim_replaying(self))
+    {
+     r = trace_replay_find(TRACE_PREAD, cyl, head, 0, 0, sector);
+     if (! r)
+        r = trace_replay_find(TRACE_XREAD, cyl, head, cyl, head, sector);
+     return sim_replay_read(r, buf, geom->dg_secsize, NULL);
+    }
+
+ t = sim_now();
+ memset(&c, 0, sizeof(c));
+ c.err = sim_pread_drive(self, geom, buf, cyl, head, sector);
+ if (trace_recording())
+    {
+     c.call = TRACE_PREAD;
+     c.cyl = cyl;
+     c.head = head;
+     c.sect = sector;
+     if (sim_record_data(c.err))
+        {
+         c.len = geom->dg_secsize;
+         c.data = buf;
+        }
+     sim_record(&c, t);
+    }
+
+ return c.err;
+}
+
+//==============================================================================
+// Read a whole track from the index hole.
+//
+//   pass: as for dsk_ptread()
+// return: dsk_err_t
+//==============================================================================
+dsk_err_t sim_ptread (DSK_PDRIVER self, const DSK_GEOMETRY *geom, void *buf,
+                      dsk_pcyl_t cyl, dsk_phead_t head)
+{
+ trace_call_t c;
+ trace_call_t *r;
+ uint64_t t;
+
+ if (sim_replaying(self))
+    {
+     r = trace_replay_find(TRACE_PTREAD, cyl, head, 0, 0, 0);
+     if (! r)
+        {
+         sim_replay_wait(r);
+         return DSK_ERR_NOTIMPL;
+        }
+     return sim_replay_read(r, buf, geom->dg_secsize * geom->dg_sectors,
+     NULL);
+    }
+
+ t = sim_now();
+ memset(&c, 0, sizeof(c));
+ c.err = sim_ptread_drive(self, geom, buf, cyl, head);
+ if (trace_recording())
+    {
+     c.call = TRACE_PTREAD;
+     c.cyl = cyl;
+     c.head = head;
+     if (sim_record_data(c.err))
+        {
+         c.len = geom->dg_secsize * geom->dg_sectors;
+         c.data = buf;
+        }
+     sim_record(&c, t);
+    }
+
+ return c.err;
+}
+
+//==============================================================================
+// Get the drive status.
+//
+//   pass: as for dsk_drive_status()
+// return: dsk_err_t
+//==============================================================================
+dsk_err_t sim_drive_status (DSK_PDRIVER self, const DSK_GEOMETRY *geom,
+                            dsk_phead_t head, unsigned char *status)
+{
+ trace_call_t c;
+ trace_call_t *r;
+ uint64_t t;
+
+ if (sim_replaying(self))
+    {
+     r = trace_replay_find(TRACE_STATUS, 0, head, 0, 0, 0);
+     *status = r? r->count : DSK_ST3_READY;
+     return r? r->err : DSK_ERR_OK;
+    }
+
+ t = sim_now();
+ memset(&c, 0, sizeof(c));
+ c.err = sim_drive_status_drive(self, geom, head, status);
+ if (trace_recording())
+    {
+     c.call = TRACE_STATUS;
+     c.head = head;
+     c.count = *status;
+     sim_record(&c, t);
+    }
+
+ return c.err;
+}
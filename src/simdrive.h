@@ -0,0 +1,77 @@
+/* Simulated drive header */
+
+#ifndef HEADER_SIMDRIVE_H
+#define HEADER_SIMDRIVE_H
+
+#include <stdint.h>
+
+#include <libdsk.h>
+
+#define SIM_SECTORS_MAX 256
+
+typedef struct sim_sect_t
+{
+ int cyl;
+ int head;
+ int sect;
+ double prob;          // probability of a read error
+ int weak;             // data read back differs each time
+}sim_sect_t;
+
+typedef struct sim_t
+{
+ DSK_PDRIVER drive;    // image being read, NULL if not simulating
+ char type[100];       // image type, empty to let LibDsk detect it
+ double rpm;
+ double step_ms;       // time to step one cylinder
+ double settle_ms;     // head settle time after stepping
+ double scale;         // part of the drive time really waited, 0 to 1
+ int interleave;       // physical sector order on each track
+ int skew;             // sectors each cylinder is rotated by
+ int side1as0;         // side 1 sector IDs have a side ID of 0
+ double error;         // probability of any sector read failing
+ int firstread;        // the first read after opening fails
+ sim_sect_t *sects;    // sectors that fail or are weak
+ int sects_count;
+ int sects_size;
+ uint64_t seed;
+ uint64_t rng;
+ int cyl;              // head position, -1 if not known
+ int first;            // still to fail the first read
+ uint64_t delay_ns;    // drive time not really waited
+ uint64_t drive_ns;    // total drive time
+ unsigned long seeks;
+ unsigned long reads;
+ unsigned long errors;
+ int replay;           // replaying a trace (--itype=replay)
+ unsigned long unmatched;  // replayed calls that were not in the trace
+ char temp[1000];      // temporary file for the replay drive
+}sim_t;
+
+int sim_open (DSK_PDRIVER *drive, char *file, char *profile, char *comp);
+int sim_replay_open (DSK_PDRIVER *drive);
+void sim_detach (void);
+int sim_active (void);
+void sim_reset_stats (void);
+void sim_report (void);
+uint64_t sim_delay_ns (void);
+uint64_t sim_time_ms (void);
+void sim_sleep_ms (int ms);
+
+dsk_err_t sim_psecid (DSK_PDRIVER self, const DSK_GEOMETRY *geom,
+                      dsk_pcyl_t cyl, dsk_phead_t head, DSK_FORMAT *result);
+dsk_err_t sim_ptrackids (DSK_PDRIVER self, const DSK_GEOMETRY *geom,
+                         dsk_pcyl_t cyl, dsk_phead_t head,
+                         dsk_psect_t *count, DSK_FORMAT **result);
+dsk_err_t sim_pread (DSK_PDRIVER self, const DSK_GEOMETRY *geom, void *buf,
+                     dsk_pcyl_t cyl, dsk_phead_t head, dsk_psect_t sector);
+dsk_err_t sim_xread (DSK_PDRIVER self, const DSK_GEOMETRY *geom, void *buf,
+                     dsk_pcyl_t cyl, dsk_phead_t head,
+                     dsk_pcyl_t cyl_expected, dsk_phead_t head_expected,
+                     dsk_psect_t sector, size_t sector_len, int *deleted);
+dsk_err_t sim_ptread (DSK_PDRIVER self, const DSK_GEOMETRY *geom, void *buf,
+                      dsk_pcyl_t cyl, dsk_phead_t head);
+dsk_err_t sim_drive_status (DSK_PDRIVER self, const DSK_GEOMETRY *geom,
+                            dsk_phead_t head, unsigned char *status);
+
+#endif     /* HEADER_SIMDRIVE_H */
@@ -0,0 +1,221 @@
+//******************************************************************************
+//*                                 uBeeDisk                                   *
+//*                                                                            *
+//*     A tool for converting disks/images from one to another with auto       *
+//*                   detection options for Microbee disks.                    *
+//*                                                                            *
+//*                             skew profile module                            *
+//*                                                                            *
+//*                       Copyright (C) 2008-2026 uBee                         *
+//******************************************************************************
+//
+// Calibrated read skew profiles (--disk=calibrate, --skewprof).
+//
+// The quickest read skew depends on the host controller and drive as well
+// as the format so the values found by --disk=calibrate are kept for each
+// drive and format in SKEWPROF_FILE in the user's ubeedisk directory.  Each
+// line holds the drive, format, skew, skew offset and the time a track took
+// to read separated by tabs, '#' starts a comment:
+//
+//   floppy:/dev/fd0<TAB>ds40<TAB>1<TAB>0<TAB>205.3
+//
+//==============================================================================
+// ChangeLog (most recent entries are at top)
+//==============================================================================
+// v4.1.0 - 17 October 2026, uBee
+// - Initial file created.
+//==============================================================================
+/*
+ *  uBeeDisk - A tool for converting disks/images from one to another with
+ *  auto detection options for Microbee disks.
+ *  Copyright (C) 2008-2026 uBee
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+//==============================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include <libdsk.h>
+
+#ifdef WIN32
+#include <direct.h>
+#endif
+
+#include "skewprof.h"
+#include "ubeedisk.h"
+#include "functions.h"
+
+//==============================================================================
+// Split a profile line into it's fields.
+//
+// The line is changed in place.
+//
+//   pass: char *line
+//         char **field                 5 field pointers
+// return: int                          0 if a profile line, else -1
+//==============================================================================
+static int skewprof_split (char *line, char **field)
+{
+ char *s = line;
+ int i;
+
+ s[strcspn(s, "\r\n")] = 0;
+ if (*s == '#' || ! *s)
+    return -1;
+
+ for (i = 0; i < 5; i++)
+    {
+     field[i] = s;
+     if (i < 4)
+        {
+         if ((s = strchr(s, '\t')) == NULL)
+            return -1;
+         *s++ = 0;
+        }
+    }
+
+ return 0;
+}
+
+//==============================================================================
+// Get the calibrated skew values for a drive and format.
+//
+//   pass: char *file                   profile file
+//         char *drive                  drive identity
+//         char *format                 format name
+//         int *skew                    skew value result
+//         int *ofs                     skew offset result
+// return: int                          0 if found, else -1
+//==============================================================================
+int skewprof_get (char *file, char *drive, char *format, int *skew,
+                  int *ofs)
+{
+ FILE *fp;
+ char line[SKEWPROF_LINE];
+ char *field[5];
+ int res = -1;
+
+ if ((fp = fopen(file, "r")) == NULL)
+    return -1;
+
+ while (res == -1 && fgets(line, sizeof(line), fp))
+    {
+     if (skewprof_split(line, field) == -1)
+        continue;
+     if (strcmp(field[0], drive) || strcasecmp(field[1], format))
+        continue;
+     *skew = atoi(field[2]);
+     *ofs = atoi(field[3]);
+     if (*skew > 0 && *ofs >= 0)
+        res = 0;
+    }
+
+ fclose(fp);
+ return res;
+}
+
+//==============================================================================
+// Save the calibrated skew values for a drive and format.
+//
+// The profile is written to a new file that replaces the old one, any
+// entry for the same drive and format is replaced.  The directory is made
+// if it does not exist.
+//
+//   pass: char *file                   profile file
+//         char *drive                  drive identity
+//         char *format                 format name
+//         int skew                     skew value
+//         int ofs                      skew offset
+//         double ms                    track read time
+// return: int                          0 if no error, else -1
+//==============================================================================
+int skewprof_put (char *file, char *drive, char *format, int skew, int ofs,
+                  double ms)
+{
+ FILE *fp;
+ FILE *fpo;
+ char temp[SKEWPROF_LINE];
+ char line[SKEWPROF_LINE];
+ char copy[SKEWPROF_LINE];
+ char *field[5];
+ char *s;
+ int res;
+
+ // make the directory the profile lives in
+ snprintf(temp, sizeof(temp), "%s", file);
+ if ((s = strrchr(temp, SLASHCHAR)) != NULL)
+    {
+     *s = 0;
+#ifdef WIN32
+     res = _mkdir(temp);
+#else
+     res = mkdir(temp, 0755);
+#endif
+     if (res == -1 && errno != EEXIST)
+        {
+         printf(APPNAME": unable to create directory '%s'\n", temp);
+         return -1;
+        }
+    }
+
+ snprintf(temp, sizeof(temp), "%s.tmp", file);
+ if ((fpo = fopen(temp, "w")) == NULL)
+    {
+     printf(APPNAME": unable to create '%s'\n", temp);
+     return -1;
+    }
+
+ if ((fp = fopen(file, "r")) == NULL)
+    fprintf(fpo, "# "APPNAME" calibrated read skew (--disk=calibrate)\n"
+    "# drive<TAB>format<TAB>skew<TAB>skew offset<TAB>ms per track\n");
+ else
+    {
+     while (fgets(line, sizeof(line), fp))
+        {
+         strcpy(copy, line);
+         if (skewprof_split(copy, field) == 0 &&
+            ! strcmp(field[0], drive) && ! strcasecmp(field[1], format))
+            continue;
+         fputs(line, fpo);
+        }
+     fclose(fp);
+    }
+
+ fprintf(fpo, "%s\t%s\t%d\t%d\t%.1f\n", drive, format, skew, ofs, ms);
+
+ if (fclose(fpo) != 0)
+    {
+     printf(APPNAME": unable to write '%s'\n", temp);
+     remove(temp);
+     return -1;
+    }
+
+#ifdef WIN32
+ remove(file);
+#endif
+ if (rename(temp, file) != 0)
+    {
+     printf(APPNAME": unable to replace '%s'\n", file);
+     remove(temp);
+     return -1;
+    }
+
+ return 0;
+}
@@ -0,0 +1,14 @@
+/* Skew profile header */
+
+#ifndef HEADER_SKEWPROF_H
+#define HEADER_SKEWPROF_H
+
+#define SKEWPROF_FILE "skew.prof"
+#define SKEWPROF_LINE 2200
+
+int skewprof_get (char *file, char *drive, char *format, int *skew,
+                  int *ofs);
+int skewprof_put (char *file, char *drive, char *format, int skew, int ofs,
+                  double ms);
+
+#endif     /* HEADER_SKEWPROF_H */
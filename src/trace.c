@@ -0,0 +1,696 @@
+//******************************************************************************
+//*                                 uBeeDisk                                   *
+//*                                                                            *
+//*     A tool for converting disks/images from one to another with auto       *
+//*                   detection options for Microbee disks.                    *
+//*                                                                            *
+//*                               trace module                                 *
+//*                                                                            *
+//*                       Copyright (C) 2008-2026 uBee                         *
+//******************************************************************************
+//
+// LibDsk call trace recording and replay (--trace, --itype=replay).
+//
+// Recording writes every input drive call (sector ID, track ID, sector and
+// track reads and drive status) and output drive call (formats and sector
+// writes) with it's arguments, result, the MD5 of any data and the time it
+// took to a trace file.  The data read is also kept so the trace can be
+// replayed, each different block of data is only stored once.  A mark is
+// written at the start of each disk copied.
+//
+// Replaying (see simdrive.c) serves the recorded input results back in
+// place of a drive.  The calls for each disk are matched on their
+// arguments, repeated calls with the same arguments (i.e. retries) get the
+// recorded results in turn and the last is repeated once they run out.
+// Sector IDs go round as the track does.
+//
+// The trace file starts with TRACE_MAGIC followed by the records, all
+// values are little endian:
+//
+//   u8   call                 TRACE_* value
+//   u8   flags                TRACE_F_* values
+//   i16  error                LibDsk error code
+//   u16  cyl, head, xcyl, xhead, sector
+//   u32  count                sector IDs, status, deleted flag or copy
+//   u32  length               data length
+//   u32  time                 microseconds
+//   then count * 4 x u16      sector IDs (psecid, ptrackids, pformat)
+//   then 16 bytes             MD5 of the data (TRACE_F_HASH)
+//   then length bytes         data (TRACE_F_DATA)
+//
+//==============================================================================
+// ChangeLog (most recent entries are at top)
+//==============================================================================
+// v4.1.0 - 17 October 2026, uBee
+// - Initial file created.
+//==============================================================================
+/*
+ *  uBeeDisk - A tool for converting disks/images from one to another with
+ *  auto detection options for Microbee disks.
+ *  Copyright (C) 2008-2026 uBee
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+//==============================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <libdsk.h>
+
+#include "trace.h"
+#include "ubeedisk.h"
+#include "functions.h"
+#include "md5.h"
+
+//==============================================================================
+// structures and variables
+//==============================================================================
+static FILE *trace_fp;                   // recording
+static char trace_file[1000];
+
+// MD5s of the data already stored in the trace being recorded
+static uint8_t (*trace_md5s)[16];
+static int trace_md5s_count;
+static int trace_md5s_size;
+
+// trace being replayed
+static char trace_replay_file[1000];
+static trace_call_t *trace_calls;
+static int trace_calls_count;
+static uint8_t *trace_data;              // data of all the calls
+static trace_key_t *trace_keys;
+static int trace_keys_size;
+static int trace_seg;
+
+#ifdef WIN32
+#define trace_lock()
+#define trace_unlock()
+#else
+// the pipeline writer thread records the output calls
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define trace_lock() pthread_mutex_lock(&trace_mutex)
+#define trace_unlock() pthread_mutex_unlock(&trace_mutex)
+#endif
+
+//==============================================================================
+// Put little endian values in a buffer.
+//
+//   pass: uint8_t *p
+//         uint32_t x
+// return: uint8_t *                    next position
+//==============================================================================
+static uint8_t *trace_put16 (uint8_t *p, uint32_t x)
+{
+ *p++ = x;
+ *p++ = x >> 8;
+ return p;
+}
+
+static uint8_t *trace_put32 (uint8_t *p, uint32_t x)
+{
+ p = trace_put16(p, x);
+ return trace_put16(p, x >> 16);
+}
+
+//==============================================================================
+// Get little endian values from a buffer.
+//
+//   pass: uint8_t *p
+// return: uint32_t
+//==============================================================================
+static uint32_t trace_get16 (uint8_t *p)
+{
+ return p[0] | (p[1] << 8);
+}
+
+static uint32_t trace_get32 (uint8_t *p)
+{
+ return trace_get16(p) | (trace_get16(p + 2) << 16);
+}
+
+//==============================================================================
+// Open a trace file for recording.
+//
+//   pass: char *file
+// return: int                          0 if no error, else -1
+//==============================================================================
+int trace_record_open (char *file)
+{
+ if ((trace_fp = fopen(file, "wb")) == NULL)
+    {
+     printf(APPNAME": unable to create trace file '%s'\n", file);
+     return -1;
+    }
+
+ snprintf(trace_file, sizeof(trace_file), "%s", file);
+ fputs(TRACE_MAGIC, trace_fp);
+
+ return 0;
+}
+
+//==============================================================================
+// Free the replay trace.
+//
+//   pass: void
+// return: void
+//==============================================================================
+static void trace_replay_free (void)
+{
+ int i;
+
+ for (i = 0; i < trace_calls_count; i++)
+    free(trace_calls[i].ids);
+ free(trace_calls);
+ free(trace_keys);
+ free(trace_data);
+ trace_calls = NULL;
+ trace_data = NULL;
+ trace_calls_count = 0;
+ trace_keys = NULL;
+ trace_keys_size = 0;
+ *trace_replay_file = 0;
+}
+
+//==============================================================================
+// Close the trace being recorded and free any replay trace.
+//
+//   pass: void
+// return: void
+//==============================================================================
+void trace_close (void)
+{
+ if (trace_fp)
+    {
+     if (fclose(trace_fp) != 0)
+        printf(APPNAME": error writing trace file '%s'\n", trace_file);
+     trace_fp = NULL;
+    }
+ free(trace_md5s);
+ trace_md5s = NULL;
+ trace_md5s_count = 0;
+ trace_md5s_size = 0;
+
+ trace_replay_free();
+}
+
+//==============================================================================
+// Test if a trace is being recorded.
+//
+//   pass: void
+// return: int                          1 if recording
+//==============================================================================
+int trace_recording (void)
+{
+ return trace_fp != NULL;
+}
+
+//==============================================================================
+// Test if a trace is being replayed.
+//
+//   pass: void
+// return: int                          1 if replaying
+//==============================================================================
+int trace_replaying (void)
+{
+ return trace_calls != NULL;
+}
+
+//==============================================================================
+// Test if a block of data is already in the trace being recorded.
+//
+// The MD5 is added if not.
+//
+//   pass: uint8_t *md5
+// return: int                          1 if already stored
+//==============================================================================
+static int trace_md5_stored (uint8_t *md5)
+{
+ uint8_t (*temp)[16];
+ int i;
+
+ for (i = trace_md5s_count - 1; i >= 0; i--)
+    if (! memcmp(trace_md5s[i], md5, 16))
+       return 1;
+
+ if (trace_md5s_count == trace_md5s_size)
+    {
+     temp = realloc(trace_md5s, 16 * (trace_md5s_size + 1000));
+     if (! temp)
+        return 0;
+     trace_md5s = temp;
+     trace_md5s_size += 1000;
+    }
+ memcpy(trace_md5s[trace_md5s_count++], md5, 16);
+
+ return 0;
+}
+
+//==============================================================================
+// Record a call.
+//
+//   pass: trace_call_t *c
+// return: void
+//==============================================================================
+void trace_record (trace_call_t *c)
+{
+ uint8_t hdr[28];
+ uint8_t id[8];
+ uint8_t md5[16];
+ uint8_t *p;
+ int flags = 0;
+ int i;
+
+ if (! trace_fp)
+    return;
+
+ trace_lock();
+
+ if (c->data && c->len)
+    {
+     md5_buffer((char *)c->data, c->len, md5);
+     flags = TRACE_F_HASH;
+     if (! trace_md5_stored(md5))
+        flags |= TRACE_F_DATA;
+    }
+
+ hdr[0] = c->call;
+ hdr[1] = flags;
+ p = trace_put16(hdr + 2, (uint16_t)c->err);
+ p = trace_put16(p, c->cyl);
+ p = trace_put16(p, c->head);
+ p = trace_put16(p, c->xcyl);
+ p = trace_put16(p, c->xhead);
+ p = trace_put16(p, c->sect);
+ p = trace_put32(p, c->count);
+ p = trace_put32(p, c->len);
+ trace_put32(p, c->us);
+ fwrite(hdr, sizeof(hdr), 1, trace_fp);
+
+ for (i = 0; c->ids && i < c->count; i++)
+    {
+     p = trace_put16(id, c->ids[i].fmt_cylinder);
+     p = trace_put16(p, c->ids[i].fmt_head);
+     p = trace_put16(p, c->ids[i].fmt_sector);
+     trace_put16(p, c->ids[i].fmt_secsize);
+     fwrite(id, sizeof(id), 1, trace_fp);
+    }
+
+ if (flags & TRACE_F_HASH)
+    fwrite(md5, sizeof(md5), 1, trace_fp);
+ if (flags & TRACE_F_DATA)
+    fwrite(c->data, c->len, 1, trace_fp);
+
+ trace_unlock();
+}
+
+//==============================================================================
+// Record the start of a disk copy.
+//
+//   pass: int copy                     copy number
+// return: void
+//==============================================================================
+void trace_mark (int copy)
+{
+ trace_call_t c;
+
+ memset(&c, 0, sizeof(c));
+ c.call = TRACE_MARK;
+ c.count = copy;
+ trace_record(&c);
+}
+
+//==============================================================================
+// Make the key for a call's arguments.
+//
+//   pass: int call, int cyl, int head, int xcyl, int xhead, int sect
+// return: uint64_t
+//==============================================================================
+static uint64_t trace_key (int call, int cyl, int head, int xcyl, int xhead,
+                           int sect)
+{
+ return ((uint64_t)call << 56) | ((uint64_t)(cyl & 0xfff) << 44) |
+        ((uint64_t)(head & 0xf) << 40) | ((uint64_t)(xcyl & 0xfff) << 28) |
+        ((uint64_t)(xhead & 0xfff) << 16) | (sect & 0xffff);
+}
+
+//==============================================================================
+// Find the slot for a key in the replay key table.
+//
+//   pass: uint64_t key
+//         int seg                      disk the key belongs to
+// return: trace_key_t *                slot, first is -1 if not used
+//==============================================================================
+static trace_key_t *trace_key_slot (uint64_t key, int seg)
+{
+ uint64_t h = (key ^ (key >> 29) ^ ((uint64_t)seg * 0x9e3779b97f4a7c15ULL)) *
+              0xbf58476d1ce4e5b9ULL;
+ int i = (int)(h >> 32) & (trace_keys_size - 1);
+
+ while (trace_keys[i].first != -1 &&
+        (trace_keys[i].key != key || trace_keys[i].seg != seg))
+    i = (i + 1) & (trace_keys_size - 1);
+
+ return &trace_keys[i];
+}
+
+//==============================================================================
+// Load a trace for replaying.
+//
+// Loading the trace already loaded does nothing so the replay carries on
+// when the input drive is opened again.
+//
+//   pass: char *file
+// return: int                          0 if no error, else -1
+//==============================================================================
+int trace_replay_open (char *file)
+{
+ trace_call_t *temp;
+ trace_call_t *c;
+ trace_key_t *k;
+ int *blocks = NULL;
+ int *tempb;
+ uint8_t *p;
+ uint8_t hdr[28];
+ uint8_t id[8];
+ char magic[sizeof(TRACE_MAGIC)];
+ FILE *fp;
+ long size;
+ int calls_size = 0;
+ int blocks_count = 0;
+ int flags;
+ int seg = 0;
+ int i;
+
+ if (trace_calls && ! strcmp(trace_replay_file, file))
+    return 0;
+ trace_replay_free();
+
+ if ((fp = fopen(file, "rb")) == NULL)
+    {
+     printf(APPNAME": unable to open trace file '%s'\n", file);
+     return -1;
+    }
+
+ if (fread(magic, strlen(TRACE_MAGIC), 1, fp) != 1 ||
+     memcmp(magic, TRACE_MAGIC, strlen(TRACE_MAGIC)))
+    {
+     printf(APPNAME": '%s' is not a trace file\n", file);
+     fclose(fp);
+     return -1;
+    }
+
+ // the data blocks are all held in one buffer
+ fseek(fp, 0, SEEK_END);
+ size = ftell(fp);
+ fseek(fp, strlen(TRACE_MAGIC), SEEK_SET);
+ if ((trace_data = malloc(size + 1)) == NULL)
+    goto error;
+ p = trace_data;
+
+ while (fread(hdr, sizeof(hdr), 1, fp) == 1)
+    {
+     if (trace_calls_count == calls_size)
+        {
+         temp = realloc(trace_calls, sizeof(trace_call_t) *
+         (calls_size + 1000));
+         if (! temp)
+            goto error;
+         trace_calls = temp;
+         calls_size += 1000;
+        }
+     c = &trace_calls[trace_calls_count];
+     memset(c, 0, sizeof(trace_call_t));
+
+     c->call = hdr[0];
+     flags = hdr[1];
+     c->err = (int16_t)trace_get16(hdr + 2);
+     c->cyl = trace_get16(hdr + 4);
+     c->head = trace_get16(hdr + 6);
+     c->xcyl = trace_get16(hdr + 8);
+     c->xhead = trace_get16(hdr + 10);
+     c->sect = trace_get16(hdr + 12);
+     c->count = trace_get32(hdr + 14);
+     c->len = trace_get32(hdr + 18);
+     c->us = trace_get32(hdr + 22);
+     c->next = -1;
+
+     if (c->call >= TRACE_COUNT || c->len > (size_t)size)
+        goto error;
+
+     if (c->call == TRACE_MARK)
+        seg++;
+     c->seg = seg;
+
+     if (c->call == TRACE_PSECID || c->call == TRACE_PTRACKIDS ||
+         c->call == TRACE_PFORMAT)
+        {
+         if (c->count < 0 || c->count > 1000 ||
+             (c->ids = malloc(sizeof(DSK_FORMAT) * (c->count + 1))) == NULL)
+            goto error;
+         for (i = 0; i < c->count; i++)
+            {
+             if (fread(id, sizeof(id), 1, fp) != 1)
+                goto error;
+             c->ids[i].fmt_cylinder = trace_get16(id);
+             c->ids[i].fmt_head = trace_get16(id + 2);
+             c->ids[i].fmt_sector = trace_get16(id + 4);
+             c->ids[i].fmt_secsize = trace_get16(id + 6);
+            }
+        }
+     trace_calls_count++;
+
+     if (flags & TRACE_F_HASH)
+        {
+         if (fread(c->md5, sizeof(c->md5), 1, fp) != 1)
+            goto error;
+         if (flags & TRACE_F_DATA)
+            {
+             if (fread(p, c->len, 1, fp) != 1)
+                goto error;
+             c->data = p;
+             p += c->len;
+             tempb = realloc(blocks, sizeof(int) * (blocks_count + 1));
+             if (! tempb)
+                goto error;
+             blocks = tempb;
+             blocks[blocks_count++] = trace_calls_count - 1;
+            }
+         else
+            // data stored earlier in the trace
+            for (i = blocks_count - 1; i >= 0 && ! c->data; i--)
+               if (trace_calls[blocks[i]].len == c->len &&
+                   ! memcmp(trace_calls[blocks[i]].md5, c->md5, 16))
+                  c->data = trace_calls[blocks[i]].data;
+        }
+    }
+ fclose(fp);
+ fp = NULL;
+ free(blocks);
+
+ // chain the calls with the same arguments for each disk
+ for (trace_keys_size = 1024; trace_keys_size < trace_calls_count * 2;
+      trace_keys_size *= 2)
+    ;
+ if ((trace_keys = malloc(sizeof(trace_key_t) * trace_keys_size)) == NULL)
+    goto error;
+ for (i = 0; i < trace_keys_size; i++)
+    trace_keys[i].first = -1;
+
+ for (i = trace_calls_count - 1; i >= 0; i--)
+    {
+     c = &trace_calls[i];
+     if (c->call == TRACE_MARK)
+        continue;
+     k = trace_key_slot(trace_key(c->call, c->cyl, c->head, c->xcyl,
+     c->xhead, c->sect), c->seg);
+     if (k->first == -1)
+        {
+         k->key = trace_key(c->call, c->cyl, c->head, c->xcyl, c->xhead,
+         c->sect);
+         k->seg = c->seg;
+        }
+     else
+        c->next = k->first;
+     k->first = i;
+     k->cur = i;
+    }
+
+ snprintf(trace_replay_file, sizeof(trace_replay_file), "%s", file);
+ trace_seg = 0;
+
+ return 0;
+
+error:
+ printf(APPNAME": trace file '%s' is damaged or too large\n", file);
+ if (fp)
+    fclose(fp);
+ free(blocks);
+ trace_replay_free();
+ return -1;
+}
+
+//==============================================================================
+// Move the replay on to the next disk.
+//
+//   pass: void
+// return: int                          0 if no error, -1 if no more disks
+//==============================================================================
+int trace_replay_next (void)
+{
+ int i;
+
+ if (! trace_calls)
+    return -1;
+
+ trace_seg++;
+ for (i = 0; i < trace_calls_count; i++)
+    if (trace_calls[i].seg == trace_seg)
+       return 0;
+
+ return -1;
+}
+
+//==============================================================================
+// Find the recorded result of a call for the disk being replayed.
+//
+// Each call with the same arguments gets the next recorded result, the last
+// is then repeated except sector IDs which start again from the first.
+//
+//   pass: int call, int cyl, int head, int xcyl, int xhead, int sect
+// return: trace_call_t *               call, NULL if not recorded
+//==============================================================================
+trace_call_t *trace_replay_find (int call, int cyl, int head, int xcyl,
+                                 int xhead, int sect)
+{
+ trace_key_t *k;
+ trace_call_t *c;
+
+ if (! trace_calls)
+    return NULL;
+
+ k = trace_key_slot(trace_key(call, cyl, head, xcyl, xhead, sect),
+ trace_seg);
+ if (k->first == -1)
+    return NULL;
+
+ c = &trace_calls[k->cur];
+ if (c->next != -1)
+    k->cur = c->next;
+ else if (call == TRACE_PSECID)
+    k->cur = k->first;
+
+ return c;
+}
+
+//==============================================================================
+// Format a track on the output drive and record it.
+//
+//   pass: as for dsk_pformat()
+// return: dsk_err_t
+//==============================================================================
+dsk_err_t trace_pformat (DSK_PDRIVER self, DSK_GEOMETRY *geom,
+                         dsk_pcyl_t cyl, dsk_phead_t head,
+                         const DSK_FORMAT *format, unsigned char filler)
+{
+ trace_call_t c;
+ uint64_t t;
+
+ if (! trace_fp)
+    return dsk_pformat(self, geom, cyl, head, format, filler);
+
+ memset(&c, 0, sizeof(c));
+ t = time_get_ns();
+ c.err = dsk_pformat(self, geom, cyl, head, format, filler);
+ c.us = (time_get_ns() - t) / 1000;
+ c.call = TRACE_PFORMAT;
+ c.cyl = cyl;
+ c.head = head;
+ c.sect = filler;
+ c.count = geom->dg_sectors;
+ c.ids = (DSK_FORMAT *)format;
+ trace_record(&c);
+
+ return c.err;
+}
+
+//==============================================================================
+// Write a sector to the output drive and record it.
+//
+//   pass: as for dsk_xwrite()
+// return: dsk_err_t
+//==============================================================================
+dsk_err_t trace_xwrite (DSK_PDRIVER self, const DSK_GEOMETRY *geom,
+                        const void *buf, dsk_pcyl_t cyl, dsk_phead_t head,
+                        dsk_pcyl_t cyl_expected, dsk_phead_t head_expected,
+                        dsk_psect_t sector, size_t sector_len, int deleted)
+{
+ trace_call_t c;
+ uint64_t t;
+
+ if (! trace_fp)
+    return dsk_xwrite(self, geom, buf, cyl, head, cyl_expected,
+    head_expected, sector, sector_len, deleted);
+
+ memset(&c, 0, sizeof(c));
+ t = time_get_ns();
+ c.err = dsk_xwrite(self, geom, buf, cyl, head, cyl_expected,
+ head_expected, sector, sector_len, deleted);
+ c.us = (time_get_ns() - t) / 1000;
+ c.call = TRACE_XWRITE;
+ c.cyl = cyl;
+ c.head = head;
+ c.xcyl = cyl_expected;
+ c.xhead = head_expected;
+ c.sect = sector;
+ c.count = deleted;
+ c.len = sector_len;
+ c.data = (uint8_t *)buf;
+ trace_record(&c);
+
+ return c.err;
+}
+
+//==============================================================================
+// Write a sector to the output drive and record it.
+//
+//   pass: as for dsk_pwrite()
+// return: dsk_err_t
+//==============================================================================
+dsk_err_t trace_pwrite (DSK_PDRIVER self, const DSK_GEOMETRY *geom,
+                        const void *buf, dsk_pcyl_t cyl, dsk_phead_t head,
+                        dsk_psect_t sector)
+{
+ trace_call_t c;
+ uint64_t t;
+
+ if (! trace_fp)
+    return dsk_pwrite(self, geom, buf, cyl, head, sector);
+
+ memset(&c, 0, sizeof(c));
+ t = time_get_ns();
+ c.err = dsk_pwrite(self, geom, buf, cyl, head, sector);
+ c.us = (time_get_ns() - t) / 1000;
+ c.call = TRACE_PWRITE;
+ c.cyl = cyl;
+ c.head = head;
+ c.sect = sector;
+ c.len = geom->dg_secsize;
+ c.data = (uint8_t *)buf;
+ trace_record(&c);
+
+ return c.err;
+}
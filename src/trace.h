@@ -0,0 +1,85 @@
+/* Trace header */
+
+#ifndef HEADER_TRACE_H
+#define HEADER_TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <libdsk.h>
+
+#ifndef WIN32
+#include <pthread.h>
+#endif
+
+#define TRACE_MAGIC "UBEEDISK TRACE 1\n"
+
+enum
+{
+ TRACE_MARK,
+ TRACE_PSECID,
+ TRACE_PTRACKIDS,
+ TRACE_XREAD,
+ TRACE_PREAD,
+ TRACE_PTREAD,
+ TRACE_STATUS,
+ TRACE_XWRITE,
+ TRACE_PWRITE,
+ TRACE_PFORMAT,
+ TRACE_COUNT
+};
+
+// record flags
+#define TRACE_F_HASH 0x01  // MD5 of the data follows
+#define TRACE_F_DATA 0x02  // data follows (the first time it's seen)
+
+typedef struct trace_call_t
+{
+ int call;             // TRACE_* value
+ dsk_err_t err;
+ int cyl;
+ int head;
+ int xcyl;             // expected ID values (xread/xwrite)
+ int xhead;
+ int sect;
+ int count;            // sector IDs, status, deleted flag or copy number
+ DSK_FORMAT *ids;      // psecid/ptrackids/pformat sector IDs
+ size_t len;
+ uint8_t *data;        // data read or written, NULL if none
+ uint8_t md5[16];      // MD5 of the data
+ uint32_t us;          // time the call took
+ int seg;              // disk (copy) the call belongs to when replaying
+ int next;             // next call with the same arguments, -1 if none
+}trace_call_t;
+
+typedef struct trace_key_t
+{
+ uint64_t key;
+ int seg;
+ int first;            // first call, -1 if the slot is not used
+ int cur;              // next call to be replayed
+}trace_key_t;
+
+int trace_record_open (char *file);
+int trace_replay_open (char *file);
+void trace_close (void);
+int trace_recording (void);
+int trace_replaying (void);
+void trace_record (trace_call_t *c);
+void trace_mark (int copy);
+int trace_replay_next (void);
+trace_call_t *trace_replay_find (int call, int cyl, int head, int xcyl,
+                                 int xhead, int sect);
+
+dsk_err_t trace_pformat (DSK_PDRIVER self, DSK_GEOMETRY *geom,
+                         dsk_pcyl_t cyl, dsk_phead_t head,
+                         const DSK_FORMAT *format, unsigned char filler);
+dsk_err_t trace_xwrite (DSK_PDRIVER self, const DSK_GEOMETRY *geom,
+                        const void *buf, dsk_pcyl_t cyl, dsk_phead_t head,
+                        dsk_pcyl_t cyl_expected, dsk_phead_t head_expected,
+                        dsk_psect_t sector, size_t sector_len, int deleted);
+dsk_err_t trace_pwrite (DSK_PDRIVER self, const DSK_GEOMETRY *geom,
+                        const void *buf, dsk_pcyl_t cyl, dsk_phead_t head,
+                        dsk_psect_t sector);
+
+#endif     /* HEADER_TRACE_H */
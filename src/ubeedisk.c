@@ -19,6 +19,117 @@
 //==============================================================================
 // ChangeLog (most recent entries are at top)
 //==============================================================================
+// v4.1.0 - 17 October 2026, uBee
+// - Added the --disk=calibrate process.  disk_calibrate() times buffered
+//   track reads with each skew value and first sector and saves the
+//   quickest for the input drive and format (skewprof.c).  override_values()
+//   uses the saved values unless --skew, --skew-ofs or --skewprof=off.
+// - Added the --disk=plan process.  A rotational model of the track made
+//   from the format_track_size() byte counts (rot_model_set()) predicts the
+//   time to read a track in skew table order (rot_track_ns()) and
+//   disk_plan() reports it with the quickest skew values for each format.
+// - Added a LibDsk call trace (trace.c).  --trace records the input drive
+//   calls made through the sim_*() calls and the output drive calls made
+//   through trace_pformat(), trace_xwrite() and trace_pwrite() and the
+//   'replay' input type replays the input calls from a trace.
+//   copy_one_disk() marks the start of each disk in the trace.
+// - Added the --disk=bench process.  disk_bench() times create_skew_table(),
+//   set_format_struct(), format_track_size() and md5_process_block() for
+//   each built in format or writes a synthetic raw image (bench_image()).
+// - Added the 'sim' input type (simdrive.c).  open_input_drive() opens the
+//   image with sim_open() and the input drive reads use the sim_*() calls
+//   which pass through to LibDsk unless the drive is simulated.  The read
+//   settle delay and disk_speed() use the simulated drive time.
+// - Added a --profile timing profile.  The sector ID, track and sector reads,
+//   error re-seeks, settle delay, formats, writes and image digests are timed
+//   with profile_begin()/profile_end(), the pipeline writer thread adds to
+//   the reader's profile.  create_info_file() adds a TIMING section.
+// - Added --events JSON lines events.  copy_one_disk() is now a wrapper
+//   around copy_disk_data() that emits the copy_start and summary events,
+//   event_phase() times each part of the copy and track, retry, error,
+//   detection and abort events are emitted where they happen.
+// - Added a rate limited copy progress line.  progress_sector() is called
+//   for each sector in place of the printf() and fflush() and the line is
+//   only shown by progress_show() every PROGRESS_MS.  The drive pair status
+//   values are now set by progress_track().  Removed the fflush() done for
+//   each sector written by write_buffered_track().
+// - pause_menu() now tests key_pending() and only calls get_key() once a
+//   key has been pressed, keeping the get_key() system calls out of the
+//   sector read loop.
+// - Added --autodisk.  media_wait() polls the input drive status between
+//   disks in copy_disks() and the input drive is kept open, the output is
+//   closed with the new close_output_files().  copy_one_disk() only homes
+//   the head for a disk found this way instead of reopening the drive.
+// - Added --pair to copy from several drives at once.  copy_pairs() starts a
+//   pair_worker() thread for each drive pair and shows a status line for
+//   each, pause_menu() aborts from the status display for these threads.
+//   count_file_name() was split out of copy_disks().
+// - The sector status map is now held in a growable run-length encoded
+//   info_map_t (infomap module) in place of the fixed info.buf[] which
+//   stopped recording when full.  The track buffer, skew table and format
+//   arrays are now allocated for the geometry by track_buf_alloc() and
+//   format_track().  Retry counts in the map are limited to 250 and the
+//   checkpoint journal is now version 2.
+// - Added --sidecar JSON/CBOR info files, create_info_sidecar() writes them
+//   using the new sidecar module.  drive_args[] moved out of
+//   create_info_file() so both can use it.
+// - Added --vote sector voting, vote_sector() reads a sector again and
+//   takes a byte-wise majority vote, read_sector_data() was split out of
+//   read_sector_x() for this.
+// - Added --checkpoint journal and --resume.  checkpoint_record() builds a
+//   record for each completed track which is written once the track has
+//   been written to the output (by the writer thread when pipelining) and
+//   synced to the disk with output_sync().  A raw output is written
+//   directly when checkpointing so it's buffers can be flushed.
+// - Added --hash digest selection for the 'info' file, the streamed output
+//   MD5 functions are now out_hash_start(), out_hash_update() and
+//   out_hash_result() and compute all the selected digests.
+// - create_info_file() now uses an MD5 computed while the output is written
+//   (out_md5_start(), out_md5_update(), out_md5_result()) for raw images
+//   written in order, otherwise the closed image is hashed.
+// - Added output buffering (--obuffer).  Raw output images are written with
+//   raw_output_write() which collects runs of tracks and writes them with
+//   raw_output_flush(), other image types are created in a temporary file by
+//   create_output_drive() and copied to the output by close_files().
+// - Renamed fast_copy_raw_open() and fast_copy_raw_write() to
+//   raw_output_open() and raw_output_write(), the file copy in
+//   fast_copy_file() is now done by copy_file().
+// - Added deferred retrying (--deferred).  read_sector_retry() queues failed
+//   sectors during the first pass in unattended mode and
+//   retry_deferred_sectors() retries them once the whole disk has been read.
+// - read_buffered_track() now keeps the sectors already read when a sector
+//   fails and continues reading the rest of the track.  read_sector_x() only
+//   reads the failed sectors again.
+// - Added a per track plan (track_plan_init(), track_plan_get() etc) used by
+//   set_format_struct() so the format structure and GAP values are only
+//   worked out once for each track of a copy.
+// - create_skew_table() only rebuilds the table if the values change.
+// - write_buffered_track() now works out the --forceside ID values once per
+//   track instead of for each sector.
+// - Added a fast image to image copy path (--fastcopy) to copy_one_disk().
+//   fast_copy_method() decides if it can be used, fast_copy_file() copies
+//   raw to raw as one file and fast_copy_track() copies other image types
+//   a whole track at a time (raw output tracks are written directly).
+// - Session values (disk, dg, xdg, dg_opts, buffers, info, drive handles,
+//   counters and files) are now SESSION_LOCAL (per thread) and can be
+//   handed to another thread with the new session_save() and session_load()
+//   functions.
+// - The pipeline state is now a pipe_t structure allocated by
+//   pipeline_start() and the writer thread runs with a copy of the reader's
+//   session.
+// - Added copy_batch() to convert a directory or wildcard pattern of image
+//   files (--batch) using a pool of worker processes (--jobs) with a
+//   summary report (--batch-report).
+// - Added '@b' input base name to output_filename_substitution().
+// - Added pipelined copy (--pipeline=n).  pipeline_start(), pipeline_put(),
+//   pipeline_writer() and pipeline_finish() run the output formatting and
+//   writing in a separate thread fed by a ring of track buffers.
+// - Changes to fdc_buffer_format(), set_format_struct(), format_track() and
+//   write_buffered_track() to be passed the geometry (and track buffer and
+//   skew table) to be used instead of using the globals.
+// - Moved the copy_one_disk() --forceside format side ID code to a new
+//   format_side_id() function.
+//
 // v4.0.1 - 28 December 2023, Tony Sanchez
 // - Change to options_getoptstr() in options.c to work around clang strict array bounds check on MacOS
 //==============================================================================
@@ -307,18 +418,32 @@
 //==============================================================================
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <string.h>
 #include <errno.h>
 #include <ctype.h>
 #include <stdint.h>
 #include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
 
 #include <libdsk.h>
 
 #ifdef WIN32
 #include <windows.h>
+#include <io.h>
 #else
 #include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <glob.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#endif
+
+#if defined(__linux__) && defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+#define HAVE_COPY_FILE_RANGE
 #endif
 
 #include "ubeedisk.h"
@@ -327,12 +452,23 @@
 #include "getopt.h"
 #include "functions.h"
 #include "strverscmp.h"
+#include "hash.h"
+#include "sidecar.h"
+#include "events.h"
+#include "simdrive.h"
+#include "trace.h"
+#include "skewprof.h"
+#include "md5.h"
 
 
 //==============================================================================
 // structures and variables
+//
+// All values belonging to a copy, scan or detect session are SESSION_LOCAL
+// so that each thread has it's own session.  session_save() and
+// session_load() are used to hand a configured session to another thread.
 //==============================================================================
-disk_t disk =
+SESSION_LOCAL disk_t disk =
 {
  .iautorate = 1,
  .oautorate = 1, 
@@ -341,10 +477,14 @@ disk_t disk =
  .count = -1,
  .enter_desc = 1,
  .erase = -1,
+ .fastcopy = 1,
+ .turnaround = PLAN_TURNAROUND_US,
+ .skewprof = 1,
  .fd_workaround1 = 1,
  .fd_workaround2 = 1, 
  .finish = -1,
  .gap_set = {-1, -1, -1, -1, -1, -1, -1, -1},
+ .hash = HASH_BIT(HASH_MD5),
  .head_s = 0,
  .head_f = 1,
  .idstep = -1,
@@ -369,7 +509,7 @@ disk_t disk =
  .verbose = 1
 };
 
-dg_opts_t dg_opts =
+SESSION_LOCAL dg_opts_t dg_opts =
 {
  .sidedness = -1,
  .cylinders = -1,
@@ -395,7 +535,7 @@ dg_opts_t dg_opts =
  .special = -1
 };
 
-xdg_t xdg =
+SESSION_LOCAL xdg_t xdg =
 {
  .dg_secbase2c = -1
 };
@@ -592,6 +732,15 @@ static char *is_floppy_otypes[] =
  ""
 };
 
+// input types that --autodisk can poll for a disk change
+static char *media_wait_types[] =
+{
+ "floppy",
+ "ntwdm",
+ "remote",
+ ""
+};
+
 static char *is_not_var_track_size_type[] =
 {
  "raw",
@@ -599,6 +748,15 @@ static char *is_not_var_track_size_type[] =
  ""
 };
 
+static char *fast_copy_types[] =
+{
+ "raw",
+ "dsk",
+ "edsk",
+ "imd",
+ ""
+};
+
 static char *no_error_file[] =
 {
  "floppy",
@@ -617,6 +775,27 @@ static char *no_info_file[] =
  ""
 };
 
+// 'info' file drive type names
+static sup_args_t drive_args[] =
+{
+ {"disk image or unknown",   0}, 
+ {"400kb 5.25\"",          'd'},
+ {"1.2 Mb 5.25\"",         'h'},
+ {"800kb 3.5 or 5.25\"",   'D'},
+ {"1.44 Mb 3.5\"",         'H'},  
+ {"2.88 Mb",               'E'},
+ {"",                       -1}
+};
+
+// 'info' file digest labels in HASH_* order
+static char *hash_labels[] =
+{
+ "MD5",
+ "SHA256",
+ "BLAKE3",
+ "XXH3"
+};
+
 static char *no_desc_otypes[] =
 {
  "floppy",
@@ -626,57 +805,117 @@ static char *no_desc_otypes[] =
  ""
 };
 
-sup_t input_sup;
-sup_t output_sup;
+SESSION_LOCAL sup_t input_sup;
+SESSION_LOCAL sup_t output_sup;
 
-FILE *infof;
+SESSION_LOCAL FILE *infof;
 
-static FILE *errorf;
+static SESSION_LOCAL FILE *errorf;
 
-static int sect_retry_count;
-static int sect_retries_tot;
-static int sect_errors_tot;
+static SESSION_LOCAL int sect_retry_count;
+static SESSION_LOCAL int sect_retries_tot;
+static SESSION_LOCAL int sect_errors_tot;
 
-static int auto_retry_abort;
-static int auto_retry_sector;
-static int auto_seeked_count;
-static int auto_cyl_last;
-static int auto_head_last;
-static int auto_move_head;
+static SESSION_LOCAL int auto_retry_abort;
+static SESSION_LOCAL int auto_retry_sector;
+static SESSION_LOCAL int auto_seeked_count;
+static SESSION_LOCAL int auto_cyl_last;
+static SESSION_LOCAL int auto_head_last;
+static SESSION_LOCAL int auto_move_head;
 
 char userhome[SSIZE1];
 char userhome_confpath[SSIZE1];
 static char userhome_path[SSIZE1];
-static char error_file[1000];
+static SESSION_LOCAL char error_file[1000];
+
+SESSION_LOCAL DSK_GEOMETRY dg;
+SESSION_LOCAL DSK_GEOMETRY cdg;
+SESSION_LOCAL DSK_PDRIVER idrive = NULL;
+
+static SESSION_LOCAL DSK_PDRIVER odrive = NULL;
+
+static SESSION_LOCAL info_t info;
+
+static SESSION_LOCAL int overwrite_flag;
+
+static SESSION_LOCAL int cyl_start;
+static SESSION_LOCAL int cyl_finish;
+static SESSION_LOCAL int trk_start;
+static SESSION_LOCAL int trk_finish;
+
+static SESSION_LOCAL int skip_all_errors;
+
+static SESSION_LOCAL int *skew_table;
+static SESSION_LOCAL int skew_table_val = -1;
+static SESSION_LOCAL int skew_table_ofs = -1;
+static SESSION_LOCAL int skew_table_sectors = -1;
+static SESSION_LOCAL uint8_t *buf;
+static SESSION_LOCAL size_t buf_size;
+static SESSION_LOCAL int buffered_cylinder;
+static SESSION_LOCAL int buffered_head;
+static SESSION_LOCAL uint8_t *buffered_ok;
+static SESSION_LOCAL int track_sectors_size;
+
+static SESSION_LOCAL retry_entry_t *retry_queue;
+static SESSION_LOCAL int retry_queue_count;
+static SESSION_LOCAL int retry_queue_size;
+static SESSION_LOCAL int retry_queued;
+static SESSION_LOCAL int retry_pass;
+
+static SESSION_LOCAL vote_entry_t *vote_list;
+static SESSION_LOCAL int vote_count;
+static SESSION_LOCAL int vote_size;
 
-DSK_GEOMETRY dg;
-DSK_GEOMETRY cdg;
-DSK_PDRIVER idrive = NULL;
+static SESSION_LOCAL track_plan_t *track_plan;
+static SESSION_LOCAL int track_plan_size;
+static SESSION_LOCAL int track_plan_floppy;
 
-static DSK_PDRIVER odrive = NULL;
+#ifndef WIN32
+static SESSION_LOCAL pipe_t *pipe_ctx;
+#endif
+static SESSION_LOCAL int pipe_active;
 
-static info_t info;
+static SESSION_LOCAL int media_ready;
 
-static int overwrite_flag;
+static SESSION_LOCAL progress_t progress;
 
-static int cyl_start;
-static int cyl_finish;
-static int trk_start;
-static int trk_finish;
+static SESSION_LOCAL uint64_t phase_ms;
+static SESSION_LOCAL int copy_aborted;
 
-static int skip_all_errors;
+static SESSION_LOCAL profile_t profile;
+static SESSION_LOCAL profile_t *prof;    // &profile if profiling, else NULL
 
-static int skew_table[1024];
-static uint8_t buf[100000];
-static int buffered_cylinder;
-static int buffered_head;
+static SESSION_LOCAL pair_t *pair_cur;
+#ifndef WIN32
+static pthread_mutex_t pair_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pair_cond = PTHREAD_COND_INITIALIZER;
+static pair_t *pair_list;
+static int pair_count;
+static int pair_lines;
+#endif
 
-static char ofile_name[1000];
+static SESSION_LOCAL FILE *raw_outf;
+static SESSION_LOCAL uint8_t *raw_obuf;
+static SESSION_LOCAL size_t raw_obuf_size;
+static SESSION_LOCAL size_t raw_obuf_len;
+static SESSION_LOCAL long raw_obuf_pos;
+static SESSION_LOCAL char output_temp[1000];
+static SESSION_LOCAL FILE *ckptf;
+static SESSION_LOCAL char ckpt_file[1000];
+static SESSION_LOCAL char *ckpt_rec;
+static SESSION_LOCAL int ckpt_resume;
+static SESSION_LOCAL int ckpt_queue_mark;
+static SESSION_LOCAL hash_ctx_t out_hash_ctx;
+static SESSION_LOCAL long out_hash_pos;
+static SESSION_LOCAL int out_hash_state;
+static SESSION_LOCAL hash_res_t out_hash_res;
+
+static SESSION_LOCAL char ofile_name[1000];
 
 // chars = DESC_CHARS + 1 CR + 1 null
-static char description[DESC_LINES+1][DESC_CHARS+2]; 
+static SESSION_LOCAL char description[DESC_LINES+1][DESC_CHARS+2]; 
 
-static int diskdesc_line;
+static SESSION_LOCAL int diskdesc_line;
 
 #ifdef WIN32
 extern char *c_argv[];
@@ -694,6 +933,23 @@ extern char config_vers[];
 static dsk_err_t home_and_reset_input_drive_and_settings (DSK_FORMAT *sector_id);
 static int disk_clean (int method, int cyl_last);
 static int open_input_drive (void);
+static void track_plan_free (void);
+static int format_side_id (dsk_phead_t head, int xhead);
+static off_t copy_file (char *from, char *to, size_t block, int hash);
+static int raw_output_possible (void);
+static dsk_err_t raw_output_flush (void);
+static dsk_err_t raw_output_write (dsk_pcyl_t cyl, dsk_phead_t head);
+static void out_hash_update (long pos, void *data, size_t len);
+static int out_hash_result (hash_res_t *res);
+static int checkpoint_possible (void);
+static void checkpoint_check (void);
+static void checkpoint_write (FILE *f, char *s);
+static int output_sync (void);
+static void checkpoint_retried (retry_entry_t *r);
+static void checkpoint_close (int aborted);
+static int close_output_files (void);
+static int track_buf_alloc (void);
+static void skew_profile_apply (void);
 
 //==============================================================================
 // Report DSK_GEOMETRY values.
@@ -770,6 +1026,198 @@ static void report_end (void)
  fflush(stdout);
 }
 
+//==============================================================================
+// Start the copy progress display.
+//
+// The progress line is only shown every PROGRESS_MS no matter how many
+// sectors are read so that slow terminals and serial consoles don't slow
+// the copy down.
+//
+//   pass: int trk_first                first track copied in this run
+// return: void
+//==============================================================================
+static void progress_start (int trk_first)
+{
+ memset(&progress, 0, sizeof(progress));
+ progress.start_ms = time_get_ms();
+ progress.trk_start = trk_start;
+ progress.trk_first = trk_first;
+ progress.trk_finish = trk_finish;
+ progress.trk = trk_first;
+}
+
+//==============================================================================
+// Show the copy progress line.
+//
+// Shows the position, sectors and KB read per second, the retries so far
+// and an estimate of the time to complete based on the tracks remaining.
+//
+//   pass: void
+// return: void
+//==============================================================================
+static void progress_show (void)
+{
+ char s[200];
+ char eta[20];
+ uint64_t now = time_get_ms();
+ double secs;
+ double done;
+ double left;
+ int t;
+
+ progress.last_ms = now;
+
+ if (! disk.verbose)
+    return;
+
+ secs = (now - progress.start_ms) / 1000.0;
+
+ // tracks done in this run including the part of the current track
+ done = progress.trk - progress.trk_first;
+ if (dg.dg_sectors)
+    done += (double)progress.lsect / dg.dg_sectors;
+ left = progress.trk_finish - progress.trk_first + 1 - done;
+
+ if (done > 0 && secs > 0)
+    {
+     t = (int)(secs * left / done + 0.5);
+     snprintf(eta, sizeof(eta), "%d:%02d", t / 60, t % 60);
+    }
+ else
+    strcpy(eta, "--:--");
+
+ snprintf(s, sizeof(s), "Cyl %02d/%02d Head %d/%d Sect %03d/%03d"
+          " %6.1f sect/s %7.1f KB/s Retries %d ETA %s",
+          progress.cyl, dg.dg_cylinders - 1, progress.head, dg.dg_heads - 1,
+          progress.lsect, dg.dg_sectors - 1,
+          (secs > 0)? progress.sectors / secs : 0.0,
+          (secs > 0)? progress.bytes / 1024.0 / secs : 0.0,
+          sect_retries_tot, eta);
+
+ printf("\r%-79.79s", s);
+ fflush(stdout);
+}
+
+//==============================================================================
+// Note the sector about to be read.
+//
+// The progress line is shown if PROGRESS_MS has passed since it was last
+// shown.
+//
+//   pass: dsk_pcyl_t cyl               cylinder number
+//         dsk_phead_t head             physical side of disk
+//         int lsect                    logical sector number
+// return: void
+//==============================================================================
+static void progress_sector (dsk_pcyl_t cyl, dsk_phead_t head, int lsect)
+{
+ progress.cyl = cyl;
+ progress.head = head;
+ progress.lsect = lsect;
+
+ if (time_get_ms() - progress.last_ms >= PROGRESS_MS)
+    progress_show();
+}
+
+//==============================================================================
+// Note the start of a track.
+//
+// Also updates the drive pair status display if this is a --pair thread.
+//
+//   pass: int trk                      logical track number
+//         dsk_pcyl_t cyl               cylinder number
+//         dsk_phead_t head             physical side of disk
+// return: void
+//==============================================================================
+static void progress_track (int trk, dsk_pcyl_t cyl, dsk_phead_t head)
+{
+ progress.trk = trk;
+ progress_sector(cyl, head, 0);
+
+ if (pair_cur)
+    {
+     pair_cur->trk = trk - progress.trk_start + 1;
+     pair_cur->trks = progress.trk_finish - progress.trk_start + 1;
+     pair_cur->errors = sect_errors_tot;
+    }
+}
+
+//==============================================================================
+// End the copy progress display.
+//
+// The final values are shown.
+//
+//   pass: void
+// return: void
+//==============================================================================
+static void progress_end (void)
+{
+ progress.trk = progress.trk_finish + 1;
+ progress.lsect = 0;
+ progress_show();
+
+ if (pair_cur)
+    {
+     pair_cur->trk = pair_cur->trks;
+     pair_cur->errors = sect_errors_tot;
+    }
+}
+
+//==============================================================================
+// Emit a phase timing event (--events).
+//
+// The time taken since the last phase ended is reported and the timing of
+// the next phase is started.
+//
+//   pass: char *name                   phase name, NULL to only start timing
+// return: void
+//==============================================================================
+static void event_phase (char *name)
+{
+ uint64_t now = time_get_ms();
+
+ if (name)
+    event_emit("phase", "\"phase\":\"%s\",\"ms\":%llu", name,
+    (unsigned long long)(now - phase_ms));
+ phase_ms = now;
+}
+
+//==============================================================================
+// Emit a sector error event (--events).
+//
+//   pass: dsk_pcyl_t cyl               cylinder number
+//         dsk_phead_t head             physical side of disk
+//         int psect                    physical sector number
+// return: void
+//==============================================================================
+static void event_sector_error (dsk_pcyl_t cyl, dsk_phead_t head, int psect)
+{
+ event_emit("sector_error", "\"cyl\":%d,\"head\":%d,\"sector\":%d", cyl,
+ head, psect);
+}
+
+//==============================================================================
+// Emit a track event (--events).
+//
+//   pass: char *name                   event name
+//         int trk                      logical track
+//         dsk_pcyl_t cyl               cylinder number
+//         dsk_phead_t head             physical side of disk
+//         int errors                   sector errors on the track, -1 if none
+//                                      are to be reported
+//         int retries                  sector retries on the track
+// return: void
+//==============================================================================
+static void event_track (char *name, int trk, dsk_pcyl_t cyl,
+                         dsk_phead_t head, int errors, int retries)
+{
+ if (errors < 0)
+    event_emit(name, "\"trk\":%d,\"cyl\":%d,\"head\":%d", trk, cyl, head);
+ else
+    event_emit(name, "\"trk\":%d,\"cyl\":%d,\"head\":%d,\"errors\":%d,"
+    "\"retries\":%d", trk, cyl, head, errors, retries);
+}
+
 //==============================================================================
 // Ask user for overwrite permission if destination disk file already exists.
 //
@@ -867,7 +1315,12 @@ static int pause_menu (int options, int cyl_last)
 {
  char user[100];
 
- if (get_key() == -1)
+ // a drive pair thread is aborted by the operator from the status display
+ if (pair_cur)
+    return pair_cur->abort? DSK_ERR_ABORT : DSK_ERR_OK;
+
+ // only a flag is tested unless a key has been pressed
+ if (! key_pending() || get_key() == -1)
     return DSK_ERR_OK;
     
  user[0] = 0;
@@ -1185,16 +1638,17 @@ static int format_track_size (fdc_format_data_t *fmtd,
 // =====================
 // Not currently supported.
 //
-//   pass: DSK_FORMAT *format           information for 1 track
+//   pass: DSK_GEOMETRY *g              geometry to be used
+//         DSK_FORMAT *format           information for 1 track
 // return: int                          0 else -1 if error
 //==============================================================================
-static int fdc_buffer_format (DSK_FORMAT *format)
+static int fdc_buffer_format (DSK_GEOMETRY *g, DSK_FORMAT *format)
 {
  int track_nominal;
  int track_calc;
  int track_max;
  int dt;
- int fmtgap = dg.dg_fmtgap;   
+ int fmtgap = g->dg_fmtgap;   
 
  fdc_format_data_t *p;
 
@@ -1228,13 +1682,13 @@ static int fdc_buffer_format (DSK_FORMAT *format)
  if (disk.verbose > 1)    
     printf("drive-type=%c datarate=%s rec-mode=%s fmtgap=%d sectors=%d\n",
     dt, datarates_str[xdg.dg_odatarate],
-    dg.dg_fm? "fm":"mfm", dg.dg_fmtgap, dg.dg_sectors);
+    g->dg_fm? "fm":"mfm", g->dg_fmtgap, g->dg_sectors);
 
  // nominal bytes per track (10416/12500/5208/6250) at full density
  track_nominal = (data_rates_val[xdg.dg_odatarate] / 8) / ((dt == 'h')? 6:5);
 
  // if FM mode then halve the amount of data that will fit onto a track
- if (dg.dg_fm)
+ if (g->dg_fm)
     track_nominal /= 2;
 
  // reduce the nominal track size to make sure a complete track will fit due
@@ -1243,7 +1697,7 @@ static int fdc_buffer_format (DSK_FORMAT *format)
  track_max = track_nominal - (track_nominal * (2.5 / 100.0));
 
  // pointer to the FM or MFM format data
- p = (dg.dg_fm == 1) ? (fdc_format_data_t *)ibm_3740 :
+ p = (g->dg_fm == 1) ? (fdc_format_data_t *)ibm_3740 :
  (fdc_format_data_t *)ibm_system_34;
 
  // determine early GAP4 value if value known in advance
@@ -1254,7 +1708,7 @@ static int fdc_buffer_format (DSK_FORMAT *format)
        fmtgap = disk.gap_set[GAP4];
                    
  // calulate the track size
- track_calc = format_track_size(p, format, fmtgap, dg.dg_sectors);
+ track_calc = format_track_size(p, format, fmtgap, g->dg_sectors);
 
  if (track_calc == -1)
     {
@@ -1267,10 +1721,10 @@ static int fdc_buffer_format (DSK_FORMAT *format)
  if (fmtgap == 0)
     {
      // find gap value
-     fmtgap = (track_max - track_calc) / dg.dg_sectors;
+     fmtgap = (track_max - track_calc) / g->dg_sectors;
                  
      // adjust the size value for final GAP
-     track_calc += (fmtgap * dg.dg_sectors);
+     track_calc += (fmtgap * g->dg_sectors);
                                 
      if (disk.verbose > 1)
         printf("Using AUTO GAP method for GAP4 - fmtgap=%d track_calc=%d\n",
@@ -1287,12 +1741,12 @@ static int fdc_buffer_format (DSK_FORMAT *format)
     }
 
  // plug the 'fmtgap' value back into the disk geometry     
- dg.dg_fmtgap = fmtgap;
+ g->dg_fmtgap = fmtgap;
  
  // what do we do with dg_rwgap value? we had set it to same value as the
  // calculated dg_fmtgap before but it is not clear if it is ever used
  if (dg_opts.rwgap == -1) 
-    dg.dg_rwgap = fmtgap;
+    g->dg_rwgap = fmtgap;
  
  if (disk.verbose > 1)
     printf("track_nominal=%d usable track size=%d actual track_calc=%d\n",
@@ -1307,6 +1761,116 @@ static int fdc_buffer_format (DSK_FORMAT *format)
  return 0;
 }    
 
+//==============================================================================
+// Create the track plan.
+//
+// The track plan holds the sector format structures and GAP values for each
+// logical track once they have been worked out so that the same work is not
+// repeated for every sector read and every track written.  An entry is only
+// used if the geometry matches that of when it was created as call-backs may
+// change the geometry from one track to the next.
+//
+// Each thread has it's own track plan.
+//
+//   pass: void
+// return: void
+//==============================================================================
+static void track_plan_init (void)
+{
+ track_plan_free();
+
+ track_plan_floppy = (string_search(is_floppy_otypes, disk.otype) != -1);
+ track_plan_size = dg.dg_cylinders * dg.dg_heads;
+ if (track_plan_size > 0)
+    track_plan = calloc(track_plan_size, sizeof(track_plan_t));
+ if (! track_plan)
+    track_plan_size = 0;
+}
+
+//==============================================================================
+// Free the track plan.
+//
+//   pass: void
+// return: void
+//==============================================================================
+static void track_plan_free (void)
+{
+ int i;
+
+ if (! track_plan)
+    return;
+
+ for (i = 0; i < track_plan_size; i++)
+    free(track_plan[i].format);
+ free(track_plan);
+
+ track_plan = NULL;
+ track_plan_size = 0;
+}
+
+//==============================================================================
+// Get the track plan entry for a track.
+//
+// The entry is marked as not valid if the geometry has changed since it was
+// created.
+//
+//   pass: DSK_GEOMETRY *g              geometry to be used
+//         dsk_pcyl_t cyl               cylinder number
+//         dsk_phead_t head             physical side of disk
+// return: track_plan_t *               entry, NULL if no track plan
+//==============================================================================
+static track_plan_t *track_plan_get (DSK_GEOMETRY *g, dsk_pcyl_t cyl,
+                                     dsk_phead_t head)
+{
+ track_plan_t *tp;
+ int trk = cyl * g->dg_heads + head;
+
+ if (! track_plan || trk >= track_plan_size)
+    return NULL;
+
+ tp = &track_plan[trk];
+
+ if (tp->sectors != g->dg_sectors || tp->secsize != g->dg_secsize ||
+     tp->secbase != g->dg_secbase || tp->fm != g->dg_fm)
+    tp->valid = 0;
+
+ return tp;
+}
+
+//==============================================================================
+// Store the worked out track values in a track plan entry.
+//
+//   pass: track_plan_t *tp             track plan entry
+//         DSK_GEOMETRY *g              geometry used
+//         int side                     side ID value used
+//         DSK_FORMAT *format           format structure for the track
+// return: void
+//==============================================================================
+static void track_plan_store (track_plan_t *tp, DSK_GEOMETRY *g, int side,
+                              DSK_FORMAT *format)
+{
+ if (tp->sectors != g->dg_sectors || ! tp->format)
+    {
+     free(tp->format);
+     tp->format = malloc(sizeof(DSK_FORMAT) * g->dg_sectors);
+     if (! tp->format)
+        {
+         tp->valid = 0;
+         return;
+        }
+    }
+
+ memcpy(tp->format, format, sizeof(DSK_FORMAT) * g->dg_sectors);
+ tp->side = side;
+ tp->sectors = g->dg_sectors;
+ tp->secsize = g->dg_secsize;
+ tp->secbase = g->dg_secbase;
+ tp->fm = g->dg_fm;
+ tp->fmtgap = g->dg_fmtgap;
+ tp->rwgap = g->dg_rwgap;
+ tp->valid = 1;
+}
+
 //==============================================================================
 // Set the values in the 'format' structure for a single track based on the
 // passed cylinders, head and side values.
@@ -1314,23 +1878,45 @@ static int fdc_buffer_format (DSK_FORMAT *format)
 // A format operation will call this for each track to be formatted.  A read
 // operation may only call it once so that the GAP values can be calculated.
 //
-//   pass: dsk_pcyl_t cyl               cylinder number
+//   pass: DSK_GEOMETRY *g              geometry to be used
+//         dsk_pcyl_t cyl               cylinder number
 //         dsk_phead_t head             physical side of disk
 //         int side                     side ID value
 // return: int                          0 else -1 if error
 //==============================================================================
-static dsk_err_t set_format_struct (dsk_pcyl_t cyl, dsk_phead_t head, int side,
+static dsk_err_t set_format_struct (DSK_GEOMETRY *g, dsk_pcyl_t cyl,
+                                    dsk_phead_t head, int side,
                                     DSK_FORMAT *format)
 {
+ track_plan_t *tp;
  int lsect;
  int psect = 0;
  int skewing;
- int floppy_type = (string_search(is_floppy_otypes, disk.otype) != -1);
+ int floppy_type;
+
+ // use the track plan values if this track has already been worked out
+ tp = track_plan_get(g, cyl, head);
+ if (tp && tp->valid)
+    {
+     memcpy(format, tp->format, sizeof(DSK_FORMAT) * g->dg_sectors);
+     if (tp->side != side)
+        for (lsect = 0; lsect < g->dg_sectors; lsect++)
+           format[lsect].fmt_head = side;
+     g->dg_fmtgap = tp->fmtgap;
+     if (dg_opts.rwgap == -1) 
+        g->dg_rwgap = tp->rwgap;
+     return 0;
+    }
+
+ if (track_plan)
+    floppy_type = track_plan_floppy;
+ else
+    floppy_type = (string_search(is_floppy_otypes, disk.otype) != -1);
 
  if (disk.verbose > 1)
     printf(" Physical sectors: "); 
 
- for (lsect = 0; lsect < dg.dg_sectors; lsect++)
+ for (lsect = 0; lsect < g->dg_sectors; lsect++)
     {
      format[lsect].fmt_cylinder = cyl;
      format[lsect].fmt_head = side;
@@ -1362,7 +1948,7 @@ static dsk_err_t set_format_struct (dsk_pcyl_t cyl, dsk_phead_t head, int side,
         }
 
      format[lsect].fmt_sector = psect;
-     format[lsect].fmt_secsize = dg.dg_secsize;
+     format[lsect].fmt_secsize = g->dg_secsize;
      
      if (disk.verbose > 1)
         printf("%d ", psect);
@@ -1371,7 +1957,40 @@ static dsk_err_t set_format_struct (dsk_pcyl_t cyl, dsk_phead_t head, int side,
  if (disk.verbose > 1)
     printf("\n");    
 
- return fdc_buffer_format(format);
+ if (fdc_buffer_format(g, format) == -1)
+    return -1;
+
+ if (tp)
+    track_plan_store(tp, g, side, format);
+
+ return 0;
+}
+
+//==============================================================================
+// Set the GAP values for a track.
+//
+// The 'format' structure is worked out for the track only for the GAP
+// values it sets in the geometry.
+//
+//   pass: DSK_GEOMETRY *g              geometry to be used
+//         dsk_pcyl_t cyl               cylinder number
+//         dsk_phead_t head             physical side of disk
+//         int side                     side ID value
+// return: int                          0 else -1 if error
+//==============================================================================
+static int set_format_gaps (DSK_GEOMETRY *g, dsk_pcyl_t cyl,
+                            dsk_phead_t head, int side)
+{
+ DSK_FORMAT *format;
+ int res;
+
+ if ((format = malloc(sizeof(DSK_FORMAT) * g->dg_sectors)) == NULL)
+    return -1;
+
+ res = set_format_struct(g, cyl, head, side, format);
+ free(format);
+
+ return res;
 }
 
 //==============================================================================
@@ -1381,34 +2000,48 @@ static dsk_err_t set_format_struct (dsk_pcyl_t cyl, dsk_phead_t head, int side,
 // physical skewing associated with a format type.  Physical skewing will be
 // used if the output type is floppy based and the format type requires it.
 //
-//   pass: dsk_pcyl_t cyl               cylinder number
+//   pass: DSK_GEOMETRY *g              geometry to be used
+//         dsk_pcyl_t cyl               cylinder number
 //         dsk_phead_t head             physical side of disk
 //         int side                     side ID value
 // return: dsk_err_t                    DSK_ERR_OK if successful
 //==============================================================================
-static dsk_err_t format_track (dsk_pcyl_t cyl, dsk_phead_t head, int side)
+static dsk_err_t format_track (DSK_GEOMETRY *g, dsk_pcyl_t cyl,
+                               dsk_phead_t head, int side)
 {
  dsk_err_t dsk_err = DSK_ERR_OK;
+ uint64_t t;
+
+ DSK_FORMAT *format;
 
- DSK_FORMAT format[256];
+ if ((format = malloc(sizeof(DSK_FORMAT) * g->dg_sectors)) == NULL)
+    return DSK_ERR_NOMEM;
+
+ t = profile_begin(prof);
 
  // set the 'format' structure for a track
- if (set_format_struct(cyl, head, side, format) == -1)
+ if (set_format_struct(g, cyl, head, side, format) == -1)
     dsk_err = DSK_ERR_UNKNOWN;
  else
     {
      // avoid dsk_pformat() for formats that do not support the function
      if (! output_sup.pformat)
-        return DSK_ERR_OK;
+        {
+         free(format);
+         return DSK_ERR_OK;
+        }
 
      // format one track
-     dsk_err = dsk_pformat(odrive, &dg, cyl, head, format, 0xe5);
+     dsk_err = trace_pformat(odrive, g, cyl, head, format, 0xe5);
 
      // ignore formatting if the driver does not support the format function.
      if (dsk_err == DSK_ERR_NOTIMPL)
-        return DSK_ERR_OK;
+        dsk_err = DSK_ERR_OK;
     }
 
+ free(format);
+ profile_end(prof, PROFILE_FORMAT, cyl * g->dg_heads + head, t);
+
  // report the error 
  if (dsk_err != DSK_ERR_OK)
     {
@@ -1454,7 +2087,16 @@ static dsk_err_t format_track_range (int start, int finish)
                 cyl, dg.dg_cylinders-1, head, dg.dg_heads-1);
          fflush(stdout);
         } 
-     dsk_err = format_track(cyl, head, head + xdg.dg_sideoffs);
+     // a raw output being written directly only needs the fill bytes
+     if (raw_outf)
+        {
+         if (track_buf_alloc() == -1)
+            return DSK_ERR_NOMEM;
+         memset(buf, 0xe5, dg.dg_sectors * dg.dg_secsize);
+         dsk_err = raw_output_write(cyl, head);
+        }
+     else
+        dsk_err = format_track(&dg, cyl, head, head + xdg.dg_sideoffs);
     }
 
  if (dsk_err != DSK_ERR_OK)
@@ -1470,19 +2112,80 @@ static dsk_err_t format_track_range (int start, int finish)
  return dsk_err;
 }
 
+//==============================================================================
+// Make sure the track buffers can hold a track of the current geometry.
+//
+// The track data buffer, skew table and sector read flags grow as needed so
+// the size of a track is only limited by the memory available.
+//
+//   pass: void
+// return: int                          0 if no error, else -1
+//==============================================================================
+static int track_buf_alloc (void)
+{
+ size_t size = (size_t)dg.dg_sectors * dg.dg_secsize;
+ uint8_t *temp;
+ int *temp_skew;
+
+ if (size > buf_size)
+    {
+     if ((temp = realloc(buf, size)) == NULL)
+        {
+         printf(APPNAME": unable to allocate a %d x %d track buffer.\n",
+         (int)dg.dg_sectors, (int)dg.dg_secsize);
+         return -1;
+        }
+     buf = temp;
+     buf_size = size;
+    }
+
+ if ((int)dg.dg_sectors > track_sectors_size)
+    {
+     temp_skew = realloc(skew_table, sizeof(int) * dg.dg_sectors);
+     if (temp_skew)
+        skew_table = temp_skew;
+     temp = realloc(buffered_ok, dg.dg_sectors);
+     if (temp)
+        buffered_ok = temp;
+     if (! temp_skew || ! temp)
+        {
+         printf(APPNAME": unable to allocate track tables for %d sectors.\n",
+         (int)dg.dg_sectors);
+         return -1;
+        }
+     track_sectors_size = dg.dg_sectors;
+    }
+
+ return 0;
+}
+
 //==============================================================================
 // Generate skew data for reading sectors based on the parameters passed.
 //
+// The track buffers are made large enough for the current geometry first.
+//
 //   pass: int skew                     skewing value
 //         int start                    first logical sector in table
 //         int sectors                  number of sectors per track
-// return: void
+// return: int                          0 if no error, else -1
 //==============================================================================
-static void create_skew_table (int skew, int start, int sectors)
+static int create_skew_table (int skew, int start, int sectors)
 {
  int i;
  int k;
  int j = start;
+
+ if (track_buf_alloc() == -1)
+    return -1;
+
+ // the table only needs to be created again if the values have changed
+ if (skew == skew_table_val && start == skew_table_ofs &&
+     sectors == skew_table_sectors)
+    return 0;
+
+ skew_table_val = skew;
+ skew_table_ofs = start;
+ skew_table_sectors = sectors;
  
  for (i = 0; i < sectors; ++i)
     {
@@ -1501,6 +2204,8 @@ static void create_skew_table (int skew, int start, int sectors)
      
      j = (j + skew) % sectors;
     }
+
+ return 0;
 }
 
 //==============================================================================
@@ -1522,10 +2227,17 @@ static void create_skew_table (int skew, int start, int sectors)
 // system might use.  It's only purpose is for speeding up reading data from
 // a floppy under ubeedisk.
 //
-// If the track read fails then the calling process should then manage the
-// reading of all the sectors on the track concerned.
+// Sectors that fail to read are skipped and the rest of the track is still
+// read in rotation order.  buffered_ok[] records which sectors are held so
+// that the calling process only needs to retry the failed sectors.  If
+// BUFFERED_ERRORS_MAX sectors fail the remainder of the track is left to be
+// read sector by sector.
 //
-// To see the skew values use --verbose=2 on the command line.
+// To see the skew values use --verbose=2 on the command line.  --disk=plan
+// predicts the revolutions each skew combination takes for a format from
+// it's gap values and the host turnaround time (--turnaround) and shows
+// the quickest.  --disk=calibrate times them on the drive and the quickest
+// are then used for the drive and format.
 //
 // Below are various skew value combinations for the Microbee DS40 format. 
 // The 1,2 (default) method requires 3 disk rotations to read in a complete
@@ -1555,8 +2267,10 @@ static dsk_err_t read_buffered_track (dsk_pcyl_t cyl, dsk_pcyl_t xcyl,
  uint8_t *p;
  int psect;
  int i;
+ int errors = 0;
  dsk_err_t implemented = DSK_ERR_OK;
  dsk_err_t dsk_err = DSK_ERR_OK;
+ dsk_err_t dsk_err_last = DSK_ERR_OK;
 
  //printf("read_buffered_track()\n");
 
@@ -1564,6 +2278,11 @@ static dsk_err_t read_buffered_track (dsk_pcyl_t cyl, dsk_pcyl_t xcyl,
  if (! input_sup.xread)
     implemented = DSK_ERR_NOTIMPL;
 
+ // the buffer now belongs to this track, no sectors held yet
+ buffered_cylinder = cyl;
+ buffered_head = head;
+ memset(buffered_ok, 0, dg.dg_sectors);
+
  // read in the complete track without any console IO (unless --verbose > 1)
  for (i = 0; i < dg.dg_sectors; i++)
     {
@@ -1581,58 +2300,69 @@ static dsk_err_t read_buffered_track (dsk_pcyl_t cyl, dsk_pcyl_t xcyl,
         {
          // else read the sector
          if (dsk_err != DSK_ERR_NOTIMPL)
-            dsk_err = dsk_xread(idrive, &dg, p, cyl, head, xcyl, xhead, psect,
+            dsk_err = sim_xread(idrive, &dg, p, cyl, head, xcyl, xhead, psect,
             dg.dg_secsize, NULL);
 
          if (dsk_err == DSK_ERR_NOTIMPL)
-            dsk_err = dsk_pread(idrive, &dg, p, cyl, head, psect);
+            dsk_err = sim_pread(idrive, &dg, p, cyl, head, psect);
 
-         // abort the track read if an error (will use sector by sector)
+         // keep going with the rest of the track if a sector fails, the
+         // failed sector will be retried on it's own.  If too many fail the
+         // track is probably bad so leave the rest to sector reads.
          if (dsk_err != DSK_ERR_OK)
-            break;
-        }
-    }
+            {
+             dsk_err_last = dsk_err;
+             if (++errors == BUFFERED_ERRORS_MAX)
+                break;
+             continue;
+            }
+        }
 
- // if error save the cylinder and head as negative values before returning
- if (dsk_err != DSK_ERR_OK)
-    {
-     buffered_cylinder = -2;  // flag it to use non buffered reads
-     return dsk_err;
-    } 
+     buffered_ok[i] = 1;
+    }
 
- // save the buffered locations
- buffered_cylinder = cyl;
- buffered_head = head;
- 
- return dsk_err;
+ if (disk.verbose > 1 && errors)
+    printf("read_buffered_track(): %d sector(s) failed\n", errors);
+
+ return dsk_err_last;
 }
 
 //==============================================================================
 // Write a buffered track.
 //
-//   pass: dsk_pcyl_t cyl               physical drive cylinder number
+// The geometry, track data and skew table are passed so that a track
+// buffered by the pipeline reader can be written out while the global values
+// are already being used for the next track.
+//
+//   pass: DSK_GEOMETRY *g              geometry the track was read with
+//         uint8_t *tbuf                track data buffer
+//         int *tskew                   skew table the track was read with
+//         dsk_pcyl_t cyl               physical drive cylinder number
 //         dsk_pcyl_t xcyl              ID cylinder value
 //         dsk_phead_t head             physical drive side
 //         dsk_phead_t xhead            ID side value
 // return: dsk_err_t                    DSK_ERR_OK if successful
 //==============================================================================
-static dsk_err_t write_buffered_track (dsk_pcyl_t cyl, dsk_pcyl_t xcyl,
+static dsk_err_t write_buffered_track (DSK_GEOMETRY *g, uint8_t *tbuf,
+                                       int *tskew,
+                                       dsk_pcyl_t cyl, dsk_pcyl_t xcyl,
                                        dsk_phead_t head, dsk_phead_t xhead)
 {
- DSK_FORMAT format[256];
  uint8_t *p;
  int i;
  int psect;
  dsk_pcyl_t use_cyl;
- dsk_phead_t use_head = xhead;
+ dsk_phead_t use_head;
  dsk_err_t dsk_err = DSK_ERR_OK;
+ int trk = cyl * g->dg_heads + head;
+ uint64_t t;
 
  // set data rate and MFM/FM mode for output
- dg.dg_datarate = xdg.dg_odatarate;
- dg.dg_fm = xdg.dg_ofm;
+ g->dg_datarate = xdg.dg_odatarate;
+ g->dg_fm = xdg.dg_ofm;
 
  if (disk.verbose > 1)
-    report_dg(&dg);
+    report_dg(g);
  
  // seems LibDsk DSK and RAW drivers do not support the --oside option and
  // only works for floppy access?  Provide a work around if setting --oside
@@ -1643,19 +2373,25 @@ static dsk_err_t write_buffered_track (dsk_pcyl_t cyl, dsk_pcyl_t xcyl,
      xhead = disk.oside;  // not a perfect solution
     }
 
- // set the 'format' structure for this track
- if (set_format_struct(cyl, head, xhead, format) == -1)
+ // set the GAP values for this track
+ if (set_format_gaps(g, cyl, head, xhead) == -1)
     return DSK_ERR_UNKNOWN;
+
+ // the sector ID values to be written are the same for the whole track,
+ // with --forceside off the IDs read from the input are used
+ use_cyl = (disk.forceside == 0)? xcyl : cyl;
+ use_head = (disk.forceside == 0)? xhead : format_side_id(head, xhead);
     
 //#define DEBUG_BUFFERING 
 #ifndef DEBUG_BUFFERING 
- for (i = 0; i < dg.dg_sectors; i++)
+ t = profile_begin(prof);
+ for (i = 0; i < g->dg_sectors; i++)
     {
      // get the skewed physical sector number
-     psect = skew_table[i] + dg.dg_secbase;
+     psect = tskew[i] + g->dg_secbase;
 
      // calculate the buffer location of the sector data
-     p = buf + dg.dg_secsize * (psect - dg.dg_secbase);
+     p = tbuf + g->dg_secsize * (psect - g->dg_secbase);
     
      // write the sector to the output file, avoid dsk_xwrite() for types
      // that do not support the function
@@ -1663,50 +2399,19 @@ static dsk_err_t write_buffered_track (dsk_pcyl_t cyl, dsk_pcyl_t xcyl,
         dsk_err = DSK_ERR_NOTIMPL;
      else
         {
-         use_cyl = cyl;
-
-         switch (disk.forceside)
-            {
-             case 0 : // off
-                use_cyl = xcyl;
-                use_head = xhead;
-                break;
-             case 1 : // on
-                use_head = head;
-                break;
-             case 2 : // 00
-                use_head = 0;
-                break;
-             case 3 : // 01
-                if (head == 0)
-                   use_head = 0;
-                else
-                   use_head = 1;
-                break;
-             case 4 : // 10
-                if (head == 0)
-                   use_head = 1;
-                else
-                   use_head = 0;
-                break;
-             case 5 : // 11
-                use_head = 1;
-                break;
-            }        
-
-         dsk_err = dsk_xwrite(odrive, &dg, p, cyl, head, 
-         use_cyl, use_head, psect, dg.dg_secsize, 0);
+         dsk_err = trace_xwrite(odrive, g, p, cyl, head, 
+         use_cyl, use_head, psect, g->dg_secsize, 0);
         }
 
      if (dsk_err == DSK_ERR_NOTIMPL)
-        dsk_err = dsk_pwrite(odrive, &dg, p, cyl, head, psect);
+        dsk_err = trace_pwrite(odrive, g, p, cyl, head, psect);
 
      if (disk.verbose > 1)
-        printf("%d ", psect);  fflush(stdout);
+        printf("%d ", psect);
 
      if (dsk_err != DSK_ERR_OK)
         {
-         if (++disk.write_error_count <= 10)        
+         if (++disk.write_error_count <= 10)
              printf("\n"APPNAME": write_buffered_track() Cyl:%03d Head:%02d "
              "Error:%s\n", cyl, head, dsk_strerror(dsk_err));
 
@@ -1714,9 +2419,10 @@ static dsk_err_t write_buffered_track (dsk_pcyl_t cyl, dsk_pcyl_t xcyl,
             printf(APPNAME": write_buffered_track() Only the first 10 "
             "write errors will be reported.\n");
          
-         return dsk_err;
+         break;
         }
     }
+ profile_end(prof, PROFILE_WRITE, trk, t);
 
  if (disk.verbose > 1)
     printf("\n dsk_err=%d", dsk_err);    
@@ -1726,6 +2432,411 @@ static dsk_err_t write_buffered_track (dsk_pcyl_t cyl, dsk_pcyl_t xcyl,
  return dsk_err;
 }
 
+//==============================================================================
+// Determine the side ID value to be used when formatting an output track.
+//
+// The value depends on the --forceside setting and if the input type
+// supports a true psecid function.
+//
+//   pass: dsk_phead_t head             physical side of disk
+//         int xhead                    side ID value read from the input
+// return: int                          side ID value to format with
+//==============================================================================
+static int format_side_id (dsk_phead_t head, int xhead)
+{
+ switch (disk.forceside)
+    {
+     case 0 : // off
+        // follow the input sector header ID value (xhead) if a true psecid
+        // supported or xdg.dg_sideoffs is set
+        if (input_sup.psecid || xdg.dg_sideoffs)
+           return xhead;
+        // else the format's side1as0 value will determine
+        return xhead & (1 ^ xdg.dg_side1as0);
+     case 1 : // on
+        // force side ID to be equal to the physical side
+        return head;
+     case 2 : // 00
+        return 0;
+     case 3 : // 01
+        return (head == 0)? 0 : 1;
+     case 4 : // 10
+        return (head == 0)? 1 : 0;
+     case 5 : // 11
+        return 1;
+    }
+
+ return xhead;
+}
+
+//==============================================================================
+// Copy the current session state.
+//
+// Takes a copy of the configuration, geometry and drive handles of the
+// session running in the calling thread.  The copy may then be loaded by
+// another thread with session_load() to run a copy, scan or detect of it's
+// own.  The track buffer, info and counter values are not copied as these
+// are set up by each job.
+//
+//   pass: session_t *s                 session structure to copy to
+// return: void
+//==============================================================================
+void session_save (session_t *s)
+{
+ memcpy(&s->disk, &disk, sizeof(disk_t));
+ memcpy(&s->dg_opts, &dg_opts, sizeof(dg_opts_t));
+ memcpy(&s->xdg, &xdg, sizeof(xdg_t));
+ memcpy(&s->dg, &dg, sizeof(DSK_GEOMETRY));
+ memcpy(&s->cdg, &cdg, sizeof(DSK_GEOMETRY));
+ memcpy(&s->input_sup, &input_sup, sizeof(sup_t));
+ memcpy(&s->output_sup, &output_sup, sizeof(sup_t));
+ s->idrive = idrive;
+ s->odrive = odrive;
+ s->infof = infof;
+ s->errorf = errorf;
+}
+
+//==============================================================================
+// Load a session state.
+//
+// Makes the session copied by session_save() the current session for the
+// calling thread.
+//
+//   pass: session_t *s                 session structure to load from
+// return: void
+//==============================================================================
+void session_load (session_t *s)
+{
+ memcpy(&disk, &s->disk, sizeof(disk_t));
+ memcpy(&dg_opts, &s->dg_opts, sizeof(dg_opts_t));
+ memcpy(&xdg, &s->xdg, sizeof(xdg_t));
+ memcpy(&dg, &s->dg, sizeof(DSK_GEOMETRY));
+ memcpy(&cdg, &s->cdg, sizeof(DSK_GEOMETRY));
+ memcpy(&input_sup, &s->input_sup, sizeof(sup_t));
+ memcpy(&output_sup, &s->output_sup, sizeof(sup_t));
+ idrive = s->idrive;
+ odrive = s->odrive;
+ infof = s->infof;
+ errorf = s->errorf;
+}
+
+#ifndef WIN32
+//==============================================================================
+// Pipeline writer thread.
+//
+// Takes tracks from the ring of track buffers in the order read, formats
+// the output track if required and writes the track data out.  Each slot
+// holds it's own geometry and skew table snapshot so the reader is free to
+// change it's session values for the next track.  The writer runs with a
+// copy of the reader's session taken when the pipeline was started.
+//
+// A slot is only handed back to the reader after the track has been written
+// so that the track buffer can't be overwritten while still in use.  A track
+// that can't be formatted or written is flagged in it's slot for the reader
+// to mark as errors.
+//
+//   pass: void *arg                    pipeline (pipe_t *)
+// return: void *                       NULL
+//==============================================================================
+static void *pipeline_writer (void *arg)
+{
+ pipe_t *p = arg;
+ pipe_slot_t *slot;
+ dsk_err_t dsk_err;
+
+ session_load(&p->session);
+ prof = p->prof;
+ track_plan_init();
+
+ for (;;)
+    {
+     pthread_mutex_lock(&p->mutex);
+     while (p->count == 0 && ! p->done)
+        pthread_cond_wait(&p->cond_used, &p->mutex);
+     if (p->count == 0)
+        {
+         pthread_mutex_unlock(&p->mutex);
+         break;
+        }
+     slot = &p->slots[p->get];
+     pthread_mutex_unlock(&p->mutex);
+
+     dsk_err = DSK_ERR_OK;
+
+     // format one track (a format error skips writing the track)
+     if (slot->fside != -1)
+        dsk_err = format_track(&slot->dg, slot->cyl, slot->head, slot->fside);
+
+     if (dsk_err == DSK_ERR_OK)
+        dsk_err = write_buffered_track(&slot->dg, slot->buf, slot->skew,
+        slot->cyl, slot->cyl, slot->head, slot->xhead);
+
+     slot->failed = (dsk_err != DSK_ERR_OK);
+
+     // the track is only recorded as done once it has been written and
+     // synced to the output image
+     if (dsk_err == DSK_ERR_OK && slot->ckpt && *slot->ckpt &&
+        output_sync() == 0)
+        checkpoint_write(p->ckptf, slot->ckpt);
+
+     // hand the slot back to the reader
+     pthread_mutex_lock(&p->mutex);
+     p->get = (p->get + 1) % p->size;
+     p->count--;
+     pthread_cond_signal(&p->cond_free);
+     pthread_mutex_unlock(&p->mutex);
+    }
+
+ // pass the write errors made here back to the reader's session, the
+ // writer's count started from the reader's count
+ p->write_error_count = disk.write_error_count -
+                        p->session.disk.write_error_count;
+
+ track_plan_free();
+
+ return NULL;
+}
+
+//==============================================================================
+// Mark the sectors of a track that was not written as errors.
+//
+// The sectors were placed in the info map when the track was read, any not
+// already in error are changed to errors and counted.  This is called by the
+// reader as the info map belongs to it.
+//
+//   pass: int info_trk                 info map track, -1 if none
+//         int sectors                  sectors in the track
+// return: void
+//==============================================================================
+static void pipeline_track_failed (int info_trk, int sectors)
+{
+ int i;
+
+ for (i = 0; i < sectors; i++)
+    {
+     if (info_trk != -1)
+        {
+         if (info_map_get(&info.map, info_trk, i) == INFO_ERROR)
+            continue;
+         info_map_set(&info.map, info_trk, i, INFO_ERROR);
+        }
+     sect_errors_tot++;
+    }
+}
+#endif
+
+//==============================================================================
+// Start the read/write pipeline.
+//
+// If --pipeline=n is set a ring of n track buffers is allocated and a
+// writer thread is started.  Track formatting and writing to the output will
+// then overlap with reading of the next tracks from the input.  If the
+// pipeline can't be started the copy continues in the normal sequential
+// manner.
+//
+//   pass: void
+// return: void
+//==============================================================================
+static void pipeline_start (void)
+{
+ pipe_active = 0;
+
+ if (disk.pipeline < 1)
+    return;
+
+#ifdef WIN32
+ printf(APPNAME": --pipeline is not supported on this system, ignored.\n");
+#else
+ pipe_t *p;
+ int i;
+
+ p = calloc(1, sizeof(pipe_t));
+ if (! p || track_buf_alloc() == -1)
+    {
+     free(p);
+     printf(APPNAME": pipeline_start() - unable to start pipeline, using"
+            " sequential copy.\n");
+     return;
+    }
+
+ p->size = disk.pipeline;
+ p->ckptf = ckptf;
+ p->prof = prof;
+ pthread_mutex_init(&p->mutex, NULL);
+ pthread_cond_init(&p->cond_used, NULL);
+ pthread_cond_init(&p->cond_free, NULL);
+ session_save(&p->session);
+
+ for (i = 0; i < p->size; i++)
+    {
+     // the slot buffers grow in pipeline_put() if a larger track is read
+     p->slots[i].buf = calloc(1, buf_size);
+     p->slots[i].skew = calloc(track_sectors_size, sizeof(int));
+     if (! p->slots[i].buf || ! p->slots[i].skew)
+        break;
+     p->slots[i].buf_size = buf_size;
+     p->slots[i].skew_size = track_sectors_size;
+     if (ckptf && ! (p->slots[i].ckpt = malloc(CKPT_RECORD_SIZE)))
+        break;
+    }
+
+ if (i == p->size && pthread_create(&p->thread, NULL, pipeline_writer,
+    p) == 0)
+    {
+     pipe_ctx = p;
+     pipe_active = 1;
+     if (disk.verbose > 1)
+        printf("pipeline_start(): %d track buffers\n", p->size);
+     return;
+    }
+
+ printf(APPNAME": pipeline_start() - unable to start pipeline, using"
+        " sequential copy.\n");
+ for (i = 0; i < p->size; i++)
+    {
+     free(p->slots[i].buf);
+     free(p->slots[i].skew);
+     free(p->slots[i].ckpt);
+    }
+ pthread_mutex_destroy(&p->mutex);
+ pthread_cond_destroy(&p->cond_used);
+ pthread_cond_destroy(&p->cond_free);
+ free(p);
+#endif
+}
+
+//==============================================================================
+// Place the track held in the session buffer into the pipeline.
+//
+// Waits for a free slot if the writer has fallen behind by the number of
+// slots in the ring.  The session geometry, skew table and track data are
+// copied into the slot.  If the track last held in the slot could not be
+// written it's sectors are marked as errors first.
+//
+//   pass: dsk_pcyl_t cyl               physical drive cylinder number
+//         dsk_phead_t head             physical drive side
+//         dsk_phead_t xhead            ID side value
+//         int fside                    format side ID, -1 if no format
+// return: void
+//==============================================================================
+static void pipeline_put (dsk_pcyl_t cyl, dsk_phead_t head, dsk_phead_t xhead,
+                          int fside)
+{
+#ifndef WIN32
+ pipe_t *p = pipe_ctx;
+ pipe_slot_t *slot;
+ size_t size = (size_t)dg.dg_secsize * dg.dg_sectors;
+ uint8_t *temp;
+ int *temp_skew;
+
+ pthread_mutex_lock(&p->mutex);
+ while (p->count == p->size)
+    pthread_cond_wait(&p->cond_free, &p->mutex);
+ slot = &p->slots[p->put];
+ pthread_mutex_unlock(&p->mutex);
+
+ if (slot->failed)
+    {
+     pipeline_track_failed(slot->info_trk, slot->dg.dg_sectors);
+     slot->failed = 0;
+    }
+
+ // the slot is free so it's buffers may be made larger
+ if (size > slot->buf_size)
+    {
+     if ((temp = realloc(slot->buf, size)) == NULL)
+        {
+         printf(APPNAME": pipeline_put() - no memory for track buffer, track"
+                " not written.\n");
+         disk.write_error_count++;
+         pipeline_track_failed(info.trk, dg.dg_sectors);
+         return;
+        }
+     slot->buf = temp;
+     slot->buf_size = size;
+    }
+ if ((int)dg.dg_sectors > slot->skew_size)
+    {
+     temp_skew = realloc(slot->skew, sizeof(int) * dg.dg_sectors);
+     if (! temp_skew)
+        {
+         printf(APPNAME": pipeline_put() - no memory for track buffer, track"
+                " not written.\n");
+         disk.write_error_count++;
+         pipeline_track_failed(info.trk, dg.dg_sectors);
+         return;
+        }
+     slot->skew = temp_skew;
+     slot->skew_size = dg.dg_sectors;
+    }
+
+ slot->cyl = cyl;
+ slot->head = head;
+ slot->xhead = xhead;
+ slot->fside = fside;
+ slot->info_trk = info.trk;
+ memcpy(&slot->dg, &dg, sizeof(DSK_GEOMETRY));
+ memcpy(slot->skew, skew_table, sizeof(int) * dg.dg_sectors);
+ memcpy(slot->buf, buf, dg.dg_secsize * dg.dg_sectors);
+ if (slot->ckpt)
+    strcpy(slot->ckpt, ckpt_rec);
+
+ pthread_mutex_lock(&p->mutex);
+ p->put = (p->put + 1) % p->size;
+ p->count++;
+ pthread_cond_signal(&p->cond_used);
+ pthread_mutex_unlock(&p->mutex);
+#endif
+}
+
+//==============================================================================
+// Finish the read/write pipeline.
+//
+// Waits for the writer to drain all outstanding tracks, marks the sectors of
+// any tracks that could not be written as errors and then releases the
+// track buffers.  Must be called before the output drive is used by any
+// other code.
+//
+//   pass: void
+// return: void
+//==============================================================================
+static void pipeline_finish (void)
+{
+ if (! pipe_active)
+    return;
+
+#ifndef WIN32
+ pipe_t *p = pipe_ctx;
+ int i;
+
+ pthread_mutex_lock(&p->mutex);
+ p->done = 1;
+ pthread_cond_signal(&p->cond_used);
+ pthread_mutex_unlock(&p->mutex);
+
+ pthread_join(p->thread, NULL);
+
+ disk.write_error_count += p->write_error_count;
+
+ for (i = 0; i < p->size; i++)
+    {
+     if (p->slots[i].failed)
+        pipeline_track_failed(p->slots[i].info_trk,
+        p->slots[i].dg.dg_sectors);
+     free(p->slots[i].buf);
+     free(p->slots[i].skew);
+     free(p->slots[i].ckpt);
+    }
+ pthread_mutex_destroy(&p->mutex);
+ pthread_cond_destroy(&p->cond_used);
+ pthread_cond_destroy(&p->cond_free);
+ free(p);
+ pipe_ctx = NULL;
+#endif
+
+ pipe_active = 0;
+}
+
 //==============================================================================
 // Read sector ID to find the side ID.
 //
@@ -1751,6 +2862,7 @@ int read_sector_id (dsk_pcyl_t cyl, dsk_phead_t head,
 {
  dsk_err_t dsk_err = DSK_ERR_OK;
  DSK_FORMAT result;
+ uint64_t t;
 
  // set data rate and MFM/FM mode for input
  dg.dg_datarate = xdg.dg_idatarate;
@@ -1762,8 +2874,12 @@ int read_sector_id (dsk_pcyl_t cyl, dsk_phead_t head,
  if (! input_sup.psecid)
     dsk_err = DSK_ERR_NOTIMPL;  // this will cause the values below to be used
  else
-    // get the side information from first available sector header ID
-    dsk_err = dsk_psecid(idrive, &dg, cyl, head, &result);
+    {
+     // get the side information from first available sector header ID
+     t = profile_begin(prof);
+     dsk_err = sim_psecid(idrive, &dg, cyl, head, &result);
+     profile_end(prof, PROFILE_SECID, -1, t);
+    }
 
  if (dsk_err == DSK_ERR_OK)
     {
@@ -1786,6 +2902,36 @@ int read_sector_id (dsk_pcyl_t cyl, dsk_phead_t head,
  return DSK_ERR_OK;  // we always return OK here.
 }
 
+//==============================================================================
+// Read one physical sector from the input drive into a buffer.
+//
+//   pass: dsk_pcyl_t cyl               cylinder number
+//         dsk_pcyl_t xcyl              ID cylinder value
+//         dsk_phead_t head             physical drive side
+//         dsk_phead_t xhead            ID side value
+//         int psect                    physical sector number
+//         uint8_t *p                   buffer for the sector data
+// return: dsk_err_t                    DSK_ERR_OK if successful
+//==============================================================================
+static dsk_err_t read_sector_data (dsk_pcyl_t cyl, dsk_pcyl_t xcyl,
+                                   dsk_phead_t head, dsk_phead_t xhead,
+                                   int psect, uint8_t *p)
+{
+ dsk_err_t dsk_err;
+
+ // avoid dsk_xread() for types that do not support the function
+ if (! input_sup.xread)
+    dsk_err = DSK_ERR_NOTIMPL;
+ else
+    dsk_err = sim_xread(idrive, &dg, p, cyl, head, xcyl, xhead, psect,
+    dg.dg_secsize, NULL);
+ 
+ if (dsk_err == DSK_ERR_NOTIMPL)
+    dsk_err = sim_pread(idrive, &dg, p, cyl, head, psect);
+
+ return dsk_err;
+}
+
 //==============================================================================
 // Read a sector from the input drive using the appropriate function into
 // the global buffer.
@@ -1806,36 +2952,33 @@ static dsk_err_t read_sector_x (dsk_pcyl_t cyl, dsk_pcyl_t xcyl,
                                 dsk_phead_t head, dsk_phead_t xhead,
                                 int lsect)
 {
- DSK_FORMAT format[256];
- 
  uint8_t *p;
  int psect;
+ uint64_t t;
  dsk_err_t dsk_err = DSK_ERR_OK;
 
  // set data rate and MFM/FM mode for input
  dg.dg_datarate = xdg.dg_idatarate;
  dg.dg_fm = xdg.dg_ifm;
 
- // set the 'format' structure for this track
- if (set_format_struct(cyl, head, xhead, format) == -1)
+ // set the GAP values for this track
+ if (set_format_gaps(&dg, cyl, head, xhead) == -1)
     return DSK_ERR_UNKNOWN;
 
- // read in one buffered track, if this was recorded as bad during a
- // previous track read then skip trying to buffer for the remainder of the
- // same error prone track and do it using sector reads instead
- if (buffered_cylinder != -2)
+ // read in one buffered track if we don't already have it
+ if (buffered_cylinder != cyl || buffered_head != head)
     {
-     // read in the track if we don't already have it buffered
-     if (buffered_cylinder != cyl || buffered_head != head)
-        dsk_err = read_buffered_track(cyl, xcyl, head, xhead);
-
-     // if the track was read in ok we are done!
-     if (dsk_err == DSK_ERR_OK)
-        return dsk_err;
+     t = profile_begin(prof);
+     read_buffered_track(cyl, xcyl, head, xhead);
+     profile_end(prof, PROFILE_TRACK, -1, t);
     }
 
- // read 1 sector into the global buffer,  we get to here if a previous
- // buffer read error occured
+ // if the sector was read in with the track we are done!
+ if (buffered_ok[lsect])
+    return DSK_ERR_OK;
+
+ // read 1 sector into the global buffer, we only get to here for sectors
+ // that failed or were not read during the buffered track read
 
  // get the skewed physical sector number
  psect = skew_table[lsect] + dg.dg_secbase;
@@ -1847,15 +2990,12 @@ static dsk_err_t read_sector_x (dsk_pcyl_t cyl, dsk_pcyl_t xcyl,
  if (xdg.ssr_cb && ((*xdg.ssr_cb)(p, cyl, head, psect)))
     return DSK_ERR_OK;    
 
- // avoid dsk_xread() for types that do not support the function
- if (! input_sup.xread)
-    dsk_err = DSK_ERR_NOTIMPL;
- else
-    dsk_err = dsk_xread(idrive, &dg, p, cyl, head, xcyl, xhead, psect,
-    dg.dg_secsize, NULL);
- 
- if (dsk_err == DSK_ERR_NOTIMPL)
-    dsk_err = dsk_pread(idrive, &dg, p, cyl, head, psect);
+ t = profile_begin(prof);
+ dsk_err = read_sector_data(cyl, xcyl, head, xhead, psect, p);
+ profile_end(prof, PROFILE_SECTOR, -1, t);
+
+ if (dsk_err == DSK_ERR_OK)
+    buffered_ok[lsect] = 1;
  
  return dsk_err;
 }
@@ -1876,10 +3016,14 @@ static dsk_err_t read_sector (dsk_pcyl_t cyl, dsk_phead_t head,
                               dsk_phead_t xhead, int lsect)
 {
  dsk_err_t dsk_err = DSK_ERR_OK;
+ char err_str[200];
+ uint64_t t;
  int count;
  int tryx;
  
- count = disk.retries_l2;  // this is level 2 (up from LibDsk retries)
+ // this is level 2 (up from LibDsk retries), only one try if the sector
+ // can be deferred (unattended only)
+ count = (retry_pass == 1 && disk.unattended)? 1 : disk.retries_l2;
  tryx = 0;
 
  // set data rate and MFM/FM mode for input
@@ -1917,7 +3061,9 @@ static dsk_err_t read_sector (dsk_pcyl_t cyl, dsk_phead_t head,
          // use a delay or the head will try to home constantly.
          if (disk.verbose > 1)
             printf("read_sector(): sleep_ms(3000)!\n");
-         sleep_ms(3000);
+         t = profile_begin(prof);
+         sim_sleep_ms(3000);
+         profile_end(prof, PROFILE_SETTLE, -1, t);
         }
 
      if (dsk_err == DSK_ERR_OK)
@@ -1930,6 +3076,12 @@ static dsk_err_t read_sector (dsk_pcyl_t cyl, dsk_phead_t head,
      sect_retry_count++;
      sect_retries_tot++;
 
+     if (events_active())
+        event_emit("sector_retry", "\"cyl\":%d,\"head\":%d,\"sector\":%d,"
+        "\"try\":%d,\"error\":%s", cyl, head,
+        skew_table[lsect] + dg.dg_secbase, tryx,
+        event_str((char *)dsk_strerror(dsk_err), err_str, sizeof(err_str)));
+
      if (--count == 0)
         {
          printf("\n"APPNAME": read_sector() - %s\n", dsk_strerror(dsk_err));
@@ -1942,41 +3094,279 @@ static dsk_err_t read_sector (dsk_pcyl_t cyl, dsk_phead_t head,
 }
 
 //==============================================================================
-// Read a sector from the input drive using recovery methods on errors.
-//
-// In interactive mode (--unattended=off) There is a choice of 6 options
-// the operator may select when an error occurs:
+// Read a sector several times and take a byte-wise majority vote.
 //
-// 1. reTry - Will try another read but does not seek to track 0 first.
-// 2. Retry - Will seek to cylinder 0 and read a sector ID before retrying.
-//    If the cylinder is already on 0 then cylinder 9 is used instead.
-// 3. Ignore - An error is recorded and exits with no error.  The data is
-//    likely to be corrupt.
-// 4. Skip - Same as Ignore but for all remaining errors on current disk.
-// 5. Abort - An error is recorded and exits with a disk error abort value.
-// 6. Clean - Clean the drive heads using a special cleaning disk.
-// 7. Mode - Toggle between Unattended and Interactive mode.
+// Used for sectors that only read correctly after retries, such sectors may
+// be marginal and return different data on each read.  The sector already
+// read into the session buffer is the first copy, a further disk.vote - 1
+// reads are made and any that fail are not counted.  Each byte of the
+// sector buffer is set to the value most reads agree on, a tie is resolved
+// in favour of the first good read.  The agreement statistics are kept for
+// the info file.
 //
 //   pass: dsk_pcyl_t cyl               cylinder number
 //         dsk_phead_t head             physical side of disk
 //         dsk_phead_t xhead            side ID value
 //         int lsect                    logical sector number
-// return: dsk_err_t                    DSK_ERR_OK if successful
+// return: void
 //==============================================================================
-static dsk_err_t read_sector_retry (dsk_pcyl_t cyl, dsk_phead_t head,
-                                    dsk_phead_t xhead, int lsect)
+static void vote_sector (dsk_pcyl_t cyl, dsk_phead_t head,
+                         dsk_phead_t xhead, int lsect)
 {
- dsk_err_t dsk_err = DSK_ERR_OK;
- DSK_FORMAT sector_id;
+ vote_entry_t *temp;
+ vote_entry_t *v;
+ uint8_t *copies;
+ uint8_t *p;
+ uint8_t c;
+ size_t secsize = dg.dg_secsize;
+ size_t i;
+ dsk_phead_t rhead = head;
+ int psect;
+ int reads;
+ int votes;
+ int best;
+ int n;
+ int x;
+ int j;
 
- char user[100];
- sect_retry_count = 0;
- auto_retry_sector = 0;  // reset for the next sector
- 
- for (;;)
+ if (disk.vote < 2)
+    return;
+
+ if (vote_count == vote_size)
     {
-     // allow the operator to pause, resume, abort, clean and switch between
-     // unattended and interactive modes
+     temp = realloc(vote_list, sizeof(vote_entry_t) * (vote_size + 100));
+     if (! temp)
+        return;
+     vote_list = temp;
+     vote_size += 100;
+    }
+
+ psect = skew_table[lsect] + dg.dg_secbase;
+ p = buf + secsize * (psect - dg.dg_secbase);
+
+ if ((copies = malloc(secsize * disk.vote)) == NULL)
+    return;
+
+ // sectors supplied by the skip sector read call-back are not voted on
+ if (xdg.ssr_cb && ((*xdg.ssr_cb)(copies, cyl, head, psect)))
+    {
+     free(copies);
+     return;
+    }
+
+ // set data rate and MFM/FM mode for input
+ dg.dg_datarate = xdg.dg_idatarate;
+ dg.dg_fm = xdg.dg_ifm;
+
+ // same --iside work around as read_sector()
+ if (disk.iside_not_support && disk.iside != -1)
+    {
+     rhead = disk.iside;
+     xhead = disk.iside;
+    }
+
+ // the read already accepted is the first copy
+ memcpy(copies, p, secsize);
+ reads = 1;
+
+ for (n = 1; n < disk.vote; n++)
+    {
+     if (read_sector_data(cyl, cyl, rhead, xhead, psect,
+        copies + secsize * reads) == DSK_ERR_OK)
+        reads++;
+    }
+
+ v = &vote_list[vote_count++];
+ v->cyl = cyl;
+ v->head = head;
+ v->psect = psect;
+ v->reads = reads;
+ v->agree = 0;
+ v->differ = 0;
+ v->min_votes = reads;
+ v->fixed = 0;
+
+ // take the majority value for each byte
+ for (i = 0; i < secsize; i++)
+    {
+     best = 0;
+     votes = 0;
+     for (n = 0; n < reads && votes < (reads - n); n++)
+        {
+         c = copies[secsize * n + i];
+         for (x = 0, j = n; j < reads; j++)
+            if (copies[secsize * j + i] == c)
+               x++;
+         if (x > votes)
+            {
+             votes = x;
+             best = n;
+            }
+        }
+
+     if (votes < reads)
+        v->differ++;
+     if (votes < v->min_votes)
+        v->min_votes = votes;
+
+     c = copies[secsize * best + i];
+     if (p[i] != c)
+        {
+         p[i] = c;
+         v->fixed++;
+        }
+    }
+
+ for (n = 0; n < reads; n++)
+    if (memcmp(copies + secsize * n, p, secsize) == 0)
+       v->agree++;
+
+ free(copies);
+
+ if (disk.verbose && v->differ)
+    printf("\nSector vote: %d/%d reads agree, %d byte(s) differ,"
+           " %d byte(s) changed\n", v->agree, v->reads, v->differ,
+           v->fixed);
+}
+
+//==============================================================================
+// Vote on all the sectors of a flagged track.
+//
+// With --vote-mode=track every good sector of a track is voted on if any
+// sector of the track needed retries or had an error.  The sector status
+// values are taken from the info file buffer for the track just read.
+//
+//   pass: dsk_pcyl_t cyl               cylinder number
+//         dsk_phead_t head             physical side of disk
+//         dsk_phead_t xhead            side ID value
+// return: void
+//==============================================================================
+static void vote_track (dsk_pcyl_t cyl, dsk_phead_t head, dsk_phead_t xhead)
+{
+ int flagged = 0;
+ int status;
+ int lsect;
+
+ if (disk.vote < 2 || disk.vote_mode != VOTE_TRACK || info.trk == -1 ||
+     info.cyl_last != cyl || info.head_last != head)
+    return;
+
+ for (lsect = 0; lsect < dg.dg_sectors; lsect++)
+    if (info_map_get(&info.map, info.trk, skew_table[lsect]) != 0)
+       flagged = 1;
+
+ if (! flagged)
+    return;
+
+ for (lsect = 0; lsect < dg.dg_sectors; lsect++)
+    {
+     status = info_map_get(&info.map, info.trk, skew_table[lsect]);
+     if (status >= 0 && status < INFO_ERROR)
+        vote_sector(cyl, head, xhead, lsect);
+    }
+}
+
+//==============================================================================
+// Add a failed sector to the deferred retry queue.
+//
+//   pass: dsk_pcyl_t cyl               cylinder number
+//         dsk_phead_t head             physical side of disk
+//         dsk_phead_t xhead            side ID value
+//         int lsect                    logical sector number
+// return: int                          0 if queued, else -1
+//==============================================================================
+static int retry_queue_add (dsk_pcyl_t cyl, dsk_phead_t head,
+                            dsk_phead_t xhead, int lsect)
+{
+ retry_entry_t *temp;
+ retry_entry_t *r;
+
+ if (retry_queue_count == retry_queue_size)
+    {
+     temp = realloc(retry_queue, sizeof(retry_entry_t) *
+     (retry_queue_size + 100));
+     if (! temp)
+        return -1;
+     retry_queue = temp;
+     retry_queue_size += 100;
+    }
+
+ r = &retry_queue[retry_queue_count++];
+ r->cyl = cyl;
+ r->head = head;
+ r->xhead = xhead;
+ r->lsect = lsect;
+ r->sectors = dg.dg_sectors;
+ r->secbase = dg.dg_secbase;
+ r->secsize = dg.dg_secsize;
+ r->info_trk = -1;
+ r->info_sec = -1;
+
+ // the info map position is filled in by info_file_entry()
+ retry_queued = 1;
+
+ return 0;
+}
+
+//==============================================================================
+// Compare function for sorting the deferred retry queue.
+//
+// The head finishes the first pass on the last cylinder so the queue is
+// worked back from there to the first.
+//
+//   pass: const void *a
+//         const void *b
+// return: int                          sort order
+//==============================================================================
+static int retry_queue_cmp (const void *a, const void *b)
+{
+ const retry_entry_t *ra = a;
+ const retry_entry_t *rb = b;
+
+ if (ra->cyl != rb->cyl)
+    return (ra->cyl > rb->cyl)? -1 : 1;
+ if (ra->head != rb->head)
+    return (ra->head < rb->head)? -1 : 1;
+ return ra->lsect - rb->lsect;
+}
+
+//==============================================================================
+// Read a sector from the input drive using recovery methods on errors.
+//
+// In interactive mode (--unattended=off) There is a choice of 6 options
+// the operator may select when an error occurs:
+//
+// 1. reTry - Will try another read but does not seek to track 0 first.
+// 2. Retry - Will seek to cylinder 0 and read a sector ID before retrying.
+//    If the cylinder is already on 0 then cylinder 9 is used instead.
+// 3. Ignore - An error is recorded and exits with no error.  The data is
+//    likely to be corrupt.
+// 4. Skip - Same as Ignore but for all remaining errors on current disk.
+// 5. Abort - An error is recorded and exits with a disk error abort value.
+// 6. Clean - Clean the drive heads using a special cleaning disk.
+// 7. Mode - Toggle between Unattended and Interactive mode.
+//
+//   pass: dsk_pcyl_t cyl               cylinder number
+//         dsk_phead_t head             physical side of disk
+//         dsk_phead_t xhead            side ID value
+//         int lsect                    logical sector number
+// return: dsk_err_t                    DSK_ERR_OK if successful
+//==============================================================================
+static dsk_err_t read_sector_retry (dsk_pcyl_t cyl, dsk_phead_t head,
+                                    dsk_phead_t xhead, int lsect)
+{
+ dsk_err_t dsk_err = DSK_ERR_OK;
+ DSK_FORMAT sector_id;
+ uint64_t t;
+
+ char user[100];
+ sect_retry_count = 0;
+ auto_retry_sector = 0;  // reset for the next sector
+ 
+ for (;;)
+    {
+     // allow the operator to pause, resume, abort, clean and switch between
+     // unattended and interactive modes
      if (pause_menu(0, cyl) == DSK_ERR_ABORT)
         {
          sect_retry_count = -2;
@@ -1985,27 +3375,43 @@ static dsk_err_t read_sector_retry (dsk_pcyl_t cyl, dsk_phead_t head,
      
      dsk_err = DSK_ERR_OK;
      
-     if (disk.verbose)
-        {
-         printf("\rCylinder: %02d/%02d Head: %d/%d"
-                " Sector: (log) %03d/%03d, (phy) %03d/%03d",
-                cyl, dg.dg_cylinders - 1, head, dg.dg_heads - 1,
-                lsect, dg.dg_sectors - 1,
-                skew_table[lsect] + dg.dg_secbase,
-                dg.dg_sectors + dg.dg_secbase - 1);
-         fflush(stdout);
-        }
+     progress_sector(cyl, head, lsect);
 
      dsk_err = read_sector(cyl, head, xhead, lsect);
 
+     // the progress is brought up to date before any error messages
      if (disk.verbose)
         {
          if (dsk_err != DSK_ERR_OK)
-            printf("\n");
+            {
+             progress_show();
+             printf("\n");
+            }
         }    
 
      if (dsk_err == DSK_ERR_OK)
-        return dsk_err;
+        {
+         progress.sectors++;
+         progress.bytes += dg.dg_secsize;
+
+         // a sector that needed retries is read again and voted on, whole
+         // tracks are voted on by vote_track() after the track is read
+         if (sect_retry_count > 0 &&
+            (disk.vote_mode == VOTE_RETRIED || retry_pass == 2))
+            vote_sector(cyl, head, xhead, lsect);
+         return dsk_err;
+        }
+
+     // the first pass of a deferred copy queues the sector to be retried
+     // after the rest of the disk has been read
+     if (retry_pass == 1 && disk.unattended &&
+         retry_queue_add(cyl, head, xhead, lsect) == 0)
+        {
+         if (disk.verbose)
+            printf("Sector deferred for retrying later.\n");
+         sect_retry_count = -1;
+         return DSK_ERR_OK;
+        }
 
      if (disk.unattended)
         {
@@ -2121,14 +3527,17 @@ static dsk_err_t read_sector_retry (dsk_pcyl_t cyl, dsk_phead_t head,
          case 'R' : // retry after moving the head first
             // Need to do the following if drive door was opened
             // when trying to read on some drives.
+            t = profile_begin(prof);
             home_and_reset_input_drive_and_settings(&sector_id);
 
             // if we were on track 0 we move the head to T1 first
             // then back again.
-            if (cyl != 0)
-               break;
-            dsk_psecid(idrive, &dg, 1, 0, &sector_id);
-            dsk_psecid(idrive, &dg, 0, 0, &sector_id);
+            if (cyl == 0)
+               {
+                sim_psecid(idrive, &dg, 1, 0, &sector_id);
+                sim_psecid(idrive, &dg, 0, 0, &sector_id);
+               }
+            profile_end(prof, PROFILE_SEEK, -1, t);
             break;
          case 'S' : // All future errors for this disk will be ignored.
             // First time we fall through to case 'I'.
@@ -2139,7 +3548,9 @@ static dsk_err_t read_sector_retry (dsk_pcyl_t cyl, dsk_phead_t head,
                     
             // Need to do the following if drive door was opened
             // when trying to read on some drives.
+            t = profile_begin(prof);
             home_and_reset_input_drive_and_settings(&sector_id);
+            profile_end(prof, PROFILE_SEEK, -1, t);
             return DSK_ERR_OK;    
          case 'A' : // abort the copy with an error
             sect_errors_tot++;
@@ -2162,8 +3573,207 @@ static void init_info_file (void)
 {
  info.cyl_last = -1;
  info.head_last = -1;
- info.pos_trk = 0;
- info.buf[0] = -1;
+ info.trk = -1;
+ info_map_clear(&info.map);
+}
+
+//==============================================================================
+// Create a structured info sidecar file.
+//
+// The sidecar holds the same information as the 'info' file in JSON or CBOR
+// form for cataloguing programs.  The sector status map has one entry per
+// track with the raw status values in physical sector order (0 read first
+// time, 1-250 retries needed, 1000 error and 1001 not read).  The error log
+// is included if one was created.
+//
+//   pass: int fmt                      SIDECAR_* value
+//         hash_res_t *hres             output digests
+//         char *created                ISO 8601 creation date and time
+// return: int                          0 if no error else -1
+//==============================================================================
+static int create_info_sidecar (int fmt, hash_res_t *hres, char *created)
+{
+ sidecar_t sc;
+ info_track_t *tp;
+
+ char sidecar_file[1000];
+ char temp_str[1000];
+ char inpf[1000];
+ char outf[1000];
+
+ int *status;
+ int i;
+ int x;
+
+ if (snprintf(sidecar_file, sizeof(sidecar_file), "%s.info.%s", ofile_name,
+ sidecar_ext(fmt)) >= (int)sizeof(sidecar_file))
+    {
+     printf(APPNAME": info file name is too long for: %s\n", ofile_name);
+     return -1;
+    }
+
+ if (sidecar_open(&sc, sidecar_file, fmt) == -1)
+    {
+     printf(APPNAME": unable to create info file: %s\n", sidecar_file);
+     return -1;
+    }
+
+ file_name_part(disk.ifile, inpf);
+ file_name_part(ofile_name, outf);
+
+ sidecar_map(&sc, NULL);
+ sidecar_int(&sc, "info_version", 1);
+
+ sidecar_map(&sc, "image");
+ sidecar_str(&sc, "file", outf);
+ sidecar_map(&sc, "digests");
+ for (i = 0; i < HASH_COUNT; i++)
+    if (disk.hash & HASH_BIT(i))
+       sidecar_str(&sc, hash_name(i), hres->digest[i]);
+ sidecar_end(&sc);
+ sidecar_str(&sc, "disk_name", xdg.dg_format_name);
+ sidecar_str(&sc, "disk_name_desc", xdg.dg_format_desc);
+ sidecar_str(&sc, "archived_by", disk.signature);
+ sidecar_str(&sc, "created", created);
+ sidecar_end(&sc);
+
+ sidecar_array(&sc, "description");
+ for (i = 0; description[i][0] && strcmp(".\n", description[i]) != 0; i++)
+    {
+     strcpy(temp_str, description[i]);
+     x = strlen(temp_str);
+     if (x && temp_str[x-1] == '\n')
+        temp_str[x-1] = 0;
+     sidecar_str(&sc, NULL, temp_str);
+    }
+ sidecar_end(&sc);
+
+ sidecar_map(&sc, "parameters");
+ sidecar_str(&sc, "program", TITLESTRING);
+ sidecar_str(&sc, "detection", detect_disk_args[disk.detect]);
+ sidecar_str(&sc, "disk_format", disk.format);
+ sidecar_str(&sc, "input_file", inpf);
+ sidecar_str(&sc, "input_type", disk.itype);
+ sidecar_str(&sc, "output_type", disk.otype);
+ sidecar_bool(&sc, "input_dstep", disk.idstep_used);
+ sidecar_bool(&sc, "output_dstep", disk.odstep_used);
+ sidecar_str(&sc, "input_side", sides[disk.iside+1]);
+ sidecar_str(&sc, "output_side", sides[disk.oside+1]);
+ sidecar_int(&sc, "start_cylinder", cyl_start);
+ sidecar_int(&sc, "finish_cylinder", cyl_finish);
+ sidecar_int(&sc, "start_track", trk_start);
+ sidecar_int(&sc, "finish_track", trk_finish);
+ sidecar_str(&sc, "force_side", forceside_values[disk.forceside]);
+ sidecar_str(&sc, "input_comp", disk.incomp);
+ sidecar_str(&sc, "output_comp", disk.outcomp);
+ sidecar_int(&sc, "retries_l1", disk.retries_l1);
+ sidecar_int(&sc, "retries_l2", disk.retries_l2);
+ sidecar_int(&sc, "log_level", disk.log);
+ sidecar_str(&sc, "input_datarate", datarates_str[xdg.dg_idatarate]);
+ sidecar_str(&sc, "output_datarate", datarates_str[xdg.dg_odatarate]);
+ sidecar_end(&sc);
+
+ sidecar_map(&sc, "unattended");
+ sidecar_bool(&sc, "used", disk.unattended);
+ sidecar_int(&sc, "retry_abort_max", disk.unattended_retry_abort_max);
+ sidecar_int(&sc, "retry_sector_max", disk.unattended_retry_sector_max);
+ sidecar_int(&sc, "seeks_max", disk.unattended_seeked_max);
+ sidecar_end(&sc);
+
+ sidecar_map(&sc, "physical");
+ if ((x = string_struct_search_i(drive_args, disk.idrive_type)) == -1)
+    x = 0;
+ sidecar_str(&sc, "input_drive_type", drive_args[x].name);
+ if ((x = string_struct_search_i(drive_args, disk.odrive_type)) == -1)
+    x = 0;
+ sidecar_str(&sc, "output_drive_type", drive_args[x].name);
+ sidecar_str(&sc, "sidedness", sidedness[dg.dg_sidedness]);
+ sidecar_str(&sc, "datarate", datarates_str[xdg.dg_odatarate]);
+ sidecar_int(&sc, "cylinders", dg.dg_cylinders);
+ sidecar_int(&sc, "heads", dg.dg_heads);
+ sidecar_int(&sc, "sectors", dg.dg_sectors);
+ sidecar_int(&sc, "sector_size", dg.dg_secsize);
+ sidecar_int(&sc, "secbase1", xdg.dg_secbase1s);
+ sidecar_int(&sc, "secbase2", xdg.dg_secbase2s);
+ sidecar_int(&sc, "skew", xdg.dg_skew_val);
+ sidecar_int(&sc, "skew_offset", xdg.dg_skew_ofs);
+ sidecar_end(&sc);
+
+ sidecar_map(&sc, "results");
+ sidecar_int(&sc, "sector_errors", sect_errors_tot);
+ sidecar_int(&sc, "sector_retries", sect_retries_tot);
+ if (disk.vote)
+    {
+     for (i = 0, x = 0; i < vote_count; i++)
+        if (vote_list[i].differ)
+           x++;
+     sidecar_int(&sc, "sectors_voted", vote_count);
+     sidecar_int(&sc, "sectors_unstable", x);
+    }
+ sidecar_end(&sc);
+
+ // the sector status map, one entry for each track
+ sidecar_array(&sc, "tracks");
+ for (i = 0; i < info.map.count; i++)
+    {
+     tp = &info.map.tracks[i];
+     sidecar_map(&sc, NULL);
+     sidecar_int(&sc, "cyl", tp->cyl);
+     sidecar_int(&sc, "head", tp->head);
+     sidecar_int(&sc, "secbase", tp->secbase);
+     sidecar_int(&sc, "secsize", tp->secsize);
+     sidecar_array(&sc, "status");
+     if ((status = malloc(sizeof(int) * (tp->sectors + 1))) != NULL &&
+        info_map_track(&info.map, i, status) == 0)
+        for (x = 0; x < tp->sectors; x++)
+           sidecar_int(&sc, NULL, status[x]);
+     free(status);
+     sidecar_end(&sc);
+     sidecar_end(&sc);
+    }
+ sidecar_end(&sc);
+
+ if (vote_count)
+    {
+     sidecar_array(&sc, "votes");
+     for (i = 0; i < vote_count; i++)
+        {
+         sidecar_map(&sc, NULL);
+         sidecar_int(&sc, "cyl", vote_list[i].cyl);
+         sidecar_int(&sc, "head", vote_list[i].head);
+         sidecar_int(&sc, "sector", vote_list[i].psect);
+         sidecar_int(&sc, "reads", vote_list[i].reads);
+         sidecar_int(&sc, "agree", vote_list[i].agree);
+         sidecar_int(&sc, "differ", vote_list[i].differ);
+         sidecar_int(&sc, "min", vote_list[i].min_votes);
+         sidecar_int(&sc, "changed", vote_list[i].fixed);
+         sidecar_end(&sc);
+        }
+     sidecar_end(&sc);
+    }
+
+ if (errorf)
+    {
+     sidecar_array(&sc, "error_log");
+     rewind(errorf);
+     while (fgets(temp_str, sizeof(temp_str)-1, errorf))
+        {
+         x = strlen(temp_str);
+         if (x && temp_str[x-1] == '\n')
+            temp_str[x-1] = 0;
+         sidecar_str(&sc, NULL, temp_str);
+        }
+     fseek(errorf, 0, SEEK_END);
+     sidecar_end(&sc);
+    }
+
+ if (sidecar_close(&sc) == -1)
+    {
+     printf(APPNAME": error writing info file: %s\n", sidecar_file);
+     return -1;
+    }
+
+ return 0;
 }
 
 //==============================================================================
@@ -2190,17 +3800,6 @@ static int create_info_file (void)
   "December"
  };
 
- sup_args_t drive_args[] =
- {
-  {"disk image or unknown",   0}, 
-  {"400kb 5.25\"",          'd'},
-  {"1.2 Mb 5.25\"",         'h'},
-  {"800kb 3.5 or 5.25\"",   'D'},
-  {"1.44 Mb 3.5\"",         'H'},  
-  {"2.88 Mb",               'E'},
-  {"",                       -1}
- };
-
  typedef struct tm tm_t;
 
  time_t result;
@@ -2208,10 +3807,12 @@ static int create_info_file (void)
 
  char temp_str[100];
  char date_time[100];
+ char date_iso[100];
  
  int i;
  int x;
- int retries;
+ int *status;
+ info_track_t *tp;
 
  int secbase_last = -1;
  int sectors_last = -1;
@@ -2220,7 +3821,8 @@ static int create_info_file (void)
  char *res;
  char inpf[1000];
  char outf[1000];
- char md5[33];
+ hash_res_t hres;
+ uint64_t t;
 
  char info_file[1000];
  
@@ -2253,9 +3855,18 @@ static int create_info_file (void)
  sprintf(date_time, "%d %s %d  %02d:%02d:%02d", resultp.tm_mday,
  month_names[resultp.tm_mon],
  resultp.tm_year+1900, resultp.tm_hour, resultp.tm_min, resultp.tm_sec);
+ sprintf(date_iso, "%04d-%02d-%02dT%02d:%02d:%02d", resultp.tm_year+1900,
+ resultp.tm_mon+1, resultp.tm_mday, resultp.tm_hour, resultp.tm_min,
+ resultp.tm_sec);
  
- // compute an MD5 for the image created
- create_md5(ofile_name, md5);
+ // use the digests computed while the image was written, otherwise compute
+ // them for the image created
+ if (out_hash_result(&hres) != 0)
+    {
+     t = profile_begin(prof);
+     hash_file((*output_temp)? output_temp : ofile_name, disk.hash, &hres);
+     profile_end(prof, PROFILE_HASH, -1, t);
+    }
  
  // extract the file names from the paths
  file_name_part(disk.ifile, inpf);
@@ -2264,7 +3875,10 @@ static int create_info_file (void)
  fprintf(infof, "DISK/IMAGE INFORMATION\n");
  fprintf(infof, "----------------------\n");
  fprintf(infof, "File output        %s\n", outf);
- fprintf(infof, "File output MD5    %s\n", md5);
+ for (i = 0; i < HASH_COUNT; i++)
+    if (disk.hash & HASH_BIT(i))
+       fprintf(infof, "File output %-6s %s\n", hash_labels[i],
+       hres.digest[i]);
  fprintf(infof, "Disk name          %s\n", xdg.dg_format_name);
  fprintf(infof, "Disk name desc     %s\n", xdg.dg_format_desc);
  fprintf(infof, "Archived by        %s\n", disk.signature);
@@ -2348,6 +3962,14 @@ static int create_info_file (void)
  fprintf(infof, "-----------------\n");
  fprintf(infof, "Sector errors      %d\n", sect_errors_tot);
  fprintf(infof, "Sector retries     %d\n", sect_retries_tot);     
+ if (disk.vote)
+    {
+     for (i = 0, x = 0; i < vote_count; i++)
+        if (vote_list[i].differ)
+           x++;
+     fprintf(infof, "Sectors voted      %d\n", vote_count);
+     fprintf(infof, "Sectors unstable   %d\n", x);
+    }
 
  fprintf(infof, "\n");
  fprintf(infof, "SECTOR STATUS MAP\n");
@@ -2356,55 +3978,91 @@ static int create_info_file (void)
  fprintf(infof,
 "A sector position containing a '.' indicates the sector read correctly first\n"
 "time. An 'X' indicates the sector was not read (terminated early). An 'ERR'\n"
-"indicates the sector had a read error and a value from '1-999' indicates the\n"
+"indicates the sector had a read error and a value from '1-250' indicates the\n"
 "number of level 2 retries that were needed to successfully read the sector."
 "\n\n");
 
- i = 0;
- while (info.buf[i] != -1)
+ // encode the last track so the whole map is read the same way
+ info_map_close(&info.map);
+
+ for (i = 0; i < info.map.count; i++)
     {
-     if (info.buf[i] != secbase_last || info.buf[i+1] != sectors_last ||
-         info.buf[i+2] != secsize_last)
+     tp = &info.map.tracks[i];
+     if (tp->secbase != secbase_last || tp->sectors != sectors_last ||
+         tp->secsize != secsize_last)
         {
-         secbase_last = info.buf[i];
-         sectors_last = info.buf[i+1];
-         secsize_last = info.buf[i+2];
+         secbase_last = tp->secbase;
+         sectors_last = tp->sectors;
+         secsize_last = tp->secsize;
          sprintf(temp_str, "(%dx%d)", sectors_last, secsize_last);
          fprintf(infof, "Cylinder  Head%11s  ", temp_str);
          for (x = 0; x < sectors_last; x++)
             fprintf(infof, "%03d ", secbase_last + x);
          fprintf(infof, "\n");
         } 
-     i += 3;
-     fprintf(infof, "%4d       %d               ", info.buf[i], info.buf[i+1]);
-     i += 2;
+     fprintf(infof, "%4d       %d               ", tp->cyl, tp->head);
+     if ((status = malloc(sizeof(int) * (tp->sectors + 1))) == NULL ||
+        info_map_track(&info.map, i, status) == -1)
+        {
+         free(status);
+         fprintf(infof, "(out of memory)\n");
+         continue;
+        }
      for (x = 0; x < sectors_last; x++)
         {
-         switch (info.buf[i])
+         switch (status[x])
             {
              case 0 : // sector is marked as good
                 fprintf(infof, " .  ");
-                i++;    
                 break;
-             case 1000 : // sector is marked as bad
+             case INFO_ERROR : // sector is marked as bad
                 fprintf(infof, "ERR ");
-                i++;   
                 break;
-             case 1001 : // sector was not read (aborted)
+             case INFO_NOTREAD : // sector was not read (aborted)
                 fprintf(infof, " X  ");
-                i++;
                 break;
              default : // sector is good but required some retries
-                retries = info.buf[i];
-                if (retries > 255)
-                   retries = 255;
-                fprintf(infof, "%3d ", retries);
-                i++;    
+                fprintf(infof, "%3d ", status[x]);
             } 
         }
+     free(status);
      fprintf(infof, "\n");                
     }
 
+ // list the agreement of the sectors that were voted on
+ if (vote_count)
+    {
+     fprintf(infof, "\n");
+     fprintf(infof, "SECTOR VOTING\n");
+     fprintf(infof, "-------------\n");
+     fprintf(infof,
+"Each sector listed was read up to %d times and a byte-wise majority vote\n"
+"taken.  'Agree' is the number of good reads identical to the voted data,\n"
+"'Differ' the number of bytes the reads did not all agree on, 'Min' the\n"
+"smallest majority for any byte and 'Changed' the number of bytes altered\n"
+"from the first good read.\n\n", disk.vote);
+     fprintf(infof, "Cylinder  Head  Sector  Reads  Agree  Differ  Min"
+                    "  Changed\n");
+     for (i = 0; i < vote_count; i++)
+        fprintf(infof, "%4d       %d     %03d    %3d    %3d   %5d  %3d"
+                       "    %5d\n", vote_list[i].cyl, vote_list[i].head,
+        vote_list[i].psect, vote_list[i].reads, vote_list[i].agree,
+        vote_list[i].differ, vote_list[i].min_votes, vote_list[i].fixed);
+    }
+
+ // where the time went (--profile)
+ if (prof)
+    {
+     profile_stop(prof);
+     fprintf(infof, "\n");
+     profile_report(prof, infof);
+    }
+
+ // structured sidecar files for cataloguing programs
+ for (i = 0; i < SIDECAR_COUNT; i++)
+    if (disk.sidecar & SIDECAR_BIT(i))
+       create_info_sidecar(i, &hres, date_iso);
+
  // append or close the error log file if one was created
  if (errorf)
     {
@@ -2431,12 +4089,11 @@ static int create_info_file (void)
 }
 
 //==============================================================================
-// Place a sector read result into the info file buffer.
+// Place a sector read result into the info map.
 //
-// The status of sector reads is placed in the table in the physical sector
-// locations.  All sectors for each new track are filled with -1 to indicate
-// a sector that has not been read and a -1 end marker inserted for the next
-// track to indicate end of info.
+// The status of sector reads is placed in the map in the physical sector
+// locations.  A new track is added to the map when the cylinder or head
+// changes with all its sectors set to 'not read'.
 //
 //   pass: dsk_pcyl_t cyl               cylinder number
 //         dsk_phead_t head             physical side of disk
@@ -2446,50 +4103,49 @@ static int create_info_file (void)
 static void info_file_entry (dsk_pcyl_t cyl, dsk_phead_t head, int lsect)
 {
  int i;
+ int status;
+ int queued;
  
- if ((info.pos_trk + 10) > INFO_SIZE)
-    return;
-
  if (cyl != info.cyl_last || head != info.head_last)
     {
-     info.buf[info.pos_trk++] = dg.dg_secbase;
-     info.buf[info.pos_trk++] = dg.dg_sectors;
-     info.buf[info.pos_trk++] = dg.dg_secsize;
-     info.buf[info.pos_trk++] = cyl;
-     info.buf[info.pos_trk++] = head;
-
-     // sectors for this track will be inserted here
-     info.pos_sec = info.pos_trk;
-
-     // the next track index
-     info.pos_trk += dg.dg_sectors;
-     
-     // set all sectors in this track with 'not read' status values
-     for (i = 0; i < dg.dg_sectors; i++)
-        info.buf[info.pos_sec + 1] = -2;
-        
-     // mark the next track as not used (end marker)
-     info.buf[info.pos_trk] = -1;
-     
+     info.trk = info_map_add(&info.map, cyl, head, dg.dg_secbase,
+                             dg.dg_sectors, dg.dg_secsize);
      info.cyl_last = cyl;
      info.head_last = head;
     }
 
- // offset index for the physical sector to be inserted
- i = info.pos_sec + skew_table[lsect];
+ if (info.trk == -1)
+    return;
+
+ // physical sector to be set
+ i = skew_table[lsect];
 
- // set the status of the last sector read 
+ // a deferred sector has it's status updated when it is retried
+ queued = retry_queued;
+ if (retry_queued)
+    {
+     retry_queue[retry_queue_count - 1].info_trk = info.trk;
+     retry_queue[retry_queue_count - 1].info_sec = i;
+     retry_queued = 0;
+    }
+
+ // set the status of the last sector read
  if (sect_retry_count == -1) // sector read error?
-    info.buf[i] = 1000;  
+    {
+     status = INFO_ERROR;
+     if (! queued)
+        event_sector_error(cyl, head, i + dg.dg_secbase);
+    }
  else
      if (sect_retry_count == -2) // unread sector?
-        info.buf[i] = 1001;
+        status = INFO_NOTREAD;
      else  // else set the retry count
-        info.buf[i] = sect_retry_count;
+        status = sect_retry_count;
+
+ info_map_set(&info.map, info.trk, i, status);
 
 #if 0
- printf(" - info.pos_trk=%d, info.pos_sec=%d i=%d\n",
-        info.pos_trk, info.pos_sec, i);
+ printf(" - info.trk=%d i=%d\n", info.trk, i);
 #endif
 }
 
@@ -2510,12 +4166,48 @@ void close_files (void)
      idrive = NULL;
     } 
 
+ close_output_files();
+}
+
+//==============================================================================
+// Close the output libdsk file.
+//
+// The input drive is left open, this is used by --autodisk so the drive
+// does not need to be opened again for the next disk.  If an output image
+// created in a temporary file can't be copied to the output the temporary
+// file is kept.
+//
+//   pass: void
+// return: int                          0 if no error, else -1
+//==============================================================================
+static int close_output_files (void)
+{
+ dsk_err_t dsk_err = DSK_ERR_OK;
+ int res = 0;
+
  if (odrive)
     {
      if (dsk_close(&odrive) != DSK_ERR_OK)
         printf(APPNAME": dsk_close(&odrive) - %s\n", dsk_strerror(dsk_err));
      odrive = NULL;
     } 
+
+ // copy an output image created in a temporary file to the output
+ if (*output_temp)
+    {
+     if (copy_file(output_temp, ofile_name,
+        (size_t)disk.obuffer * 1048576, 0) == -1)
+        {
+         printf(APPNAME": unable to copy '%s' to '%s', the image has been"
+                " kept in '%s'\n", output_temp, ofile_name, output_temp);
+         res = -1;
+        }
+     else
+        remove(output_temp);
+     *output_temp = 0;
+    }
+
+ return res;
 }
 
 //==============================================================================
@@ -2802,6 +4494,11 @@ dsk_err_t override_values (void)
  if (dg_opts.skew_ofs != -1)
     xdg.dg_skew_ofs = dg_opts.skew_ofs;
 
+ // calibrated skew values for the input drive (--disk=calibrate)
+ if (disk.skewprof && idrive && dg_opts.skew_val == -1 &&
+     dg_opts.skew_ofs == -1)
+    skew_profile_apply();
+
  // set special flags
  if (dg_opts.special != -1)
     xdg.dg_special = dg_opts.special;
@@ -3060,15 +4757,35 @@ static int open_input_drive (void)
 
  //printf("disk.ifile=%s disk.itype=%s\n", disk.ifile, disk.itype);
 
- dsk_err = dsk_open(&idrive, disk.ifile, disk.itype, incomp);
+ sim_detach();
 
- if (dsk_err != DSK_ERR_OK)
+ // a simulated drive reads the input image through the drive profile
+ if (! strcmp(disk.itype, "sim"))
     {
-     printf(APPNAME": open_input_drive() - %s\n", dsk_strerror(dsk_err));
-     return -1;
+     if (sim_open(&idrive, disk.ifile, disk.sim, incomp) != 0)
+        return -1;
+     profile_set_offset(sim_delay_ns);
+    }
+ else
+ // the input drive calls are replayed from a trace
+ if (! strcmp(disk.itype, "replay"))
+    {
+     if (sim_replay_open(&idrive) != 0)
+        return -1;
+     profile_set_offset(sim_delay_ns);
     }
+ else
+    {
+     dsk_err = dsk_open(&idrive, disk.ifile, disk.itype, incomp);
 
- disk.idrive_type = get_drive_type(disk.itype, disk.ifile, idrive);
+     if (dsk_err != DSK_ERR_OK)
+        {
+         printf(APPNAME": open_input_drive() - %s\n", dsk_strerror(dsk_err));
+         return -1;
+        }
+    }
+
+ disk.idrive_type = get_drive_type(disk.itype, disk.ifile, idrive);
  if (disk.verbose > 1)
     printf("Input drive type: %c (char) %d (dec)\n",
            disk.idrive_type, disk.idrive_type);
@@ -3104,12 +4821,41 @@ static int create_output_drive (void)
     outcomp = NULL;
  
  reset_drive(disk.otype, ofile_name);
- 
- dsk_err = dsk_creat(&odrive, ofile_name, disk.otype, outcomp);
+
+ *output_temp = 0;
+#ifndef WIN32
+ // with output buffering an image type that can't be written directly is
+ // created in a temporary file and copied to the output when closed
+ if (disk.obuffer && string_search(no_info_file, disk.otype) == -1 &&
+    ! raw_output_possible() && ! checkpoint_possible())
+    {
+     char *tmpdir = getenv("TMPDIR");
+     int fd;
+
+     snprintf(output_temp, sizeof(output_temp), "%s/ubeedisk-XXXXXX",
+     (tmpdir && *tmpdir)? tmpdir : "/tmp");
+     if ((fd = mkstemp(output_temp)) == -1)
+        *output_temp = 0;
+     else
+        close(fd);
+    }
+#endif
+
+ if (*output_temp)
+    dsk_err = dsk_creat(&odrive, output_temp, disk.otype, outcomp);
+ else if (ckpt_resume)
+    dsk_err = dsk_open(&odrive, ofile_name, disk.otype, outcomp);
+ else
+    dsk_err = dsk_creat(&odrive, ofile_name, disk.otype, outcomp);
 
  if (dsk_err != DSK_ERR_OK)
     {
      printf(APPNAME": create_output_drive() - %s\n", dsk_strerror(dsk_err));
+     if (*output_temp)
+        {
+         remove(output_temp);
+         *output_temp = 0;
+        }
      return -1;
     }
 
@@ -3158,6 +4904,7 @@ static int create_output_drive (void)
 // @s sector size
 // @m media descriptor byte (DOS disks only)
 // @n name of media format (i.e. ds40, ds80, applix80, dos)
+// @b base name of the input file without any path or extension
 // @@ inserts a '@' character
 //
 // Substitution command values
@@ -3196,8 +4943,10 @@ static int create_output_drive (void)
 static int output_filename_substitution (void)
 {
  char subs_ofile_name[1000];
- char temp_str[100];
+ char temp_str[1000];
  char job[100];
+ char base_name[1000];
+ char *p_ext;
  char *p = ofile_name;
  char *saved_p = NULL;
  int use_upper = 0;
@@ -3254,6 +5003,12 @@ static int output_filename_substitution (void)
              case 'n' :
                 strcpy(temp_str, xdg.dg_format_name);
                 break;
+             case 'b' :
+                file_name_part(disk.ifile, base_name);
+                if ((p_ext = strrchr(base_name, '.')))
+                   *p_ext = 0;
+                snprintf(temp_str, sizeof(temp_str), "%s", base_name);
+                break;
              case '0' :
                 if (disk.mediadesc != -1)
                    strcpy(job, "@h@d_@f_@cx@tx@s_@m@z");
@@ -3301,6 +5056,12 @@ static int output_filename_substitution (void)
          if (use_upper)
             toupper_string(temp_str, temp_str);
 
+         if (l + strlen(temp_str) >= sizeof(subs_ofile_name))
+            {
+             printf(APPNAME": output file name is too long after"
+             " substitution: %s\n", ofile_name);
+             return -1;
+            }
          strcat(subs_ofile_name,  temp_str);
 
          l = l + strlen(temp_str);
@@ -3347,10 +5108,17 @@ static int open_output_drive (void)
      if (check_output_drive() == -1)
         return -1;
         
+     // a resumed copy continues on in the existing output
+     checkpoint_check();
+
      // check if destination file already exists and what to do
-     disk.overwrite = overwrite_permission((disk.count < 0)? 1:2, ofile_name);
-     if (disk.overwrite != 1)
-        return -1;
+     if (! ckpt_resume)
+        {
+         disk.overwrite = overwrite_permission((disk.count < 0)? 1:2,
+         ofile_name);
+         if (disk.overwrite != 1)
+            return -1;
+        }
 
      dsk_err = create_output_drive();
      if (dsk_err != DSK_ERR_OK)
@@ -3384,16 +5152,20 @@ static int open_drives (void)
  // set default common geometry values
  format_set("default", 0);
  
- // open an input file if one is specified
+ // open an input file if one is specified, --autodisk keeps the input
+ // drive open from the last disk
  if (*disk.ifile)
     {
      // for now just checks the input type
      if (check_input_drive() == -1)
         return -1;
     
-     dsk_err = open_input_drive();
-     if (dsk_err != DSK_ERR_OK)
-        return -1;
+     if (! idrive)
+        {
+         dsk_err = open_input_drive();
+         if (dsk_err != DSK_ERR_OK)
+            return -1;
+        }
     }     
 
  // if scanning/speed/clean then no need for any special format
@@ -3568,7 +5340,7 @@ static dsk_err_t home_and_reset_input_drive_and_settings (DSK_FORMAT *sector_id)
     printf(APPNAME": home_and_reset_input_drive_and_settings()\n");
 
  // seek to track #0
- dsk_err = dsk_psecid(idrive, &dg, 0, 0, sector_id);
+ dsk_err = sim_psecid(idrive, &dg, 0, 0, sector_id);
 
  // if not a host PC floppy then return
 #ifdef WIN32
@@ -3889,7 +5661,7 @@ static int disk_clean (int method, int cyl_last)
          done = get_key() != -1;
          if (done)
             break;
-         dsk_psecid(idrive, &dg,  cyl, 0, &result);
+         sim_psecid(idrive, &dg,  cyl, 0, &result);
          sleep_ms(100);
          cyl += 5;
         }
@@ -3905,7 +5677,7 @@ static int disk_clean (int method, int cyl_last)
          done = get_key() != -1;
          if (done)
             break;
-         dsk_psecid(idrive, &dg,  cyl, 0, &result);
+         sim_psecid(idrive, &dg,  cyl, 0, &result);
          sleep_ms(100);
          cyl -= 5;
         }
@@ -3924,7 +5696,7 @@ static int disk_clean (int method, int cyl_last)
  // place head back on the same cylinder before finishing the clean
  if (disk.verbose > 1)
     printf("Moving head back to cylinder %2d.\n", cyl_last);
- dsk_psecid(idrive, &dg,  cyl_last, 0, &result);
+ sim_psecid(idrive, &dg,  cyl_last, 0, &result);
  sleep_ms(100);
 
  printf("\nRemove the cleaning disk and REPLACE disk then press ENTER"
@@ -4104,7 +5876,7 @@ static int disk_scan (void)
         {
          // if the last read was not an error
          if (dsk_err == DSK_ERR_OK)
-            dsk_err = dsk_psecid(idrive, &dg, cyl, head, &sector_id);
+            dsk_err = sim_psecid(idrive, &dg, cyl, head, &sector_id);
          else
             // check all data rates with MFM (0) mode first then FM (1)
             for (dg.dg_fm = 0; dg.dg_fm < 2; dg.dg_fm++)
@@ -4116,7 +5888,7 @@ static int disk_scan (void)
                     printf("dr=%d drive type=%c\n", dr, disk.idrive_type);
 #endif
                     dg.dg_datarate = datarates[dr];
-                    dsk_err = dsk_psecid(idrive, &dg, cyl, head, &sector_id);
+                    dsk_err = sim_psecid(idrive, &dg, cyl, head, &sector_id);
                     if (! dsk_err)
                        break;
                    }    
@@ -4129,7 +5901,7 @@ static int disk_scan (void)
                    "  Result: %s\n\n", cyl, head, dsk_strerror(dsk_err));
          else
             {
-             dsk_err = dsk_ptrackids(idrive, &dg, cyl, head, &count, &result);
+             dsk_err = sim_ptrackids(idrive, &dg, cyl, head, &count, &result);
 
              if (dsk_err == DSK_ERR_OK)
                 {
@@ -4292,30 +6064,30 @@ static int disk_format (void)
      switch (disk.forceside)
         {
          case 0 : // off
-            dsk_err = format_track(cyl, head,
+            dsk_err = format_track(&dg, cyl, head,
             (head & (1 ^ xdg.dg_side1as0)) + xdg.dg_sideoffs);  
             break;
          case 1 : // on
             // force side ID to be equal to the physical side
-            dsk_err = format_track(cyl, head, head);
+            dsk_err = format_track(&dg, cyl, head, head);
             break;
          case 2 : // 00
-            dsk_err = format_track(cyl, head, 0);
+            dsk_err = format_track(&dg, cyl, head, 0);
             break;
          case 3 : // 01
             if (head == 0)
-               dsk_err = format_track(cyl, head, 0);
+               dsk_err = format_track(&dg, cyl, head, 0);
             else
-               dsk_err = format_track(cyl, head, 1);
+               dsk_err = format_track(&dg, cyl, head, 1);
             break;
          case 4 : // 10
             if (head == 0)
-               dsk_err = format_track(cyl, head, 1);
+               dsk_err = format_track(&dg, cyl, head, 1);
             else
-               dsk_err = format_track(cyl, head, 0);
+               dsk_err = format_track(&dg, cyl, head, 0);
             break;
          case 5 : // 11
-            dsk_err = format_track(cyl, head, 1);
+            dsk_err = format_track(&dg, cyl, head, 1);
             break;
         }
 
@@ -4422,7 +6194,7 @@ static int disk_speed (void)
  dg.dg_heads = 255;
  dg.dg_noskip = 1;
  dg.dg_datarate = datarates[0];
- dsk_err = dsk_psecid(idrive, &dg, 0, 0, &sector_id);
+ dsk_err = sim_psecid(idrive, &dg, 0, 0, &sector_id);
 
  // must close and reopen the input drive and restore settings if error.
  if (dsk_err != DSK_ERR_OK)
@@ -4439,7 +6211,7 @@ static int disk_speed (void)
      for (dr = 0; dr < 4; ++dr)
         {
          dg.dg_datarate = datarates[dr];
-         dsk_err = dsk_psecid(idrive, &dg, cyl, head, &sector_id);
+         dsk_err = sim_psecid(idrive, &dg, cyl, head, &sector_id);
          if (! dsk_err)
             break;
         }       
@@ -4457,7 +6229,7 @@ static int disk_speed (void)
      return -1;
     }
 
- dsk_err = dsk_ptrackids(idrive, &dg, cyl, head, &count, &result);
+ dsk_err = sim_ptrackids(idrive, &dg, cyl, head, &count, &result);
 
  if (dsk_err)
     {
@@ -4490,24 +6262,24 @@ static int disk_speed (void)
      // get the first occurrence of the sector
      for (;;)
         {
-         dsk_err = dsk_psecid(idrive, &dg, cyl, head, &sector_id);
+         dsk_err = sim_psecid(idrive, &dg, cyl, head, &sector_id);
          if (psect == sector_id.fmt_sector || dsk_err != DSK_ERR_OK)
             break;
         }    
-     ms_start = time_get_ms();
+     ms_start = sim_time_ms();
 
      // read in the same sector 5 ot 6 times depending on the drive type
      for (i = 0; i < 5; i++)
         {
          for (;;)
             {
-             dsk_err = dsk_psecid(idrive, &dg, cyl, head, &sector_id);
+             dsk_err = sim_psecid(idrive, &dg, cyl, head, &sector_id);
              if (psect == sector_id.fmt_sector || dsk_err != DSK_ERR_OK)
                 break;
             }
          }   
 
-     ms_finish = time_get_ms();
+     ms_finish = sim_time_ms();
      ms_total = ms_finish - ms_start;
 
      // add 0.5 to round the result up
@@ -4522,269 +6294,3217 @@ static int disk_speed (void)
 }
 
 //==============================================================================
-// Copy one disk/image(s).
+// Run one operation of a --disk=bench helper microbenchmark.
 //
-// Retries (3 levels) - An explanation of how the 3 levels of retries works
-// is provided here:
+//   pass: int helper                   BENCH_* value
+//         DSK_FORMAT *format           format structure for 1 track
+//         uint8_t *buf                 BENCH_BLOCK bytes of data
+//         struct md5_ctx *ctx
+// return: int                          0 if no error, else -1
+//==============================================================================
+static int bench_helper_op (int helper, DSK_FORMAT *format, uint8_t *buf,
+                            struct md5_ctx *ctx)
+{
+ fdc_format_data_t *p;
+
+ switch (helper)
+    {
+     case BENCH_SKEW :
+        // force the table to be created again each time
+        skew_table_val = -1;
+        return create_skew_table(xdg.dg_skew_val, xdg.dg_skew_ofs,
+        dg.dg_sectors);
+     case BENCH_FORMAT :
+        return set_format_struct(&dg, 1 % dg.dg_cylinders, 0, 0, format);
+     case BENCH_TRACK_SIZE :
+        p = (dg.dg_fm == 1) ? (fdc_format_data_t *)ibm_3740 :
+        (fdc_format_data_t *)ibm_system_34;
+        return (format_track_size(p, format, dg.dg_fmtgap, dg.dg_sectors) ==
+        -1)? -1 : 0;
+     case BENCH_MD5 :
+        md5_process_block(buf, BENCH_BLOCK, ctx);
+        return 0;
+    }
+
+ return -1;
+}
+
+//==============================================================================
+// Run a --disk=bench helper microbenchmark.
 //
-// LibDsk (level 1)
-// ----------------
-// A LibDsk retry level is set here to help make sure there is plenty of
-// time for a sector to be read successufully at the LibDsk level.  This
-// should not be set to a too low value as it causes many soft errors and
-// possibly causes read problems on some disks (especially Microbee disks). 
-// The value can be changed using the --retry-l1 option if required.
+// The operation is repeated in doubling batches until a batch takes at
+// least BENCH_MIN_NS and the result is output as a JSON line.
 //
-// read_sector() (level 2)
-// -----------------------
-// The 2nd level of retries are performed in read_sector() which can be
-// changed using the --level-l2 option if required.  If the LibDsk retries
-// fail then this retry level comes into play.
+//   pass: int helper                   BENCH_* value
+//         char *fname                  format name or NULL
+//         DSK_FORMAT *format           format structure for 1 track
+//         uint8_t *buf                 BENCH_BLOCK bytes of data
+// return: int                          0 if no error, else -1
+//==============================================================================
+static int bench_helper (int helper, char *fname, DSK_FORMAT *format,
+                         uint8_t *buf)
+{
+ char *names[] =
+ {
+  "create_skew_table",
+  "set_format_struct",
+  "format_track_size",
+  "md5_process_block"
+ };
+
+ struct md5_ctx ctx;
+ uint64_t ops;
+ uint64_t i;
+ uint64_t t;
+ uint64_t ns;
+
+ md5_init_ctx(&ctx);
+
+ // one operation first so any set up (i.e. GAP values) is done
+ if (bench_helper_op(helper, format, buf, &ctx) == -1)
+    return -1;
+
+ for (ops = 1; ; ops *= 2)
+    {
+     t = time_get_ns();
+     for (i = 0; i < ops; i++)
+        bench_helper_op(helper, format, buf, &ctx);
+     ns = time_get_ns() - t;
+     if (ns >= BENCH_MIN_NS)
+        break;
+    }
+
+ printf("{\"bench\":\"helper\",\"name\":\"%s\"", names[helper]);
+ if (fname)
+    printf(",\"format\":\"%s\"", fname);
+ printf(",\"ops\":%llu,\"ns_op\":%.1f}\n", (unsigned long long)ops,
+ (double)ns / ops);
+
+ return 0;
+}
+
+//==============================================================================
+// Write a synthetic raw image for --disk=bench.
 //
-// read_sector_retry() (level 3)
-// -----------------------------
-// If level 2 fails to read a sector then this last level comes into play.
+// Each sector holds it's cylinder, head and sector numbers followed by
+// pseudo random data so that images are the same each time they are made
+// and don't compress away to nothing.
 //
-// If the Unattended mode is in use (default) then some more retries (with
-// and without T0 seeks), ignore or abort operations will come into play. 
-// The exact way this works depends on the count of previous errors and seek
-// counts that have already occured.
+//   pass: char *detect                 --detect value for the format
+// return: int                          0 if no error, else -1
+//==============================================================================
+static int bench_image (char *detect)
+{
+ FILE *fp;
+ uint8_t *buf;
+ uint32_t x = 0x12345678;
+ uint64_t bytes = 0;
+ int cyl;
+ int head;
+ int sect;
+ int i;
+
+ if (xdg.dg_attributes & ATTR_VAR_TRACK_SIZE)
+    {
+     printf(APPNAME": --disk=bench - format '%s' has a variable track size,"
+     " no raw image\n", disk.format);
+     return -1;
+    }
+
+ if ((buf = malloc(dg.dg_secsize)) == NULL)
+    {
+     printf(APPNAME": --disk=bench - unable to allocate memory\n");
+     return -1;
+    }
+
+ if ((fp = fopen(disk.ofile, "wb")) == NULL)
+    {
+     printf(APPNAME": --disk=bench - unable to create '%s'\n", disk.ofile);
+     free(buf);
+     return -1;
+    }
+
+ // raw images hold the tracks in logical order
+ for (cyl = 0; cyl < (int)dg.dg_cylinders; cyl++)
+    for (head = 0; head < (int)dg.dg_heads; head++)
+       for (sect = 0; sect < (int)dg.dg_sectors; sect++)
+          {
+           for (i = 0; i < (int)dg.dg_secsize; i++)
+              {
+               x ^= x << 13;
+               x ^= x >> 17;
+               x ^= x << 5;
+               buf[i] = x;
+              }
+           buf[0] = cyl;
+           buf[1] = head;
+           buf[2] = sect;
+           if (fwrite(buf, dg.dg_secsize, 1, fp) != 1)
+              {
+               printf(APPNAME": --disk=bench - unable to write '%s'\n",
+               disk.ofile);
+               fclose(fp);
+               free(buf);
+               return -1;
+              }
+           bytes += dg.dg_secsize;
+          }
+
+ fclose(fp);
+ free(buf);
+
+ printf("{\"bench\":\"image\",\"format\":\"%s\",\"detect\":\"%s\","
+ "\"bytes\":%llu}\n", xdg.dg_format_name, detect,
+ (unsigned long long)bytes);
+
+ return 0;
+}
+
+//==============================================================================
+// Benchmark process (--disk=bench).
 //
-// If interactive mode is in use then the operator has complete control and
-// makes a selection when prompted for the next course of action.
+// Runs the microbenchmarks of the helpers used for every track of a copy
+// for the --format given or all the built in formats and outputs a JSON
+// line for each.  If an output file is given a synthetic raw image of the
+// --format is written instead (see the scripts/bench/ubeedisk-bench script
+// run by 'make bench').
 //
 //   pass: void
 // return: int                          0 if no error, else -1
 //==============================================================================
-static int copy_one_disk (void)
+static int disk_bench (void)
 {
- dsk_err_t dsk_err = DSK_ERR_OK;
- DSK_FORMAT sector_id; 
+ disk_format_t *fmt;
+ DSK_FORMAT *format = NULL;
+ uint8_t *buf;
+ char *detect = NULL;
+ uint32_t x = 0x12345678;
+ int gap_set[8];
+ int res = 0;
+ int n;
+ int i;
 
- uint8_t *p;
- dsk_pcyl_t cyl;
- dsk_ltrack_t trk; 
- dsk_phead_t head; 
- int xhead;
+ // the format tables are searched here so only a single format can be set
+ if (*disk.ofile)
+    {
+     for (n = 0; (fmt = format_enum(n, &detect)) != NULL; n++)
+        if (! strcasecmp(fmt->name, disk.format))
+           break;
+     if (! fmt || format_set(disk.format, 0) == -1)
+        {
+         printf(APPNAME": --disk=bench needs a built in --format to make an"
+         " image\n");
+         return -1;
+        }
+     return bench_image(detect);
+    }
 
- char trk_str[5001]; 
- int trk_str_len;
+ if ((buf = malloc(BENCH_BLOCK)) == NULL)
+    {
+     printf(APPNAME": --disk=bench - unable to allocate memory\n");
+     return -1;
+    }
+ for (i = 0; i < BENCH_BLOCK; i++)
+    {
+     x ^= x << 13;
+     x ^= x >> 17;
+     x ^= x << 5;
+     buf[i] = x;
+    }
 
- int xsecsize;
- int lsect;
- int psect;
- int aborted = 0;
+ res = bench_helper(BENCH_MD5, NULL, NULL, buf);
 
- disk.write_error_count = 0;
- 
- if (open_drives() == -1)
-    return -1;
+ // a format's GAP values must not carry over to the next format
+ memcpy(gap_set, disk.gap_set, sizeof(gap_set));
 
- if (override_values() != DSK_ERR_OK)
-    return -1;
+ for (n = 0; res == 0 && (fmt = format_enum(n, &detect)) != NULL; n++)
+    {
+     if (*disk.format && strcasecmp(fmt->name, disk.format))
+        continue;
+     memcpy(disk.gap_set, gap_set, sizeof(gap_set));
+     if (format_set_geometry(fmt) == -1 || dg.dg_sectors < 1 ||
+        dg.dg_cylinders < 1)
+        continue;
+
+     free(format);
+     if ((format = malloc(sizeof(DSK_FORMAT) * dg.dg_sectors)) == NULL)
+        {
+         res = -1;
+         break;
+        }
 
- // initialise the info file
- init_info_file();
- 
- // enter a disk description
- if (enter_disk_description() == -1)
+     for (i = BENCH_SKEW; i < BENCH_MD5; i++)
+        if (bench_helper(i, fmt->name, format, buf) == -1)
+           printf("{\"bench\":\"helper\",\"format\":\"%s\",\"error\":true}\n",
+           fmt->name);
+    }
+
+ free(format);
+ free(buf);
+
+ return res;
+}
+
+//==============================================================================
+// Set up the rotational model of a track for the current format.
+//
+// The sector, gap and track byte counts are the same ones used to format a
+// track (see format_track_size() and fdc_buffer_format()) so set_format_struct()
+// must have been called for the format first.  The sectors are assumed to be
+// evenly spaced around the track in the format's physical sector order.
+//
+//   pass: rot_model_t *m               model
+//         DSK_FORMAT *format           format structure for 1 track
+//         int turnaround               host/controller turnaround in us
+// return: int                          0 if no error, else -1
+//==============================================================================
+static int rot_model_set (rot_model_t *m, DSK_FORMAT *format, int turnaround)
+{
+ fdc_format_data_t *p;
+ int nominal;
+ int revs;
+ int total;
+ int one;
+ int i;
+ int k;
+
+ p = (dg.dg_fm == 1) ? (fdc_format_data_t *)ibm_3740 :
+ (fdc_format_data_t *)ibm_system_34;
+
+ one = format_track_size(p, format, dg.dg_fmtgap, 1);
+ total = format_track_size(p, format, dg.dg_fmtgap, dg.dg_sectors);
+ if (one == -1 || total == -1)
     return -1;
 
- if (disk.verbose) 
-    printf("\nCopying disk/image '%s' to '%s'\n", disk.ifile, ofile_name);
+ if (dg.dg_sectors > 1)
+    {
+     m->slot = (total - one) / (dg.dg_sectors - 1);
+     m->header = one - m->slot;
+    }
+ else
+    {
+     m->slot = one;
+     m->header = 0;
+    }
+ m->busy = m->slot - dg.dg_fmtgap;
+
+ // same drive guess as fdc_buffer_format(), 360 RPM for RATE_DD
+ revs = (xdg.dg_idatarate == RATE_DD)? 6 : 5;
+ nominal = (data_rates_val[xdg.dg_idatarate] / 8) / revs;
+ if (dg.dg_fm)
+    nominal /= 2;
+
+ m->rev_ns = 1e9 / revs;
+ m->byte_ns = m->rev_ns / nominal;
+ m->turn_ns = turnaround * 1000.0;
+
+ // physical position of each sector, skewed if the format says so
+ for (i = 0; i < dg.dg_sectors; i++)
+    {
+     m->pos[i] = i;
+     if (xdg.dg_pskew0)
+        for (k = 0; k < dg.dg_sectors; k++)
+           if (xdg.dg_pskew0[k] == i + (int)dg.dg_secbase)
+              m->pos[i] = k;
+    }
+
+ return 0;
+}
+
+//==============================================================================
+// Time from the index to a sector's ID.
+//
+//   pass: rot_model_t *m               model
+//         int lsect                    sector (from 0)
+// return: double                       ns
+//==============================================================================
+static double rot_sector_ns (rot_model_t *m, int lsect)
+{
+ double ns = (m->header + m->pos[lsect] * m->slot) * m->byte_ns;
+
+ // a track that is too full wraps around
+ while (ns >= m->rev_ns)
+    ns -= m->rev_ns;
+
+ return ns;
+}
+
+//==============================================================================
+// Predict the time to read a track in the order of the skew table.
+//
+// Reading starts half a revolution (on average) before the first sector.
+// Each sector is read from it's ID to the end of it's data and the next
+// read is ready after the turnaround time, if the next sector's ID has
+// already passed the head by then it has to come around again.
+//
+//   pass: rot_model_t *m               model
+//         int *order                   skew table (read order)
+// return: double                       ns
+//==============================================================================
+static double rot_track_ns (rot_model_t *m, int *order)
+{
+ double first;
+ double start;
+ double t;
+ int i;
+
+ first = rot_sector_ns(m, order[0]);
+ t = first + m->busy * m->byte_ns;
+
+ for (i = 1; i < dg.dg_sectors; i++)
+    {
+     // wait for the sector to come around after the turnaround time
+     start = rot_sector_ns(m, order[i]);
+     while (start < t + m->turn_ns)
+        start += m->rev_ns;
+     t = start + m->busy * m->byte_ns;
+    }
+
+ return t - first + m->rev_ns / 2;
+}
+
+//==============================================================================
+// Predict the time to read a whole disk.
+//
+//   pass: double track_ns              time to read one track
+// return: double                       seconds
+//==============================================================================
+static double rot_disk_s (double track_ns)
+{
+ return (track_ns * dg.dg_cylinders * dg.dg_heads +
+ (dg.dg_cylinders - 1) * (PLAN_STEP_US + PLAN_SETTLE_US) * 1000.0) / 1e9;
+}
+
+//==============================================================================
+// Find the skew values that read a track in the least time.
+//
+// Every skew value and first sector is tried, the ones passed in are kept
+// unless another pair is quicker.
+//
+//   pass: rot_model_t *m               model
+//         int *skew                    skew value
+//         int *ofs                     skew offset (first sector)
+//         int val_only                 only try offsets for *skew if not 0
+// return: double                       ns for the best track
+//==============================================================================
+static double rot_best_skew (rot_model_t *m, int *skew, int *ofs,
+                             int val_only)
+{
+ double best;
+ double ns;
+ int val;
+ int o;
+
+ create_skew_table(*skew, *ofs, dg.dg_sectors);
+ best = rot_track_ns(m, skew_table);
+
+ for (val = 1; val < dg.dg_sectors; val++)
+    {
+     if (val_only && val != *skew)
+        continue;
+     for (o = 0; o < dg.dg_sectors; o++)
+        {
+         create_skew_table(val, o, dg.dg_sectors);
+         ns = rot_track_ns(m, skew_table);
+         // must be quicker by more than a microsecond to be better
+         if (ns < best - 1000.0)
+            {
+             best = ns;
+             *skew = val;
+             *ofs = o;
+            }
+        }
+    }
+
+ return best;
+}
+
+//==============================================================================
+// Planning process (--disk=plan).
+//
+// Uses a rotational model of each built in format (or just the --format) to
+// predict the revolutions and time taken to read a track and a whole disk
+// with the format's skew values (or --skew and --skew-ofs) and reports the
+// quickest skew values.  The host and controller turnaround time between
+// sector reads is set with --turnaround.  With a single --format the best
+// result for each skew value is also shown.
+//
+// Nothing is read, the model only uses the format's geometry and GAP
+// values so drive speed variations, sector read errors and the sector ID
+// reads made by detection are not included.
+//
+//   pass: void
+// return: int                          0 if no error, else -1
+//==============================================================================
+static int disk_plan (void)
+{
+ disk_format_t *fmt;
+ DSK_FORMAT *format = NULL;
+ rot_model_t m;
+ char *detect;
+ double cur_ns;
+ double best_ns;
+ double ns;
+ int gap_set[8];
+ int cur_val;
+ int cur_ofs;
+ int val;
+ int ofs;
+ int found = 0;
+ int n;
+
+ memset(&m, 0, sizeof(m));
+
+ printf("Turnaround: %d us  Step: %d ms  Settle: %d ms\n\n",
+ disk.turnaround, PLAN_STEP_US / 1000, PLAN_SETTLE_US / 1000);
+ printf("Format               Sec Size Rate  Skew   Revs ms/trk  Disk s"
+ "   Best   Revs ms/trk  Disk s\n");
+
+ // a format's GAP values must not carry over to the next format
+ memcpy(gap_set, disk.gap_set, sizeof(gap_set));
+
+ for (n = 0; (fmt = format_enum(n, &detect)) != NULL; n++)
+    {
+     if (*disk.format && strcasecmp(fmt->name, disk.format))
+        continue;
+     memcpy(disk.gap_set, gap_set, sizeof(gap_set));
+     if (format_set_geometry(fmt) == -1 || dg.dg_sectors < 1 ||
+        dg.dg_cylinders < 1)
+        continue;
+
+     free(format);
+     free(m.pos);
+     format = malloc(sizeof(DSK_FORMAT) * dg.dg_sectors);
+     m.pos = malloc(sizeof(int) * dg.dg_sectors);
+     if (! format || ! m.pos)
+        {
+         printf(APPNAME": --disk=plan - unable to allocate memory\n");
+         break;
+        }
+
+     if (set_format_struct(&dg, 1 % dg.dg_cylinders, 0, 0, format) == -1 ||
+        rot_model_set(&m, format, disk.turnaround) == -1)
+        continue;
+     found++;
+
+     cur_val = (dg_opts.skew_val != -1)? dg_opts.skew_val : xdg.dg_skew_val;
+     cur_ofs = (dg_opts.skew_ofs != -1)? dg_opts.skew_ofs : xdg.dg_skew_ofs;
+     cur_ofs %= dg.dg_sectors;
+
+     create_skew_table(cur_val, cur_ofs, dg.dg_sectors);
+     cur_ns = rot_track_ns(&m, skew_table);
+
+     val = cur_val;
+     ofs = cur_ofs;
+     best_ns = rot_best_skew(&m, &val, &ofs, 0);
+
+     printf("%-20s %3d %4d %3s%s %3d,%-3d %5.2f %6.1f %7.1f  %3d,%-3d %5.2f"
+     " %6.1f %7.1f\n", fmt->name, dg.dg_sectors, (int)dg.dg_secsize,
+     datarates_str[xdg.dg_idatarate], dg.dg_fm? "/fm" : "   ",
+     cur_val, cur_ofs, cur_ns / m.rev_ns, cur_ns / 1e6, rot_disk_s(cur_ns),
+     val, ofs, best_ns / m.rev_ns, best_ns / 1e6, rot_disk_s(best_ns));
+
+     // the best first sector for each skew value of a single format
+     if (! *disk.format)
+        continue;
+
+     printf("\nSkew   Revs ms/trk  Disk s\n");
+     for (val = 1; val < dg.dg_sectors || val == 1; val++)
+        {
+         ofs = cur_ofs;
+         ns = rot_best_skew(&m, &val, &ofs, 1);
+         printf("%3d,%-3d %5.2f %6.1f %7.1f\n", val, ofs, ns / m.rev_ns,
+         ns / 1e6, rot_disk_s(ns));
+        }
+    }
+
+ memcpy(disk.gap_set, gap_set, sizeof(gap_set));
+ free(format);
+ free(m.pos);
+
+ if (! found)
+    {
+     printf(APPNAME": --disk=plan - no built in format '%s'\n", disk.format);
+     return -1;
+    }
+
+ return 0;
+}
+
+//==============================================================================
+// Get the skew profile file name and the identity of the input drive.
+//
+//   pass: char *file                   file name result (SKEWPROF_LINE)
+//         char *drive                  drive identity result (SKEWPROF_LINE)
+// return: void
+//==============================================================================
+static void skew_profile_names (char *file, char *drive)
+{
+ snprintf(file, SKEWPROF_LINE, "%s%s", userhome_confpath, SKEWPROF_FILE);
+ snprintf(drive, SKEWPROF_LINE, "%s:%s", disk.itype, disk.ifile);
+}
+
+//==============================================================================
+// Use the calibrated skew values for the input drive and format if there
+// are some (see --disk=calibrate).
+//
+//   pass: void
+// return: void
+//==============================================================================
+static void skew_profile_apply (void)
+{
+ char file[SKEWPROF_LINE];
+ char drive[SKEWPROF_LINE];
+ int skew;
+ int ofs;
+
+ skew_profile_names(file, drive);
+ if (skewprof_get(file, drive, xdg.dg_format_name, &skew, &ofs) == -1)
+    return;
+
+ xdg.dg_skew_val = skew;
+ xdg.dg_skew_ofs = ofs;
+
+ if (disk.verbose > 1)
+    printf("Using calibrated skew %d,%d for '%s'\n", skew, ofs, drive);
+}
+
+//==============================================================================
+// Time buffered reads of a track with one skew setting (--disk=calibrate).
+//
+// The best of CALIBRATE_READS reads is used.  The time includes the drive
+// time of a simulated drive.  Any sector read error fails the calibration.
+//
+//   pass: int skew                     skew value
+//         int ofs                      skew offset
+//         dsk_pcyl_t cyl               cylinder number
+//         dsk_phead_t head             physical side of disk
+//         dsk_phead_t xhead            ID side value
+// return: double                       ms, else -1 if a sector failed
+//==============================================================================
+static double calibrate_track (int skew, int ofs, dsk_pcyl_t cyl,
+                               dsk_phead_t head, dsk_phead_t xhead)
+{
+ uint64_t best = 0;
+ uint64_t t;
+ int i;
+
+ if (create_skew_table(skew, ofs, dg.dg_sectors) == -1)
+    return -1;
+
+ for (i = 0; i < CALIBRATE_READS; i++)
+    {
+     t = time_get_ns() + sim_delay_ns();
+     if (read_buffered_track(cyl, cyl, head, xhead) != DSK_ERR_OK)
+        {
+         printf(APPNAME": --disk=calibrate - the track could not be read, a"
+         " known good disk is needed\n");
+         return -1;
+        }
+     t = time_get_ns() + sim_delay_ns() - t;
+     if (! best || t < best)
+        best = t;
+    }
+
+ buffered_cylinder = -1;
+ buffered_head = -1;
+
+ return best / 1e6;
+}
+
+//==============================================================================
+// Skew calibration process (--disk=calibrate).
+//
+// Times buffered reads of a track of a known good disk with each skew value
+// and then each first sector for the quickest skew value.  The quickest
+// values are saved in the skew profile for the input drive and format and
+// are used by later copies with the drive unless --skew or --skew-ofs is
+// given or --skewprof=off.  The middle cylinder is read unless --start is
+// given and side 0 unless --iside is given.
+//
+//   pass: void
+// return: int                          0 if no error, else -1
+//==============================================================================
+static int disk_calibrate (void)
+{
+ DSK_FORMAT sector_id;
+ char file[SKEWPROF_LINE];
+ char drive[SKEWPROF_LINE];
+ dsk_pcyl_t cyl;
+ dsk_phead_t head;
+ double cur_ms;
+ double best_ms;
+ double ms;
+ int cur_val;
+ int cur_ofs;
+ int best_val;
+ int best_ofs;
+ int xsecsize;
+ int xhead;
+ int val;
+ int ofs;
+
+ // set input type based on input name
+ set_xtype_xfile(disk.ifile, disk.itype);
+
+ if (! *disk.ifile)
+    {
+     printf(APPNAME": use '--if' option to specify an input file.\n");
+     return -1;
+    }
+
+ if (open_drives() == -1 || override_values() != DSK_ERR_OK)
+    {
+     close_files();
+     return -1;
+    }
+
+ if (dg.dg_sectors < 2)
+    {
+     printf(APPNAME": --disk=calibrate - the format has less than 2"
+     " sectors per track\n");
+     close_files();
+     return -1;
+    }
+
+ home_and_reset_input_drive_and_settings(&sector_id);
+
+ set_start_finish(&cyl_start, NULL, NULL, NULL);
+ cyl = (disk.start < 0)? dg.dg_cylinders / 2 : cyl_start;
+ head = (disk.iside == -1)? 0 : disk.iside;
+
+ if (xdg.dg_secbase2c != -1 && (int)cyl >= xdg.dg_secbase2c)
+    dg.dg_secbase = xdg.dg_secbase2s;
+ else
+    dg.dg_secbase = xdg.dg_secbase1s;
+
+ read_sector_id(cyl, head, &xhead, &xsecsize);
+ set_special_disk(cyl, head, xsecsize);
+ if (set_format_gaps(&dg, cyl, head, xhead) == -1)
+    {
+     close_files();
+     return -1;
+    }
+
+ skew_profile_names(file, drive);
+ cur_val = xdg.dg_skew_val;
+ cur_ofs = xdg.dg_skew_ofs % dg.dg_sectors;
+
+ if (disk.verbose)
+    printf("\nCalibrating '%s' format '%s' on cylinder %d head %d:\n\n",
+    drive, xdg.dg_format_name, cyl, head);
+
+ // the first read moves the head to the cylinder
+ if (calibrate_track(cur_val, cur_ofs, cyl, head, xhead) == -1 ||
+    (cur_ms = calibrate_track(cur_val, cur_ofs, cyl, head, xhead)) == -1)
+    {
+     close_files();
+     return -1;
+    }
+ printf("Skew %3d,%-3d %8.1f ms/track (current)\n", cur_val, cur_ofs,
+ cur_ms);
+
+ best_val = cur_val;
+ best_ofs = cur_ofs;
+ best_ms = cur_ms;
+
+ // each skew value with the current first sector
+ for (val = 1; val < dg.dg_sectors; val++)
+    {
+     if (val == cur_val)
+        continue;
+     if ((ms = calibrate_track(val, cur_ofs, cyl, head, xhead)) == -1)
+        {
+         close_files();
+         return -1;
+        }
+     printf("Skew %3d,%-3d %8.1f ms/track\n", val, cur_ofs, ms);
+
+     // must be quicker by more than 1% to be better
+     if (ms < best_ms * 0.99)
+        {
+         best_val = val;
+         best_ms = ms;
+        }
+    }
+
+ // then each first sector with the quickest skew value
+ for (ofs = 0; ofs < dg.dg_sectors; ofs++)
+    {
+     if (ofs == cur_ofs)
+        continue;
+     if ((ms = calibrate_track(best_val, ofs, cyl, head, xhead)) == -1)
+        {
+         close_files();
+         return -1;
+        }
+     printf("Skew %3d,%-3d %8.1f ms/track\n", best_val, ofs, ms);
+
+     if (ms < best_ms * 0.99)
+        {
+         best_ofs = ofs;
+         best_ms = ms;
+        }
+    }
+
+ close_files();
+
+ printf("\nQuickest skew %d,%d: %.1f ms/track (%.0f%% of the time of %d,%d)\n",
+ best_val, best_ofs, best_ms, best_ms * 100.0 / cur_ms, cur_val, cur_ofs);
+
+ if (skewprof_put(file, drive, xdg.dg_format_name, best_val, best_ofs,
+    best_ms) == -1)
+    return -1;
+
+ if (disk.verbose)
+    printf("Saved in '%s'\n", file);
+
+ return 0;
+}
+
+//==============================================================================
+// Write a sector that was retried in the second pass of a deferred copy.
+//
+// The sector data is in the session buffer at it's physical position.
+//
+//   pass: retry_entry_t *r             deferred sector
+// return: dsk_err_t                    DSK_ERR_OK if successful
+//==============================================================================
+static dsk_err_t retry_write_sector (retry_entry_t *r)
+{
+ DSK_GEOMETRY g;
+ dsk_phead_t head = r->head;
+ dsk_phead_t xhead = r->xhead;
+ dsk_err_t dsk_err = DSK_ERR_NOTIMPL;
+ uint8_t *p;
+ int psect;
+
+ psect = skew_table[r->lsect] + dg.dg_secbase;
+ p = buf + dg.dg_secsize * (psect - dg.dg_secbase);
+
+ // same --oside work around as write_buffered_track()
+ if (disk.oside_not_support && disk.oside != -1)
+    {
+     head = disk.oside;
+     xhead = disk.oside;
+    }
+
+ // raw output image being written directly
+ if (raw_outf)
+    {
+     long pos = (long)((r->cyl * dg.dg_heads + head) *
+                dg.dg_sectors + (psect - dg.dg_secbase)) * dg.dg_secsize;
+
+     // rewriting an earlier sector ends the streamed digests
+     out_hash_update(pos, p, dg.dg_secsize);
+     if (raw_output_flush() != DSK_ERR_OK)
+        return DSK_ERR_SYSERR;
+     if (fseek(raw_outf, pos, SEEK_SET) != 0 ||
+        fwrite(p, dg.dg_secsize, 1, raw_outf) != 1)
+        return DSK_ERR_SYSERR;
+     return DSK_ERR_OK;
+    }
+
+ memcpy(&g, &dg, sizeof(DSK_GEOMETRY));
+ g.dg_datarate = xdg.dg_odatarate;
+ g.dg_fm = xdg.dg_ofm;
+
+ // sets the GAP values for the track
+ if (set_format_gaps(&g, r->cyl, head, xhead) == -1)
+    return DSK_ERR_UNKNOWN;
+
+ // the same sector ID values as write_buffered_track()
+ if (output_sup.xwrite)
+    dsk_err = trace_xwrite(odrive, &g, p, r->cyl, head, r->cyl,
+    (disk.forceside == 0)? xhead : format_side_id(head, xhead), psect,
+    g.dg_secsize, 0);
+
+ if (dsk_err == DSK_ERR_NOTIMPL)
+    dsk_err = trace_pwrite(odrive, &g, p, r->cyl, head, psect);
+
+ return dsk_err;
+}
+
+//==============================================================================
+// Second pass of a deferred copy.
+//
+// All the sectors that failed during the first pass are read again using
+// the full retry method, the output is updated and the info file sector
+// status map is set to the new result.  The sectors are visited in
+// cylinder order to keep head movement down.
+//
+// If the copy was aborted there is no second pass and the deferred sectors
+// are counted as errors.
+//
+//   pass: int aborted                  not 0 if the copy was aborted
+// return: int                          0 if no error, -1 if aborted
+//==============================================================================
+static int retry_deferred_sectors (int aborted)
+{
+ retry_entry_t *r;
+ dsk_err_t dsk_err = DSK_ERR_OK;
+ dsk_err_t write_err;
+ uint64_t t;
+ int i;
+
+ retry_pass = 2;
+
+ if (aborted)
+    {
+     sect_errors_tot += retry_queue_count;
+     retry_queue_count = 0;
+    }
+
+ if (retry_queue_count)
+    {
+     qsort(retry_queue, retry_queue_count, sizeof(retry_entry_t),
+     retry_queue_cmp);
+
+     if (disk.verbose)
+        printf("\n\nRetrying %d deferred sector(s):\n", retry_queue_count);
+    }
+
+ for (i = 0; i < retry_queue_count; i++)
+    {
+     r = &retry_queue[i];
+
+     // restore the geometry the track was read with
+     dg.dg_sectors = r->sectors;
+     dg.dg_secbase = r->secbase;
+     dg.dg_secsize = r->secsize;
+     create_skew_table(xdg.dg_skew_val, xdg.dg_skew_ofs, dg.dg_sectors);
+
+     // only this sector is wanted and not the whole track
+     buffered_cylinder = r->cyl;
+     buffered_head = r->head;
+     buffered_ok[r->lsect] = 0;
+
+     dsk_err = read_sector_retry(r->cyl, r->head, r->xhead, r->lsect);
+
+     if (r->info_trk != -1)
+        info_map_set(&info.map, r->info_trk, r->info_sec,
+        (sect_retry_count == -1)? INFO_ERROR : sect_retry_count);
+
+     if (sect_retry_count == -1)
+        event_sector_error(r->cyl, r->head,
+        skew_table[r->lsect] + dg.dg_secbase);
+
+     if (dsk_err == DSK_ERR_ABORT)
+        {
+         // the sectors not retried are counted as errors
+         sect_errors_tot += retry_queue_count - i - 1;
+         break;
+        }
+
+     t = profile_begin(prof);
+     write_err = retry_write_sector(r);
+     profile_end(prof, PROFILE_WRITE, r->cyl * dg.dg_heads + r->head, t);
+
+     if (write_err != DSK_ERR_OK)
+        {
+         if (++disk.write_error_count <= 10)
+            printf("\n"APPNAME": retry_deferred_sectors() Cyl:%03d "
+            "Head:%02d Error writing sector\n", r->cyl, r->head);
+        }
+     else
+        checkpoint_retried(r);
+    }
+
+ free(retry_queue);
+ retry_queue = NULL;
+ retry_queue_count = 0;
+ retry_queue_size = 0;
+ retry_pass = 0;
+
+ return (dsk_err == DSK_ERR_ABORT)? -1 : 0;
+}
+
+//==============================================================================
+// Determine if a checkpoint journal can be used for the output.
+//
+// The journal is kept next to the output image so outputs that are not
+// image files (floppy, remote, etc) can't have one.
+//
+//   pass: void
+// return: int                          1 if possible, else 0
+//==============================================================================
+static int checkpoint_possible (void)
+{
+ return (disk.checkpoint || disk.resume) && *ofile_name &&
+        string_search(no_info_file, disk.otype) == -1;
+}
+
+//==============================================================================
+// Check if a copy can be resumed into the output.
+//
+// Called once the output file name is known and before the output is
+// created.  If --resume is set and a checkpoint journal for the output is
+// found the output is opened instead of being created.  The journal values
+// are checked against the copy later on by checkpoint_open().
+//
+//   pass: void
+// return: void
+//==============================================================================
+static void checkpoint_check (void)
+{
+ struct stat st;
+ char line[100];
+ FILE *f;
+
+ ckpt_resume = 0;
+ *ckpt_file = 0;
+
+ if (! checkpoint_possible())
+    return;
+
+ if (snprintf(ckpt_file, sizeof(ckpt_file), "%s.ckpt", ofile_name) >=
+    (int)sizeof(ckpt_file))
+    {
+     printf(APPNAME": output file name is too long for a checkpoint, the"
+            " copy can't be resumed.\n");
+     *ckpt_file = 0;
+     return;
+    }
+
+ if (! disk.resume)
+    return;
+
+ if ((f = fopen(ckpt_file, "r")) == NULL)
+    {
+     printf(APPNAME": no checkpoint found for '%s', copying from the"
+            " start.\n", ofile_name);
+     return;
+    }
+
+ if (fgets(line, sizeof(line), f) && strcmp(line, CKPT_ID"\n") == 0 &&
+    stat(ofile_name, &st) == 0)
+    ckpt_resume = 1;
+ else
+    printf(APPNAME": checkpoint '%s' can't be used, copying from the"
+           " start.\n", ckpt_file);
+
+ fclose(f);
+}
+
+//==============================================================================
+// Add a track record from a checkpoint journal to the info sector map.
+//
+// The record is checked completely before anything is changed.
+//
+//   pass: char *s                      values following the 'T'
+// return: int                          track number, -1 if error
+//==============================================================================
+static int checkpoint_apply_track (char *s)
+{
+ int v[7];
+ int secbase = 0, secsize = 0;
+ int sectors;
+ int *status = NULL;
+ int trk;
+ int n;
+ int i;
+
+ if (sscanf(s, "%d %d %d %d %d %d %d %d%n", &v[0], &v[1], &v[2], &v[3],
+    &v[4], &v[5], &v[6], &sectors, &n) != 8 || sectors < 0)
+    return -1;
+ s += n;
+
+ if (sectors)
+    {
+     if (sscanf(s, "%d %d%n", &secbase, &secsize, &n) != 2 ||
+        (status = malloc(sizeof(int) * sectors)) == NULL)
+        return -1;
+     s += n;
+     for (i = 0; i < sectors; i++)
+        {
+         if (sscanf(s, "%d%n", &status[i], &n) != 1)
+            {
+             free(status);
+             return -1;
+            }
+         s += n;
+        }
+
+     trk = info_map_add(&info.map, v[1], v[2], secbase, sectors, secsize);
+     if (trk == -1)
+        {
+         free(status);
+         return -1;
+        }
+     for (i = 0; i < sectors; i++)
+        info_map_set(&info.map, trk, i, status[i]);
+     free(status);
+
+     info.trk = trk;
+     info.cyl_last = v[1];
+     info.head_last = v[2];
+    }
+
+ sect_errors_tot = v[3];
+ sect_retries_tot = v[4];
+ auto_retry_abort = v[5];
+ auto_seeked_count = v[6];
+
+ return v[0];
+}
+
+//==============================================================================
+// Open the checkpoint journal for a copy.
+//
+// For a new copy the journal is created with a header describing the copy.
+// When resuming the journal is checked against the copy being made and the
+// sector map, counters and deferred sectors are restored from the track
+// records.  The last completed track is copied again as it may not have
+// been completely written to the output.
+//
+// Journal records are one per line:
+//
+// Q cyl head xhead lsect sectors secbase secsize info_trk info_sec
+//   A deferred sector queued while reading the track in the next T record.
+// T trk cyl head errors retries abort seeked sectors [secbase secsize s...]
+//   A completed track with the counters and the sector status map entries.
+// X trk
+//   The copy was resumed at trk, the last T record and it's Q records are
+//   not used.
+// R cyl head lsect status errors retries abort seeked
+//   A deferred sector retried after the first pass.
+//
+//   pass: int *trk_resume              track to start copying from
+// return: int                          0 if no error, else -1
+//==============================================================================
+static int checkpoint_open (int *trk_resume)
+{
+ char temp_str[100];
+ char *line;
+ char *pend;
+ retry_entry_t r;
+ long good_pos;
+ int cylinders, heads, sectors, secsize, start, finish;
+ int status;
+ int q_done = 0;
+ int q_pend = 0;
+ int mismatch = 0;
+ int stop = 0;
+ int trk = -1;
+ int x;
+ int i;
+
+ *trk_resume = trk_start;
+
+ if (! *ckpt_file)
+    return 0;
+
+ if ((ckpt_rec = malloc(CKPT_RECORD_SIZE)) == NULL)
+    return -1;
+ *ckpt_rec = 0;
+
+ if (! ckpt_resume)
+    {
+     if ((ckptf = fopen(ckpt_file, "w")) == NULL)
+        {
+         printf(APPNAME": unable to create checkpoint file: %s\n", ckpt_file);
+         checkpoint_close(-1);
+         return -1;
+        }
+     fprintf(ckptf, CKPT_ID"\n");
+     fprintf(ckptf, "I %s\n", disk.ifile);
+     fprintf(ckptf, "F %s\n", xdg.dg_format_name);
+     fprintf(ckptf, "G %d %d %d %d\n", dg.dg_cylinders, dg.dg_heads,
+     dg.dg_sectors, (int)dg.dg_secsize);
+     fprintf(ckptf, "S %d %d\n", trk_start, trk_finish);
+     checkpoint_write(ckptf, "");
+     return 0;
+    }
+
+ if ((ckptf = fopen(ckpt_file, "r+")) == NULL)
+    {
+     printf(APPNAME": unable to open checkpoint file: %s\n", ckpt_file);
+     checkpoint_close(-1);
+     return -1;
+    }
+
+ if ((line = malloc(CKPT_RECORD_SIZE * 2)) == NULL)
+    {
+     checkpoint_close(-1);
+     return -1;
+    }
+ pend = line + CKPT_RECORD_SIZE;
+ *pend = 0;
+
+ fgets(line, CKPT_RECORD_SIZE, ckptf);
+ good_pos = ftell(ckptf);
+
+ while (! stop && ! mismatch && fgets(line, CKPT_RECORD_SIZE, ckptf))
+    {
+     // a partly written line at the end is not used
+     if (! strchr(line, '\n'))
+        break;
+     *strchr(line, '\n') = 0;
+
+     switch (line[0])
+        {
+         case 'I' :
+            mismatch = strcmp(line + 2, disk.ifile) != 0;
+            break;
+         case 'F' :
+            mismatch = strcmp(line + 2, xdg.dg_format_name) != 0;
+            break;
+         case 'G' :
+            mismatch = sscanf(line + 2, "%d %d %d %d", &cylinders, &heads,
+            &sectors, &secsize) != 4 || cylinders != dg.dg_cylinders ||
+            heads != dg.dg_heads || sectors != dg.dg_sectors ||
+            secsize != dg.dg_secsize;
+            break;
+         case 'S' :
+            mismatch = sscanf(line + 2, "%d %d", &start, &finish) != 2 ||
+            start != trk_start || finish != trk_finish;
+            break;
+         case 'Q' :
+            memset(&r, 0, sizeof(r));
+            if (sscanf(line + 2, "%d %d %d %d %d %d %d %d %d", &r.cyl,
+               &r.head, &r.xhead, &r.lsect, &r.sectors, &r.secbase,
+               &secsize, &r.info_trk, &r.info_sec) != 9 ||
+               retry_queue_add(r.cyl, r.head, r.xhead, r.lsect) != 0)
+               {
+                stop = 1;
+                break;
+               }
+            r.secsize = secsize;
+            retry_queue[retry_queue_count - 1] = r;
+            retry_queued = 0;
+            break;
+         case 'T' :
+            // the previous track record is complete and can be used
+            if (*pend)
+               {
+                if ((x = checkpoint_apply_track(pend)) < 0)
+                   {
+                    stop = 1;
+                    break;
+                   }
+                trk = x;
+                q_done = q_pend;
+               }
+            strcpy(pend, line + 2);
+            q_pend = retry_queue_count;
+            break;
+         case 'X' :
+            *pend = 0;
+            retry_queue_count = q_done;
+            break;
+         case 'R' :
+            if (sscanf(line + 2, "%d %d %d %d %d %d %d %d", &r.cyl, &r.head,
+               &r.lsect, &status, &sect_errors_tot, &sect_retries_tot,
+               &auto_retry_abort, &auto_seeked_count) != 8)
+               {
+                stop = 1;
+                break;
+               }
+            // all the tracks were completed before the retries started
+            if (*pend)
+               {
+                if ((x = checkpoint_apply_track(pend)) < 0)
+                   {
+                    stop = 1;
+                    break;
+                   }
+                trk = x;
+                q_done = q_pend;
+                *pend = 0;
+               }
+            for (i = 0; i < q_done; i++)
+               {
+                if (retry_queue[i].cyl == r.cyl &&
+                    retry_queue[i].head == r.head &&
+                    retry_queue[i].lsect == r.lsect)
+                   {
+                    if (retry_queue[i].info_trk != -1)
+                       info_map_set(&info.map, retry_queue[i].info_trk,
+                       retry_queue[i].info_sec, status);
+                    memmove(&retry_queue[i], &retry_queue[i + 1],
+                    sizeof(retry_entry_t) * (retry_queue_count - i - 1));
+                    retry_queue_count--;
+                    q_done--;
+                    break;
+                   }
+               }
+            break;
+        }
+
+     if (! stop)
+        good_pos = ftell(ckptf);
+    }
+
+ free(line);
+
+ if (mismatch)
+    {
+     printf(APPNAME": checkpoint '%s' was made for a different copy, remove"
+            " it or copy without --resume.\n", ckpt_file);
+     checkpoint_close(-1);
+     return -1;
+    }
+
+ // deferred sectors of the track being copied again are dropped
+ retry_queue_count = q_done;
+
+ if (trk >= 0)
+    *trk_resume = trk + 1;
+
+ // anything after the last good record is cut off and the journal carries
+ // on from there
+ fflush(ckptf);
+#ifdef WIN32
+ chsize(fileno(ckptf), good_pos);
+#else
+ if (ftruncate(fileno(ckptf), good_pos) != 0)
+    printf(APPNAME": unable to truncate checkpoint file: %s\n", ckpt_file);
+#endif
+ fseek(ckptf, good_pos, SEEK_SET);
+
+ snprintf(temp_str, sizeof(temp_str), "X %d\n", *trk_resume);
+ checkpoint_write(ckptf, temp_str);
+
+ if (disk.verbose)
+    printf("\nResuming copy at track %d (%d sector errors so far).\n",
+    *trk_resume, sect_errors_tot);
+
+ return 0;
+}
+
+//==============================================================================
+// Create the checkpoint record for a completed track.
+//
+// The record is placed in the session's checkpoint record buffer and is
+// written to the journal once the track has been written to the output.
+// The deferred sectors queued while reading the track come first and the
+// track line last so that a partly written record is not used.  If the
+// record won't fit no record is made and the track will be copied again if
+// the copy is resumed.
+//
+//   pass: dsk_ltrack_t trk             logical track number
+//         dsk_pcyl_t cyl               cylinder number
+//         dsk_phead_t head             physical side of disk
+// return: void
+//==============================================================================
+static void checkpoint_record (dsk_ltrack_t trk, dsk_pcyl_t cyl,
+                               dsk_phead_t head)
+{
+ retry_entry_t *r;
+ info_track_t *tp = NULL;
+ char *s = ckpt_rec;
+ int sectors = 0;
+ int i;
+
+ if (! ckptf)
+    return;
+
+ *ckpt_rec = 0;
+
+ if (info.trk != -1 && info.cyl_last == cyl && info.head_last == head)
+    {
+     tp = &info.map.tracks[info.trk];
+     sectors = tp->sectors;
+    }
+
+ if ((retry_queue_count - ckpt_queue_mark) * 100 + sectors * 12 + 200 >
+    CKPT_RECORD_SIZE)
+    return;
+
+ for (i = ckpt_queue_mark; i < retry_queue_count; i++)
+    {
+     r = &retry_queue[i];
+     s += sprintf(s, "Q %d %d %d %d %d %d %d %d %d\n", r->cyl, r->head,
+     r->xhead, r->lsect, r->sectors, r->secbase, (int)r->secsize, r->info_trk,
+     r->info_sec);
+    }
+
+ s += sprintf(s, "T %d %d %d %d %d %d %d %d", trk, cyl, head,
+ sect_errors_tot, sect_retries_tot, auto_retry_abort, auto_seeked_count,
+ sectors);
+ if (sectors)
+    {
+     s += sprintf(s, " %d %d", tp->secbase, tp->secsize);
+     for (i = 0; i < sectors; i++)
+        s += sprintf(s, " %d", info_map_get(&info.map, info.trk, i));
+    }
+ sprintf(s, "\n");
+}
+
+//==============================================================================
+// Write a record to the checkpoint journal.
+//
+// The record is flushed out to the disk before returning so that it will
+// survive a power failure.  This is called by the pipeline writer thread
+// when pipelining.
+//
+//   pass: FILE *f                      checkpoint journal
+//         char *s                      record
+// return: void
+//==============================================================================
+static void checkpoint_write (FILE *f, char *s)
+{
+ fputs(s, f);
+ fflush(f);
+#ifndef WIN32
+ fsync(fileno(f));
+#endif
+}
+
+//==============================================================================
+// Sync the tracks written so far to the output image on the disk.
+//
+// A track must not be journalled as done until it is in the output image
+// or a resumed copy after a crash would skip it.  A raw output written
+// directly has it's buffered tracks (--obuffer) and stdio buffers written
+// out first.  Other outputs are written by LibDsk which has no call to
+// flush it's buffers so only what it has passed on to the host can be
+// synced, the output file is synced through a descriptor of it's own.
+//
+//   pass: void
+// return: int                          0 if no error, else -1
+//==============================================================================
+static int output_sync (void)
+{
+#ifndef WIN32
+ int fd;
+#endif
+
+ if (raw_outf)
+    {
+     if (raw_output_flush() != DSK_ERR_OK || fflush(raw_outf) != 0)
+        return -1;
+#ifndef WIN32
+     if (fsync(fileno(raw_outf)) != 0)
+        return -1;
+#endif
+     return 0;
+    }
+
+#ifndef WIN32
+ if (! *ofile_name || (fd = open(ofile_name, O_RDONLY)) == -1)
+    return 0;
+ fsync(fd);
+ close(fd);
+#endif
+
+ return 0;
+}
+
+//==============================================================================
+// Record the result of a deferred sector retry in the checkpoint journal.
+//
+//   pass: retry_entry_t *r             deferred sector
+// return: void
+//==============================================================================
+static void checkpoint_retried (retry_entry_t *r)
+{
+ char s[200];
+
+ if (! ckptf)
+    return;
+
+ snprintf(s, sizeof(s), "R %d %d %d %d %d %d %d %d\n", r->cyl, r->head,
+ r->lsect, (sect_retry_count == -1)? 1000 : sect_retry_count,
+ sect_errors_tot, sect_retries_tot, auto_retry_abort, auto_seeked_count);
+ checkpoint_write(ckptf, s);
+}
+
+//==============================================================================
+// Close the checkpoint journal.
+//
+// The journal is removed when the copy is complete, if the copy was aborted
+// it is kept so that the copy can be resumed.  An error opening the journal
+// (-1) leaves the journal as it was.
+//
+//   pass: int aborted                  copy was aborted if not 0
+// return: void
+//==============================================================================
+static void checkpoint_close (int aborted)
+{
+ free(ckpt_rec);
+ ckpt_rec = NULL;
+
+ if (! ckptf)
+    return;
+
+ fclose(ckptf);
+ ckptf = NULL;
+
+ if (! aborted)
+    remove(ckpt_file);
+ else if (aborted > 0)
+    printf(APPNAME": checkpoint kept in '%s', use --resume=on to continue"
+           " the copy.\n", ckpt_file);
+}
+
+//==============================================================================
+// Determine if a fast image to image copy can be used.
+//
+// A fast copy is possible when the input and output are both host image
+// files and nothing in the format or options alters the sector data, the
+// sector IDs or the geometry from one track to the next.  The whole disk
+// must also be copied.
+//
+//   pass: void
+// return: int                          FAST_COPY_NONE, FAST_COPY_TRACK or
+//                                      FAST_COPY_FILE
+//==============================================================================
+static int fast_copy_method (void)
+{
+ dsk_cchar_t comp = NULL;
+ struct stat st;
+
+ if (! disk.fastcopy || ! idrive || ! odrive || checkpoint_possible() ||
+     trace_recording())
+    return FAST_COPY_NONE;
+
+ // both input and output must be host image files
+ if (string_search(fast_copy_types, disk.itype) == -1 ||
+     string_search(fast_copy_types, disk.otype) == -1)
+    return FAST_COPY_NONE;
+
+ // nothing may alter the sector data, sector IDs or track geometry
+ if (xdg.ssr_cb || xdg.rsi_cb || xdg.ssd_cb || xdg.pss_cb ||
+     xdg.dg_secbase2c != -1 || xdg.dg_sideoffs || xdg.dg_side1as0 ||
+     disk.forceside || disk.iside != -1 || disk.oside != -1)
+    return FAST_COPY_NONE;
+
+ // the whole disk must be copied
+ if (trk_start != 0 || trk_finish != (dg.dg_cylinders * dg.dg_heads - 1))
+    return FAST_COPY_NONE;
+
+ // raw to raw with a complete uncompressed input file is a file copy
+ if (strcmp(disk.itype, "raw") == 0 && strcmp(disk.otype, "raw") == 0 &&
+     ! *disk.outcomp && dsk_get_comp(idrive, &comp) == DSK_ERR_OK && ! comp &&
+     stat(disk.ifile, &st) == 0 && S_ISREG(st.st_mode) &&
+     st.st_size == (off_t)dg.dg_cylinders * dg.dg_heads * dg.dg_sectors *
+     dg.dg_secsize)
+    return FAST_COPY_FILE;
+
+ return FAST_COPY_TRACK;
+}
+
+//==============================================================================
+// Log all sectors of a track as read without errors in the info file.
+//
+//   pass: dsk_pcyl_t cyl               cylinder number
+//         dsk_phead_t head             physical side of disk
+// return: void
+//==============================================================================
+static void fast_copy_info_track (dsk_pcyl_t cyl, dsk_phead_t head)
+{
+ int lsect;
+
+ sect_retry_count = 0;
+ for (lsect = 0; lsect < dg.dg_sectors; lsect++)
+    info_file_entry(cyl, head, lsect);
+}
+
+//==============================================================================
+// Start streamed digests of the output image.
+//
+// When the output is written by ubeedisk itself (raw images) the digests
+// (--hash) are computed as the data is written instead of reading the image
+// back afterwards.  This only works if the image is written in order from
+// start to end, any out of order write ends the streamed digests and the
+// image is hashed once it has been written.
+//
+//   pass: void
+// return: void
+//==============================================================================
+static void out_hash_start (void)
+{
+ hash_init(&out_hash_ctx, disk.hash);
+ out_hash_pos = 0;
+ out_hash_state = 1;
+}
+
+//==============================================================================
+// Add output image data to the streamed digests.
+//
+//   pass: long pos                     position of the data in the image
+//         void *data                   data written
+//         size_t len                   length of data
+// return: void
+//==============================================================================
+static void out_hash_update (long pos, void *data, size_t len)
+{
+ if (out_hash_state != 1)
+    return;
+
+ if (pos != out_hash_pos)
+    {
+     // finish the context so that any memory it holds is released
+     hash_final(&out_hash_ctx, &out_hash_res);
+     out_hash_state = -1;
+     return;
+    }
+
+ hash_update(&out_hash_ctx, data, len);
+ out_hash_pos += len;
+}
+
+//==============================================================================
+// Get the streamed digests of the output image.
+//
+// The streamed digests are only used if every byte of the image was added
+// in order.  The streamed digests are finished by this call.
+//
+//   pass: hash_res_t *res              digests returned here
+// return: int                          0 if digests returned, else -1
+//==============================================================================
+static int out_hash_result (hash_res_t *res)
+{
+ long size;
+ int state = out_hash_state;
+
+ out_hash_state = 0;
+ if (state != 1)
+    return -1;
+
+ hash_final(&out_hash_ctx, res);
+
+ size = (long)dg.dg_cylinders * dg.dg_heads * dg.dg_sectors * dg.dg_secsize;
+ if (out_hash_pos != size)
+    return -1;
+
+ if (disk.verbose > 1)
+    printf("Output digests computed while writing.\n");
+
+ return 0;
+}
+
+//==============================================================================
+// Copy a file.
+//
+// The file is copied with copy_file_range() where available so that the
+// data need not pass through user space, otherwise it is copied in blocks
+// of the size requested.  If hash is set the blocks are added to the
+// streamed output digests as they are written.
+//
+//   pass: char *from                   file to copy
+//         char *to                     file to create
+//         size_t block                 block size for the copy
+//         int hash                     add the data to the output digests
+// return: off_t                        bytes copied, -1 if error
+//==============================================================================
+static off_t copy_file (char *from, char *to, size_t block, int hash)
+{
+ FILE *fi;
+ FILE *fo;
+ uint8_t *fbuf;
+ size_t n;
+ off_t done = 0;
+ int res = 0;
+
+ if (! (fi = fopen(from, "rb")))
+    return -1;
+ if (! (fo = fopen(to, "wb")))
+    {
+     fclose(fi);
+     return -1;
+    }
+
+#ifdef HAVE_COPY_FILE_RANGE
+ ssize_t c;
+
+ while ((c = copy_file_range(fileno(fi), NULL, fileno(fo), NULL,
+    0x40000000, 0)) > 0)
+    done += c;
+
+ // if the kernel or file system can't do it fall back to copying blocks
+ if (c < 0 && done != 0)
+    res = -1;
+#endif
+
+ if (done == 0 && res == 0)
+    {
+     if (! (fbuf = malloc(block)))
+        res = -1;
+     else
+        {
+         while ((n = fread(fbuf, 1, block, fi)) > 0)
+            {
+             if (fwrite(fbuf, 1, n, fo) != n)
+                {
+                 res = -1;
+                 break;
+                }
+             if (hash)
+                out_hash_update(done, fbuf, n);
+             done += n;
+            }
+         if (ferror(fi))
+            res = -1;
+         free(fbuf);
+        }
+    }
+
+ fclose(fi);
+ if (fclose(fo) != 0)
+    res = -1;
+
+ return (res == -1)? -1 : done;
+}
+
+//==============================================================================
+// Fast raw to raw image copy.
+//
+// The image is copied as one file using copy_file().  LibDsk has not written
+// anything to the output so it is closed first.
+//
+//   pass: void
+// return: int                          0 if no error, else -1
+//==============================================================================
+static int fast_copy_file (void)
+{
+ off_t size;
+ dsk_pcyl_t cyl;
+ dsk_phead_t head;
+
+ size = (off_t)dg.dg_cylinders * dg.dg_heads * dg.dg_sectors * dg.dg_secsize;
+
+ if (disk.verbose)
+    printf("\nCopying data (fast file copy):\n");
+
+ dsk_close(&odrive);
+ odrive = NULL;
+ if (*output_temp)
+    {
+     remove(output_temp);
+     *output_temp = 0;
+    }
+
+ out_hash_start();
+ if (copy_file(disk.ifile, ofile_name, FAST_COPY_BLOCK, 1) != size)
+    {
+     printf(APPNAME": fast_copy_file() - error copying '%s' to '%s'\n",
+     disk.ifile, ofile_name);
+     return -1;
+    }
+
+ // every sector was copied without error
+ for (cyl = 0; cyl < dg.dg_cylinders; cyl++)
+    for (head = 0; head < dg.dg_heads; head++)
+       fast_copy_info_track(cyl, head);
+
+ return create_info_file();
+}
+
+//==============================================================================
+// Determine if the output can be written as a raw image directly.
+//
+// A raw image (uncompressed and side alternate track order) is simply the
+// tracks one after the other so whole tracks can be written directly
+// instead of through LibDsk sector by sector.
+//
+//   pass: void
+// return: int                          1 if possible, else 0
+//==============================================================================
+static int raw_output_possible (void)
+{
+ return strcmp(disk.otype, "raw") == 0 && ! *disk.outcomp &&
+        (dg.dg_heads == 1 || dg.dg_sidedness == SIDES_ALT);
+}
+
+//==============================================================================
+// Open a raw output image for direct track writes.
+//
+// LibDsk has not written anything to the output so it is closed first.  If
+// output buffering (--obuffer) is in use a buffer is allocated so that
+// runs of tracks can be written with one write.
+//
+//   pass: void
+// return: int                          0 if no error, else -1
+//==============================================================================
+static int raw_output_open (void)
+{
+ if (! raw_output_possible())
+    return 0;
+
+ dsk_close(&odrive);
+ odrive = NULL;
+
+ if (! (raw_outf = fopen(ofile_name, ckpt_resume? "r+b" : "wb")))
+    {
+     printf(APPNAME": raw_output_open() - unable to create '%s'\n",
+     ofile_name);
+     return -1;
+    }
+
+ out_hash_start();
+
+ raw_obuf_len = 0;
+ raw_obuf_size = disk.obuffer * 1048576;
+ if (raw_obuf_size && ! (raw_obuf = malloc(raw_obuf_size)))
+    raw_obuf_size = 0;
+
+ return 0;
+}
+
+//==============================================================================
+// Write out any tracks held in the raw output buffer.
+//
+//   pass: void
+// return: dsk_err_t                    DSK_ERR_OK if successful
+//==============================================================================
+static dsk_err_t raw_output_flush (void)
+{
+ size_t len = raw_obuf_len;
+
+ if (! len)
+    return DSK_ERR_OK;
+
+ raw_obuf_len = 0;
+
+ if (fseek(raw_outf, raw_obuf_pos, SEEK_SET) != 0 ||
+     fwrite(raw_obuf, len, 1, raw_outf) != 1)
+    {
+     if (++disk.write_error_count <= 10)
+        printf("\n"APPNAME": raw_output_flush() Error:%s\n", strerror(errno));
+     return DSK_ERR_SYSERR;
+    }
+
+ return DSK_ERR_OK;
+}
+
+//==============================================================================
+// Write the track held in the session buffer to a raw output image.
+//
+// If output buffering is in use the track is added to the buffer if it
+// follows on from the tracks already held, the buffer is written out when
+// full or when the tracks are not in sequence.  The raw driver does not
+// support --oside so the same work around as write_buffered_track() is
+// used.
+//
+//   pass: dsk_pcyl_t cyl               cylinder number
+//         dsk_phead_t head             physical side of disk
+// return: dsk_err_t                    DSK_ERR_OK if successful
+//==============================================================================
+static dsk_err_t raw_output_write (dsk_pcyl_t cyl, dsk_phead_t head)
+{
+ dsk_err_t dsk_err = DSK_ERR_OK;
+ size_t size = dg.dg_sectors * dg.dg_secsize;
+ long pos;
+
+ if (disk.oside_not_support && disk.oside != -1)
+    head = disk.oside;
+ pos = (long)(cyl * dg.dg_heads + head) * size;
+
+ out_hash_update(pos, buf, size);
+
+ if (size <= raw_obuf_size)
+    {
+     if (raw_obuf_len && (pos != raw_obuf_pos + raw_obuf_len ||
+        raw_obuf_len + size > raw_obuf_size))
+        dsk_err = raw_output_flush();
+     if (! raw_obuf_len)
+        raw_obuf_pos = pos;
+     memcpy(raw_obuf + raw_obuf_len, buf, size);
+     raw_obuf_len += size;
+     return dsk_err;
+    }
+
+ if (fseek(raw_outf, pos, SEEK_SET) != 0 ||
+     fwrite(buf, size, 1, raw_outf) != 1)
+    {
+     if (++disk.write_error_count <= 10)
+        printf("\n"APPNAME": raw_output_write() Cyl:%03d Head:%02d "
+        "Error:%s\n", cyl, head, strerror(errno));
+     return DSK_ERR_SYSERR;
+    }
+
+ return DSK_ERR_OK;
+}
+
+//==============================================================================
+// Close a raw output image being written directly.
+//
+//   pass: void
+// return: void
+//==============================================================================
+static void raw_output_close (void)
+{
+ if (! raw_outf)
+    return;
+
+ raw_output_flush();
+
+ if (fclose(raw_outf) != 0)
+    printf(APPNAME": unable to close '%s'\n", ofile_name);
+ raw_outf = NULL;
+
+ free(raw_obuf);
+ raw_obuf = NULL;
+ raw_obuf_size = 0;
+}
+
+//==============================================================================
+// Fast copy of one track.
+//
+// The track is read with a single LibDsk track read and written out as
+// a whole track.  There are no sector ID reads, retries or per sector
+// reporting.  If the track can't be read in one go an error is returned and
+// the caller copies the track the normal way.
+//
+//   pass: dsk_pcyl_t cyl               cylinder number
+//         dsk_phead_t head             physical side of disk
+// return: dsk_err_t                    DSK_ERR_OK if successful
+//==============================================================================
+static dsk_err_t fast_copy_track (dsk_pcyl_t cyl, dsk_phead_t head)
+{
+ dsk_err_t dsk_err;
+ int fside = -1;
+
+ // set data rate and MFM/FM mode for input
+ dg.dg_datarate = xdg.dg_idatarate;
+ dg.dg_fm = xdg.dg_ifm;
+
+ if (create_skew_table(xdg.dg_skew_val, xdg.dg_skew_ofs, dg.dg_sectors) == -1)
+    return DSK_ERR_NOMEM;
+
+ dsk_err = sim_ptread(idrive, &dg, buf, cyl, head);
+ if (dsk_err != DSK_ERR_OK)
+    return dsk_err;
+
+ progress.sectors += dg.dg_sectors;
+ progress.bytes += (uint64_t)dg.dg_sectors * dg.dg_secsize;
+ progress_sector(cyl, head, dg.dg_sectors - 1);
+
+ if (raw_outf)
+    dsk_err = raw_output_write(cyl, head);
+ else
+    {
+     if (! disk.noformat)
+        fside = format_side_id(head, head);
+     if (pipe_active)
+        pipeline_put(cyl, head, head, fside);
+     else
+        {
+         if (fside != -1)
+            dsk_err = format_track(&dg, cyl, head, fside);
+         if (dsk_err == DSK_ERR_OK)
+            dsk_err = write_buffered_track(&dg, buf, skew_table,
+            cyl, cyl, head, head);
+        }
+    }
+
+ if (dsk_err == DSK_ERR_OK)
+    fast_copy_info_track(cyl, head);
+
+ return dsk_err;
+}
+
+//==============================================================================
+// Copy one disk/image(s).
+//
+// Retries (3 levels) - An explanation of how the 3 levels of retries works
+// is provided here:
+//
+// LibDsk (level 1)
+// ----------------
+// A LibDsk retry level is set here to help make sure there is plenty of
+// time for a sector to be read successufully at the LibDsk level.  This
+// should not be set to a too low value as it causes many soft errors and
+// possibly causes read problems on some disks (especially Microbee disks). 
+// The value can be changed using the --retry-l1 option if required.
+//
+// read_sector() (level 2)
+// -----------------------
+// The 2nd level of retries are performed in read_sector() which can be
+// changed using the --level-l2 option if required.  If the LibDsk retries
+// fail then this retry level comes into play.
+//
+// read_sector_retry() (level 3)
+// -----------------------------
+// If level 2 fails to read a sector then this last level comes into play.
+//
+// If the Unattended mode is in use (default) then some more retries (with
+// and without T0 seeks), ignore or abort operations will come into play. 
+// The exact way this works depends on the count of previous errors and seek
+// counts that have already occured.
+//
+// If interactive mode is in use then the operator has complete control and
+// makes a selection when prompted for the next course of action.
+//
+//   pass: void
+// return: int                          0 if no error, else -1
+//==============================================================================
+static int copy_disk_data (void)
+{
+ dsk_err_t dsk_err = DSK_ERR_OK;
+ DSK_FORMAT sector_id; 
+
+ uint8_t *p;
+ dsk_pcyl_t cyl;
+ dsk_ltrack_t trk; 
+ dsk_phead_t head; 
+ int xhead;
+
+ char trk_str[5001]; 
+ int trk_str_len;
+ char fmt_name[200];
+
+ int xsecsize;
+ int lsect;
+ int psect;
+ int fside;
+ int fast;
+ int trk_resume;
+ int trk_errors;
+ int trk_retries;
+ uint64_t t;
+ int aborted = 0;
+ int res;
+
+ disk.write_error_count = 0;
+ copy_aborted = 0;
+
+ // sectors voted on are listed in the info file
+ free(vote_list);
+ vote_list = NULL;
+ vote_count = 0;
+ vote_size = 0;
+ 
+ if (open_drives() == -1)
+    return -1;
+
+ if (override_values() != DSK_ERR_OK)
+    return -1;
+
+ event_phase("open");
+ if (events_active())
+    event_emit("detect", "\"format\":%s,\"cylinders\":%d,\"heads\":%d,"
+    "\"sectors\":%d,\"secsize\":%d,\"secbase\":%d",
+    event_str(xdg.dg_format_name, fmt_name, sizeof(fmt_name)),
+    (int)dg.dg_cylinders, (int)dg.dg_heads, (int)dg.dg_sectors,
+    (int)dg.dg_secsize, (int)dg.dg_secbase);
+
+ // initialise the info file
+ init_info_file();
+ 
+ // enter a disk description
+ if (enter_disk_description() == -1)
+    return -1;
+
+ if (disk.verbose) 
+    printf("\nCopying disk/image '%s' to '%s'\n", disk.ifile, ofile_name);
+
+ // time spent waiting for a description is not part of any phase
+ event_phase(NULL);
+
+ sect_errors_tot = 0;
+ sect_retries_tot = 0;
+
+ auto_retry_abort = 0;
+ auto_cyl_last = -1;
+ auto_head_last = -1;
+ auto_seeked_count = 0;
+
+ // set starting and finishing cylinder values
+ set_start_finish(&cyl_start, &cyl_finish, &trk_start, &trk_finish);
+
+#if 0
+ printf("\ncyl_start=%d cyl_finish=%d trk_start=%d trk_finish=%d\n",
+ cyl_start, cyl_finish, trk_start, trk_finish);
+ return 0;
+#endif
+
+ // the output digests are only streamed if the output is written by ubeedisk
+ if (out_hash_state == 1)
+    hash_final(&out_hash_ctx, &out_hash_res);
+ out_hash_state = 0;
+
+ // image to image copies that need nothing altered take a fast path.  A
+ // raw output is also written directly when checkpointing so that each
+ // track can be synced to the disk before it is journalled.
+ fast = fast_copy_method();
+ if (fast == FAST_COPY_FILE)
+    return fast_copy_file();
+ if ((fast == FAST_COPY_TRACK || disk.obuffer || checkpoint_possible()) &&
+    raw_output_open() == -1)
+    return -1;
+
+ // work out each track's format values once and reuse them
+ track_plan_init();
+
+ // failed sectors may be queued and retried after the whole disk is read
+ retry_pass = disk.deferred;
+ retry_queue_count = 0;
+ retry_queued = 0;
+
+ // open the checkpoint journal, a resumed copy carries on from it
+ if (checkpoint_open(&trk_resume) == -1)
+    {
+     raw_output_close();
+     track_plan_free();
+     return -1;
+    }
+
+ // format starting tracks that are being skipped (LibDsk insists)
+ if (trk_start > 0 && ! ckpt_resume)
+    {
+     if (disk.verbose)
+        printf("\n");
+     format_track_range(0, trk_start-1);
+    }
+
+ if (disk.verbose)
+    {
+     if (fast == FAST_COPY_TRACK)
+        printf("\nCopying data (fast image copy):\n");
+     else if (disk.noformat || ! output_sup.pformat)
+        printf("\nCopying data:\n");
+     else
+        printf("\nCopying data (with format):\n");
+    }
+
+ // some drives need this or the disk head won't get positioned and we end
+ // up with no data error! (must be done in order definded in function).
+ // A disk that --autodisk has seen become ready only needs the head homed
+ // as the drive has not been left in an error state.
+ if (media_ready)
+    sim_psecid(idrive, &dg, 0, 0, &sector_id);
+ else
+    home_and_reset_input_drive_and_settings(&sector_id);
+ media_ready = 0;
+ 
+ if (disk.verbose > 1)
+    report_dg(&dg);
+
+ // start the writer thread if a pipelined copy was requested
+ if (! raw_outf)
+    pipeline_start();
+ 
+ progress_start(trk_resume);
+
+ for (trk = trk_resume; trk <= trk_finish; trk++)
+    {
+     cyl = trk / dg.dg_heads;
+     head = trk % dg.dg_heads;
+     ckpt_queue_mark = retry_queue_count;
+     progress_track(trk, cyl, head);
+     profile_track(prof, trk, cyl, head);
+     trk_errors = sect_errors_tot;
+     trk_retries = sect_retries_tot;
+     event_track("track_start", trk, cyl, head, -1, 0);
+
+     if (xdg.dg_secbase2c != -1 && cyl >= xdg.dg_secbase2c)
+        dg.dg_secbase = xdg.dg_secbase2s;
+     else   
+        dg.dg_secbase = xdg.dg_secbase1s;
+
+     // fast image copy, if the track can't be read in one go it is copied
+     // the normal way
+     if (fast == FAST_COPY_TRACK && ! aborted &&
+         fast_copy_track(cyl, head) == DSK_ERR_OK)
+        {
+         event_track("track_done", trk, cyl, head, 0, 0);
+         continue;
+        }
+
+     // read first available sector ID to get the side ID
+     if (! aborted)
+        dsk_err = read_sector_id(cyl, head, &xhead, &xsecsize);
+     else
+        {
+         xhead = head + xdg.dg_sideoffs;
+         xsecsize = dg.dg_secsize;
+         dsk_err = DSK_ERR_OK;
+        } 
+
+     // handle special disk formats
+     set_special_disk(cyl, head, xsecsize);
+     
+     // create the skew table everytime as the format may change, the copy
+     // can't go on if there's no memory for the track
+     if (create_skew_table(xdg.dg_skew_val, xdg.dg_skew_ofs,
+        dg.dg_sectors) == -1)
+        {
+         aborted = 1;
+         break;
+        }
+     
+     // format one track, if pipelined the writer thread does the format
+     // just before writing the track
+     fside = -1;
+     if (! disk.noformat && aborted != 2 && ! raw_outf)
+        {
+         fside = format_side_id(head, xhead);
+         if (! pipe_active)
+            dsk_err = format_track(&dg, cyl, head, fside);
+        }
+
+     // read and write one complete track
+     buffered_cylinder = -1;
+     buffered_head = -1;
+     
+     trk_str_len = 0;
+
+     if (dsk_err == DSK_ERR_OK)
+        {
+         // read the track
+         for (lsect = 0; lsect < dg.dg_sectors; lsect++)
+            {
+             // get the skewed physical sector number
+             psect = skew_table[lsect] + dg.dg_secbase;
+         
+             // read sectors and write to info file
+             if (! aborted)
+                {
+                 dsk_err = read_sector_retry(cyl, head, xhead, lsect);
+                 if (disk.verbose > 1)
+                    trk_str_len += sprintf(trk_str + trk_str_len,
+                    " %2d", psect);
+                }
+             else
+                {
+                 // calculate the buffer pointer location
+                 p = buf + dg.dg_secsize * (psect - dg.dg_secbase);
+
+                 // fill the sector buffer location with 0xff
+                 memset(p, 0xff, dg.dg_secsize);
+                 
+                 // unread sector status
+                 sect_errors_tot++;
+                 sect_retry_count = -2;
+                }
+
+             // log the status of each sector read
+             info_file_entry(cyl, head, lsect);
+
+             // if read sector retry returned an abort repsonse
+             if (dsk_err == DSK_ERR_ABORT)
+                {
+                 // set the abort method depending on the output type
+                 aborted = (string_search(no_info_file, disk.otype) == -1)?
+                 1 : 2;
+                 dsk_err = DSK_ERR_OK;
+                } 
+            }
+
+         // output the physcial sector string                
+         if (disk.verbose > 1 && ! aborted)
+            printf("  %s\n", trk_str);
+
+         // read the sectors of a flagged track again and vote on them
+         if (! aborted)
+            vote_track(cyl, head, xhead);
+
+         // a checkpoint record is made for a track that was completely read
+         if (! aborted)
+            checkpoint_record(trk, cyl, head);
+         else if (ckpt_rec)
+            *ckpt_rec = 0;
+
+         // write the buffered track
+         if (aborted != 2)
+            {
+             if (raw_outf)
+                {
+                 t = profile_begin(prof);
+                 dsk_err = raw_output_write(cyl, head);
+                 profile_end(prof, PROFILE_WRITE, trk, t);
+                }
+             else if (pipe_active)
+                pipeline_put(cyl, head, xhead, fside);
+             else
+                dsk_err = write_buffered_track(&dg, buf, skew_table,
+                cyl, cyl, head, xhead);
+            }
+
+         // the pipeline writer thread records the track once written, the
+         // track must be in the output image before it is journalled
+         if (ckptf && ! aborted && ! pipe_active && dsk_err == DSK_ERR_OK &&
+            output_sync() == 0)
+            checkpoint_write(ckptf, ckpt_rec);
+        }
+
+     event_track("track_done", trk, cyl, head, sect_errors_tot - trk_errors,
+     sect_retries_tot - trk_retries);
+    }
+
+ // wait for the writer thread to complete all outstanding tracks
+ pipeline_finish();
+ event_phase("copy");
+
+ // now go back for any sectors that were deferred
+ if (retry_deferred_sectors(aborted) == -1 && ! aborted)
+    aborted = 1;
+ event_phase("deferred");
+
+ progress_end();
+
+ // later times are not part of any track
+ profile_stop(prof);
+
+ if (disk.verbose)
+    printf("\n");
+
+ if (! disk.nofill)
+    {
+     // format remaining tracks that are being skipped
+     if (trk_finish < (dg.dg_cylinders * dg.dg_heads - 1))
+        {
+         if (disk.verbose)
+            printf("\n");
+         format_track_range(trk_finish+1, (dg.dg_cylinders * dg.dg_heads - 1));
+        }
+    }
+ event_phase("fill");
+
+ raw_output_close();
+
+ track_plan_free();
+
+ // the checkpoint journal is kept if the copy did not complete
+ checkpoint_close(aborted);
+
+ // output abort abort message
+ copy_aborted = aborted;
+ if (aborted)
+    {
+     event_emit("abort", "\"reason\":\"%s\"",
+     disk.unattended? "unattended" : "user");
+     if (disk.unattended)
+        printf("\nUnattended mode aborted this disk copy as the"
+               "maximum number of sector\n"
+               "retries were exceeded.  You may need to use the"
+               " --unattended-rab option\n"
+               "to increase the maximum limit.\n");
+     else
+        printf("\nUser aborted this disk copy.\n");
+    }
+
+ res = create_info_file();
+ event_phase("info");
+
+ return res;
+}
+
+//==============================================================================
+// Copy one disk.
+//
+// The copy is made by copy_disk_data() and the start and final summary
+// events are emitted around it (--events).  The timing profile is collected
+// and reported here (--profile) as are the simulated drive totals.  The
+// start of each disk is marked in a trace being recorded (--trace) or the
+// next disk is taken from a trace being replayed (--itype=replay).
+// An output image created in a temporary file (--obuffer) is copied to the
+// output here so a failed copy fails the disk.
+//
+//   pass: void
+// return: int                          0 if no error, else -1
+//==============================================================================
+static int copy_one_disk (void)
+{
+ char in[2100];
+ char out[2100];
+ uint64_t start;
+ char *status;
+ int res;
+
+ static int copies;
+
+ if (trace_replaying())
+    {
+     if (trace_replay_next() == -1)
+        {
+         printf(APPNAME": no more disks in the trace\n");
+         return -1;
+        }
+    }
+ else
+    trace_mark(++copies);
+
+ if (disk.profile)
+    {
+     profile_start(&profile);
+     prof = &profile;
+    }
+
+ sim_reset_stats();
+
+ start = time_get_ms();
+ phase_ms = start;
+ event_emit("copy_start", "\"input\":%s,\"output\":%s",
+ event_str(disk.ifile, in, sizeof(in)), event_str(ofile_name, out,
+ sizeof(out)));
+
+ res = copy_disk_data();
+
+ // an output image created in a temporary file is only complete once it
+ // has been copied to the output
+ if (*output_temp && close_output_files() == -1)
+    res = -1;
+
+ // the time a real drive would have taken (--itype=sim)
+ sim_report();
+
+ // the breakdown of where the time went
+ if (prof)
+    {
+     profile_stop(prof);
+     profile_report(prof, NULL);
+     profile_free(prof);
+     prof = NULL;
+    }
+
+ if (! events_active())
+    return res;
+
+ if (res != 0 && (disk.overwrite == 0 || disk.overwrite == 2))
+    status = "skipped";
+ else if (res != 0)
+    status = "failed";
+ else if (copy_aborted)
+    status = "aborted";
+ else
+    status = "ok";
+
+ event_emit("summary", "\"status\":\"%s\",\"output\":%s,\"errors\":%d,"
+ "\"retries\":%d,\"ms\":%llu", status, event_str(ofile_name, out,
+ sizeof(out)), sect_errors_tot, sect_retries_tot,
+ (unsigned long long)(time_get_ms() - start));
+
+ return res;
+}
+
+//==============================================================================
+// Batch result output.
+//
+// Outputs a batch report line to stdout and to the batch report file if one
+// was requested.
+//
+//   pass: FILE *reportf                report file or NULL
+//         char *fmt, ...
+// return: void
+//==============================================================================
+static void batch_report (FILE *reportf, char *fmt, ...)
+{
+ char s[2000];
+ va_list ap;
+
+ va_start(ap, fmt);
+ vsnprintf(s, sizeof(s), fmt, ap);
+ va_end(ap);
+
+ printf("%s", s);
+ if (reportf)
+    fprintf(reportf, "%s", s);
+}
+
+//==============================================================================
+// Compare function for sorting the batch file names.
+//
+//   pass: const void *a
+//         const void *b
+// return: int                          strcmp() result
+//==============================================================================
+static int batch_name_cmp (const void *a, const void *b)
+{
+ return strcmp(*(char **)a, *(char **)b);
+}
+
+//==============================================================================
+// Build the list of batch input files.
+//
+// If --batch names a directory then all files in it are used except any
+// 'info' and 'error' files that may already exist there, otherwise the value
+// is used as a wildcard pattern (Unices only).  The names are sorted so that
+// the processing order is repeatable.  Names too long for an input file
+// name are reported and left out.
+//
+//   pass: char ***names                returned array of file names
+// return: int                          number of names, else -1 if error
+//==============================================================================
+static int batch_build_list (char ***names)
+{
+ char path[2000];
+ char **list = NULL;
+ char **temp;
+ int count = 0;
+ int l;
+ struct stat st;
+ DIR *dir;
+ struct dirent *entry;
+
+ if (stat(disk.batch, &st) == 0 && S_ISDIR(st.st_mode))
+    {
+     if (! (dir = opendir(disk.batch)))
+        {
+         printf(APPNAME": unable to open batch directory: %s\n", disk.batch);
+         return -1;
+        }
+     while ((entry = readdir(dir)))
+        {
+         snprintf(path, sizeof(path), "%s"SLASHCHAR_STR"%s", disk.batch,
+         entry->d_name);
+         if (stat(path, &st) != 0 || ! S_ISREG(st.st_mode))
+            continue;
+         l = strlen(path);
+         if ((l > 5 && strcmp(path + l - 5, ".info") == 0) ||
+            (l > 4 && strcmp(path + l - 4, ".err") == 0))
+            continue;
+         if (l >= (int)sizeof(disk.ifile))
+            {
+             printf(APPNAME": batch file name is too long, skipped: %s\n",
+             path);
+             continue;
+            }
+         if (! (temp = realloc(list, sizeof(char *) * (count + 1))))
+            break;
+         list = temp;
+         if (! (list[count] = strdup(path)))
+            break;
+         count++;
+        }
+     closedir(dir);
+    }
+ else
+    {
+#ifdef WIN32
+     printf(APPNAME": --batch must be a directory on this system.\n");
+     return -1;
+#else
+     glob_t g;
+     size_t i;
+
+     if (glob(disk.batch, 0, NULL, &g) != 0)
+        {
+         printf(APPNAME": no files match batch pattern: %s\n", disk.batch);
+         return -1;
+        }
+     for (i = 0; i < g.gl_pathc; i++)
+        {
+         if (stat(g.gl_pathv[i], &st) != 0 || ! S_ISREG(st.st_mode))
+            continue;
+         if (strlen(g.gl_pathv[i]) >= sizeof(disk.ifile))
+            {
+             printf(APPNAME": batch file name is too long, skipped: %s\n",
+             g.gl_pathv[i]);
+             continue;
+            }
+         if (! (temp = realloc(list, sizeof(char *) * (count + 1))))
+            break;
+         list = temp;
+         if (! (list[count] = strdup(g.gl_pathv[i])))
+            break;
+         count++;
+        }
+     globfree(&g);
+#endif
+    }
+
+ if (count)
+    qsort(list, count, sizeof(char *), batch_name_cmp);
+
+ *names = list;
+ return count;
+}
+
+//==============================================================================
+// Convert one batch file.
+//
+// Under Unices this is called in a child process so the global state is a
+// private copy for each conversion.  There is no operator present so disk
+// descriptions are not prompted for, read errors are handled unattended and
+// existing output files are skipped unless --force is used.
+//
+//   pass: char *name                   input file name
+//         batch_res_t *res             returned results
+// return: void
+//==============================================================================
+static void batch_convert (char *name, batch_res_t *res)
+{
+ strcpy(disk.ifile, name);
+ set_xtype_xfile(disk.ifile, disk.itype);
+ set_xtype_xfile(disk.ofile, disk.otype);
+ strcpy(ofile_name, disk.ofile);
+
+ disk.enter_desc = 0;
+ disk.unattended = 1;
+ overwrite_flag = disk.force? 1 : 2;
+
+ sect_errors_tot = 0;
+ sect_retries_tot = 0;
+ disk.overwrite = -1;
+
+ res->status = copy_one_disk();
+ if (disk.overwrite == 0 || disk.overwrite == 2)
+    res->status = 1;  // output exists, skipped
+ res->errors = sect_errors_tot;
+ res->retries = sect_retries_tot;
+ close_files();
+}
+
+//==============================================================================
+// Record and report the result of one batch conversion.
+//
+//   pass: FILE *reportf                report file or NULL
+//         char *name                   input file name
+//         int count                    number of files in the batch
+//         batch_res_t *res             conversion result
+//         batch_sum_t *sum             batch totals to be updated
+// return: void
+//==============================================================================
+static void batch_record (FILE *reportf, char *name, int count,
+                          batch_res_t *res, batch_sum_t *sum)
+{
+ sum->done++;
+ switch (res->status)
+    {
+     case 0 :
+        sum->ok++;
+        break;
+     case 1 :
+        sum->skipped++;
+        break;
+     default :
+        sum->failed++;
+        break;
+    }
+ sum->errors += res->errors;
+
+ batch_report(reportf, "[%d/%d] %-7s %s (sector errors: %d, retries: %d)\n",
+ sum->done, count,
+ (res->status == 0)? "ok":(res->status == 1)? "skipped":"FAILED",
+ name, res->errors, res->retries);
+}
+
+//==============================================================================
+// Batch copy disk/image files.
+//
+// Converts all the files named by --batch using the --of value as an output
+// pattern, a '@b' in the pattern is substituted with the input file's base
+// name.  Under Unices a pool of --jobs worker processes is used so that many
+// conversions run at the same time, each worker being a fork of this process
+// so that all option and configuration file parsing is only done once.
+// Under Windows the files are converted one at a time.
+//
+// Each conversion creates it's own 'info' file as normal and one summary
+// report is produced at the end.
+//
+//   pass: void
+// return: int                          0 if no error, else -1
+//==============================================================================
+static int copy_batch (void)
+{
+ char **names;
+ FILE *reportf = NULL;
+ batch_res_t res;
+ batch_sum_t sum;
+ uint64_t start_ms = time_get_ms();
+ int count;
+ int jobs;
+ int i;
+#ifndef WIN32
+ pid_t pid[BATCH_JOBS_MAX];
+ int fd[BATCH_JOBS_MAX];
+ int idx[BATCH_JOBS_MAX];
+ int pfd[2];
+ int running = 0;
+ int next = 0;
+ int status;
+ int j;
+#endif
+
+ memset(&sum, 0, sizeof(sum));
+
+ if (! strstr(disk.ofile, "@b"))
+    {
+     printf(APPNAME": --batch requires an --of pattern containing '@b'.\n");
+     return -1;
+    }
+
+ if ((count = batch_build_list(&names)) < 1)
+    {
+     if (count == 0)
+        printf(APPNAME": no files found for batch: %s\n", disk.batch);
+     return -1;
+    }
+
+ if (disk.batch_report[0] && ! (reportf = fopen(disk.batch_report, "w")))
+    printf(APPNAME": unable to create batch report: %s\n", disk.batch_report);
+
+ jobs = disk.jobs;
+#ifdef WIN32
+ jobs = 1;
+#else
+ if (jobs < 1)
+    jobs = sysconf(_SC_NPROCESSORS_ONLN);
+ if (jobs < 1)
+    jobs = 1;
+ if (jobs > BATCH_JOBS_MAX)
+    jobs = BATCH_JOBS_MAX;
+#endif
+
+ batch_report(reportf, "Batch: %d files, %d jobs\n\n", count, jobs);
+
+#ifdef WIN32
+ for (i = 0; i < count; i++)
+    {
+     memset(&res, 0, sizeof(res));
+     batch_convert(names[i], &res);
+     batch_record(reportf, names[i], count, &res, &sum);
+    }
+#else
+ // worker processes must not see any keyboard input or produce progress
+ // output as many run at once
+ disk.verbose = (disk.verbose > 1)? disk.verbose : 0;
+
+ while (sum.done < count)
+    {
+     // start workers until the pool is full
+     while (running < jobs && next < count)
+        {
+         if (pipe(pfd) != 0)
+            break;
+         fflush(stdout);
+         if ((pid[running] = fork()) == 0)
+            {
+             close(pfd[0]);
+             if (! freopen("/dev/null", "r", stdin))
+                {} // ignore result
+             memset(&res, 0, sizeof(res));
+             batch_convert(names[next], &res);
+             if (write(pfd[1], &res, sizeof(res)) != sizeof(res))
+                {} // ignore result
+             fflush(stdout);
+             events_close();
+             _exit(0);
+            }
+         close(pfd[1]);
+         if (pid[running] == -1)
+            {
+             close(pfd[0]);
+             break;
+            }
+         fd[running] = pfd[0];
+         idx[running] = next++;
+         running++;
+        }
+
+     if (! running)
+        {
+         printf(APPNAME": copy_batch() - unable to start worker process.\n");
+         break;
+        }
+
+     // wait for any worker to finish and collect the results
+     if ((i = wait(&status)) == -1)
+        break;
+     for (j = 0; j < running && pid[j] != i; j++)
+        ;
+     if (j == running)
+        continue;
+
+     if (read(fd[j], &res, sizeof(res)) != sizeof(res))
+        {
+         res.status = -1;
+         res.errors = 0;
+         res.retries = 0;
+        }
+     close(fd[j]);
+     batch_record(reportf, names[idx[j]], count, &res, &sum);
+
+     running--;
+     pid[j] = pid[running];
+     fd[j] = fd[running];
+     idx[j] = idx[running];
+    }
+#endif
+
+ batch_report(reportf, "\nBATCH SUMMARY\n");
+ batch_report(reportf, "-------------\n");
+ batch_report(reportf, "Files              %d\n", count);
+ batch_report(reportf, "Converted          %d\n", sum.ok);
+ batch_report(reportf, "Skipped (exists)   %d\n", sum.skipped);
+ batch_report(reportf, "Failed             %d\n", sum.failed);
+ batch_report(reportf, "Not processed      %d\n", count - sum.done);
+ batch_report(reportf, "Sector errors      %d\n", sum.errors);
+ batch_report(reportf, "Elapsed time (s)   %.1f\n",
+ (time_get_ms() - start_ms) / 1000.0);
+
+ if (reportf)
+    fclose(reportf);
+
+ for (i = 0; i < count; i++)
+    free(names[i]);
+ free(names);
+
+ return (sum.failed || sum.done < count)? -1 : 0;
+}
+
+//==============================================================================
+// Create the output file name for a disk when copying several disks.
+//
+// The disk number is inserted before the file name extension.
+//
+//   pass: char *ofile                  output file name from --of
+//         int count                    disk number
+//         char *name                   returned file name
+// return: void
+//==============================================================================
+static void count_file_name (char *ofile, int count, char *name)
+{
+ char b_str[1000];
+ char e_str[1000];
+ char *p;
+
+ p = strstr(ofile, ".");
+ if (p)
+    {
+     strncpy(b_str, ofile, (p - ofile));
+     b_str[(p - ofile)] = 0;
+     strcpy(e_str, p);
+    }
+ else
+    {
+     strcpy(b_str, ofile);
+     e_str[0] = 0;
+    } 
+
+ sprintf(name, "%s%03d%s", b_str, count, e_str);
+}
+
+#ifndef WIN32
+//==============================================================================
+// Drive pair worker thread.
+//
+// Copies disks from one drive pair using a copy of the session configured
+// by the options.  There is no operator to answer prompts from this thread
+// so disk descriptions are not asked for, errors are handled unattended and
+// existing output files are skipped unless --force is used.  When copying
+// several disks (--count) the thread waits for the operator to select the
+// pair from the status display before each disk.
+//
+//   pass: void *arg                    drive pair (pair_t *)
+// return: void *                       NULL
+//==============================================================================
+static void *pair_worker (void *arg)
+{
+ pair_t *pp = arg;
+ char prefix[20];
+ int count;
+ int res;
+
+ session_load(&pp->session);
+ pair_cur = pp;
+
+ sprintf(prefix, "[%d] ", pp->num);
+ console_set_prefix(prefix);
+ events_set_pair(pp->num);
+
+ strcpy(disk.ifile, pp->ifile);
+ strcpy(disk.ofile, pp->ofile);
+ set_xtype_xfile(disk.ifile, disk.itype);
+ set_xtype_xfile(disk.ofile, disk.otype);
+
+ disk.enter_desc = 0;
+ disk.unattended = 1;
+ disk.verbose = (disk.verbose > 1)? disk.verbose : 0;
+ overwrite_flag = disk.force? 1 : 2;
+
+ count = disk.count;
+
+ for (;;)
+    {
+     pthread_mutex_lock(&pair_mutex);
+     if (count >= 0)
+        {
+         // wait for the operator to place the next disk
+         pp->state = PAIR_WAIT;
+         while (! pp->start && ! pp->stop)
+            pthread_cond_wait(&pair_cond, &pair_mutex);
+         if (pp->stop)
+            {
+             pthread_mutex_unlock(&pair_mutex);
+             break;
+            }
+         count_file_name(disk.ofile, count, ofile_name);
+        }
+     else
+        strcpy(ofile_name, disk.ofile);
+     pp->start = 0;
+     pp->abort = 0;
+     pp->trk = 0;
+     pp->trks = 0;
+     pp->errors = 0;
+     pp->state = PAIR_COPY;
+     strcpy(pp->ofile_name, ofile_name);
+     pthread_mutex_unlock(&pair_mutex);
+
+     sect_errors_tot = 0;
+     sect_retries_tot = 0;
+     disk.overwrite = -1;
+
+     if (strcmp(disk.ifile, ofile_name) == 0)
+        res = -1;
+     else
+        res = copy_one_disk();
+
+     pthread_mutex_lock(&pair_mutex);
+     pp->disks++;
+     if (disk.overwrite == 0 || disk.overwrite == 2)
+        pp->skipped++;
+     else if (res == 0)
+        pp->ok++;
+     else
+        pp->failed++;
+     pp->errors_tot += sect_errors_tot;
+     pp->retries_tot += sect_retries_tot;
+     pthread_mutex_unlock(&pair_mutex);
+
+     printf("%s %s (sector errors: %d, retries: %d)\n", ofile_name,
+     (disk.overwrite == 0 || disk.overwrite == 2)? "skipped (exists)" :
+     (res == 0)? "ok" : "FAILED", sect_errors_tot, sect_retries_tot);
+
+     close_files();
+
+     if (count < 0)
+        break;
+     count++;
+    }
+
+ pthread_mutex_lock(&pair_mutex);
+ pp->state = PAIR_DONE;
+ pthread_mutex_unlock(&pair_mutex);
+
+ return NULL;
+}
+
+//==============================================================================
+// Remove the drive pair status display.
+//
+// Called with the console locked before any other output is printed.  The
+// cursor is always left at the start of the display.
+//
+//   pass: void
+// return: void
+//==============================================================================
+static void pair_status_clear (void)
+{
+ if (! pair_lines)
+    return;
+ fputs("\r\033[J", stdout);
+ pair_lines = 0;
+}
 
- sect_errors_tot = 0;
- sect_retries_tot = 0;
+//==============================================================================
+// Show the drive pair status display.
+//
+// One line is shown for each pair below any other output.  The cursor is
+// moved back to the start of the display so the next output or update
+// replaces it.  The file names are cut short so the lines fit in 79
+// columns.
+//
+//   pass: void
+// return: void
+//==============================================================================
+static void pair_status_draw (void)
+{
+ char s[1000];
+ pair_t *pp;
+ int i;
 
- auto_retry_abort = 0;
- auto_cyl_last = -1;
- auto_head_last = -1;
- auto_seeked_count = 0;
+ console_lock();
+ pthread_mutex_lock(&pair_mutex);
 
- // set starting and finishing cylinder values
- set_start_finish(&cyl_start, &cyl_finish, &trk_start, &trk_finish);
+ fputs("\r\033[J", stdout);
+ for (i = 0; i < pair_count; i++)
+    {
+     pp = &pair_list[i];
+     switch (pp->state)
+        {
+         case PAIR_WAIT :
+            snprintf(s, sizeof(s), "[%d] %.50s: insert disk and press %d",
+            pp->num, pp->ifile, pp->num);
+            break;
+         case PAIR_COPY :
+            snprintf(s, sizeof(s), "[%d] %.18s -> %.18s  track %d/%d"
+            "  errors %d%s",
+            pp->num, pp->ifile, pp->ofile_name, pp->trk, pp->trks,
+            pp->errors, pp->abort? "  aborting" : "");
+            break;
+         default :
+            snprintf(s, sizeof(s), "[%d] %.50s: done", pp->num, pp->ifile);
+            break;
+        }
+     fprintf(stdout, "%-79.79s\n", s);
+    }
+ fprintf(stdout, "%-79.79s", "Keys: 1-n next disk, A then 1-n abort copy,"
+         " E finish");
+ fprintf(stdout, "\r\033[%dA", pair_count);
+ fflush(stdout);
+ pair_lines = pair_count + 1;
 
-#if 0
- printf("\ncyl_start=%d cyl_finish=%d trk_start=%d trk_finish=%d\n",
- cyl_start, cyl_finish, trk_start, trk_finish);
- return 0;
+ pthread_mutex_unlock(&pair_mutex);
+ console_unlock();
+}
 #endif
 
- // format starting tracks that are being skipped (LibDsk insists)
- if (trk_start > 0)
+//==============================================================================
+// Copy disks from several drive pairs at once.
+//
+// Each --pair input/output is copied by it's own worker thread so that all
+// the drives are kept busy while the operator changes the disk in another.
+// The console is shared, lines printed by a worker are prefixed with the
+// pair number and a status line for each pair is kept at the bottom of a
+// terminal.  The operator uses single key presses to start the next disk in
+// a pair, abort a copy or finish.  A summary for all the pairs is shown at
+// the end.
+//
+//   pass: void
+// return: int                          0 if no error, else -1
+//==============================================================================
+static int copy_pairs (void)
+{
+#ifdef WIN32
+ printf(APPNAME": --pair is not supported on this system.\n");
+ return -1;
+#else
+ pair_t *pp;
+ uint64_t start_ms = time_get_ms();
+ int tty = isatty(fileno(stdout));
+ int state_last[PAIRS_MAX];
+ int abort_key = 0;
+ int running;
+ int failed = 0;
+ int key;
+ int i;
+ int j;
+ char *p;
+
+ if (! (pair_list = calloc(disk.pairs, sizeof(pair_t))))
     {
-     if (disk.verbose)
-        printf("\n");
-     format_track_range(0, trk_start-1);
+     printf(APPNAME": copy_pairs() - no memory.\n");
+     return -1;
     }
+ pair_count = disk.pairs;
 
- if (disk.verbose)
+ // split each pair into it's input and output names
+ for (i = 0; i < pair_count; i++)
     {
-     if (disk.noformat || ! output_sup.pformat)
-        printf("\nCopying data:\n");
-     else
-        printf("\nCopying data (with format):\n");
+     pp = &pair_list[i];
+     pp->num = i + 1;
+     p = strchr(disk.pair[i], ',');
+     if (! p || p == disk.pair[i] || ! p[1] ||
+        (p - disk.pair[i]) >= (int)sizeof(pp->ifile) ||
+        strlen(p + 1) >= sizeof(pp->ofile))
+        {
+         printf(APPNAME": --pair requires input and output names: %s\n",
+                disk.pair[i]);
+         free(pair_list);
+         return -1;
+        }
+     memcpy(pp->ifile, disk.pair[i], p - disk.pair[i]);
+     strcpy(pp->ofile, p + 1);
+     for (j = 0; j < i; j++)
+        if (strcmp(pp->ifile, pair_list[j].ifile) == 0 ||
+           strcmp(pp->ofile, pair_list[j].ofile) == 0)
+           {
+            printf(APPNAME": --pair input and output names must be"
+                   " different for each pair.\n");
+            free(pair_list);
+            return -1;
+           }
+     if (strcmp(pp->ifile, pp->ofile) == 0)
+        {
+         printf(APPNAME": input and output file names must be different!\n");
+         free(pair_list);
+         return -1;
+        }
     }
 
- // some drives need this or the disk head won't get positioned and we end
- // up with no data error! (must be done in order definded in function)
- home_and_reset_input_drive_and_settings(&sector_id);
- 
- if (disk.verbose > 1)
-    report_dg(&dg);
- 
- for (trk = trk_start; trk <= trk_finish; trk++)
-    {
-     cyl = trk / dg.dg_heads;
-     head = trk % dg.dg_heads;
+ printf("Drive pairs: %d\n", pair_count);
+ for (i = 0; i < pair_count; i++)
+    printf("[%d] %s -> %s\n", i + 1, pair_list[i].ifile, pair_list[i].ofile);
+ if (disk.count >= 0)
+    printf("Press 1-%d to copy the next disk in a pair.\n", pair_count);
+ printf("Press A then 1-%d to abort a copy, E to finish.\n\n", pair_count);
 
-     if (xdg.dg_secbase2c != -1 && cyl >= xdg.dg_secbase2c)
-        dg.dg_secbase = xdg.dg_secbase2s;
-     else   
-        dg.dg_secbase = xdg.dg_secbase1s;
+ if (tty)
+    console_set_clear(pair_status_clear);
 
-     // read first available sector ID to get the side ID
-     if (! aborted)
-        dsk_err = read_sector_id(cyl, head, &xhead, &xsecsize);
-     else
+ // start a worker for each pair, each gets it's own copy of the session
+ for (i = 0; i < pair_count; i++)
+    {
+     pp = &pair_list[i];
+     pp->state = (disk.count >= 0)? PAIR_WAIT : PAIR_COPY;
+     state_last[i] = -1;
+     session_save(&pp->session);
+     if (pthread_create(&pp->thread, NULL, pair_worker, pp) != 0)
         {
-         xhead = head + xdg.dg_sideoffs;
-         xsecsize = dg.dg_secsize;
-         dsk_err = DSK_ERR_OK;
-        } 
+         printf(APPNAME": copy_pairs() - unable to start thread for pair"
+                " %d.\n", pp->num);
+         pp->state = PAIR_DONE;
+         pp->failed++;
+         pp->thread = pthread_self();
+        }
+    }
 
-     // handle special disk formats
-     set_special_disk(cyl, head, xsecsize);
-     
-     // create the skew table everytime as the format may change
-     create_skew_table(xdg.dg_skew_val, xdg.dg_skew_ofs, dg.dg_sectors);
-     
-     // format one track
-     if (! disk.noformat && aborted != 2)
+ for (;;)
+    {
+     pthread_mutex_lock(&pair_mutex);
+     for (i = 0, running = 0; i < pair_count; i++)
         {
-         switch (disk.forceside)
+         if (pair_list[i].state != PAIR_DONE)
+            running++;
+         // without a terminal only the changes are shown
+         if (! tty && pair_list[i].state != state_last[i])
             {
-             case 0 : // off
-                // follow the input sector header ID value (xhead) if a
-                // true psecid supported or xdg.dg_sideoffs is set
-                if (input_sup.psecid || xdg.dg_sideoffs)
-                   dsk_err = format_track(cyl, head, xhead);
-                else
-                   // else the format's side1as0 value will determine
-                   dsk_err = format_track(cyl, head, xhead &
-                   (1 ^ xdg.dg_side1as0));
-                break;
-             case 1 : // on
-                // force side ID to be equal to the physical side
-                dsk_err = format_track(cyl, head, head);
-                break;
-             case 2 : // 00
-                dsk_err = format_track(cyl, head, 0);
-                break;
-             case 3 : // 01
-                if (head == 0)
-                   dsk_err = format_track(cyl, head, 0);
-                else
-                   dsk_err = format_track(cyl, head, 1);
-                break;
-             case 4 : // 10
-                if (head == 0)
-                   dsk_err = format_track(cyl, head, 1);
-                else
-                   dsk_err = format_track(cyl, head, 0);
-                break;
-             case 5 : // 11
-                dsk_err = format_track(cyl, head, 1);
-                break;
+             state_last[i] = pair_list[i].state;
+             if (state_last[i] == PAIR_WAIT)
+                printf("[%d] %s: insert disk and press %d\n", i + 1,
+                pair_list[i].ifile, i + 1);
             }
         }
+     pthread_mutex_unlock(&pair_mutex);
 
-     // read and write one complete track
-     buffered_cylinder = -1;
-     buffered_head = -1;
-     
-     trk_str_len = 0;
+     if (! running)
+        break;
 
-     if (dsk_err == DSK_ERR_OK)
+     if (tty)
+        pair_status_draw();
+
+     // operator keys
+     while ((key = get_key()) != -1)
         {
-         // read the track
-         for (lsect = 0; lsect < dg.dg_sectors; lsect++)
+         key = toupper(key);
+         pthread_mutex_lock(&pair_mutex);
+         if (key == 'A')
+            abort_key = 1;
+         else if (key == 'E')
             {
-             // get the skewed physical sector number
-             psect = skew_table[lsect] + dg.dg_secbase;
-         
-             // read sectors and write to info file
-             if (! aborted)
+             for (i = 0; i < pair_count; i++)
+                pair_list[i].stop = 1;
+             abort_key = 0;
+            }
+         else if (key >= '1' && key < '1' + pair_count)
+            {
+             pp = &pair_list[key - '1'];
+             if (abort_key)
                 {
-                 dsk_err = read_sector_retry(cyl, head, xhead, lsect);
-                 if (disk.verbose > 1)
-                    trk_str_len += sprintf(trk_str + trk_str_len,
-                    " %2d", psect);
+                 if (pp->state == PAIR_COPY)
+                    pp->abort = 1;
                 }
-             else
-                {
-                 // calculate the buffer pointer location
-                 p = buf + dg.dg_secsize * (psect - dg.dg_secbase);
+             else if (pp->state == PAIR_WAIT)
+                pp->start = 1;
+             abort_key = 0;
+            }
+         pthread_cond_broadcast(&pair_cond);
+         pthread_mutex_unlock(&pair_mutex);
+        }
 
-                 // fill the sector buffer location with 0xff
-                 memset(p, 0xff, dg.dg_secsize);
-                 
-                 // unread sector status
-                 sect_errors_tot++;
-                 sect_retry_count = -2;
-                }
+     sleep_ms(250);
+    }
 
-             // log the status of each sector read
-             info_file_entry(cyl, head, lsect);
+ for (i = 0; i < pair_count; i++)
+    if (! pthread_equal(pair_list[i].thread, pthread_self()))
+       pthread_join(pair_list[i].thread, NULL);
 
-             // if read sector retry returned an abort repsonse
-             if (dsk_err == DSK_ERR_ABORT)
-                {
-                 // set the abort method depending on the output type
-                 aborted = (string_search(no_info_file, disk.otype) == -1)?
-                 1 : 2;
-                 dsk_err = DSK_ERR_OK;
-                } 
-            }
+ console_set_clear(NULL);
+ if (tty)
+    {
+     console_lock();
+     pair_status_clear();
+     console_unlock();
+    }
 
-         // output the physcial sector string                
-         if (disk.verbose > 1 && ! aborted)
-            printf("  %s\n", trk_str);
+ printf("\nDRIVE PAIR SUMMARY\n");
+ printf("------------------\n");
+ printf("Pair  Disks  Copied  Skipped  Failed  Errors  Retries  Input\n");
+ for (i = 0; i < pair_count; i++)
+    {
+     pp = &pair_list[i];
+     printf("%3d   %5d   %5d    %5d   %5d  %6d   %6d  %s\n", pp->num,
+     pp->disks, pp->ok, pp->skipped, pp->failed, pp->errors_tot,
+     pp->retries_tot, pp->ifile);
+     failed += pp->failed;
+    }
+ printf("Elapsed time (s)   %.1f\n", (time_get_ms() - start_ms) / 1000.0);
 
-         // write the buffered track
-         if (aborted != 2)
-            write_buffered_track(cyl, cyl, head, xhead);
-        }
+ free(pair_list);
+ pair_list = NULL;
+ pair_count = 0;
+
+ return failed? -1 : 0;
+#endif
+}
+
+//==============================================================================
+// Wait for the next disk to be placed into the input drive (--autodisk).
+//
+// The input drive is opened if needed and then kept open, it's status is
+// polled until a disk has been removed (if required) and a disk has then
+// been ready for MEDIA_SETTLE_MS so that the operator has finished with the
+// drive door.  ENTER starts the copy at once, 'e' or ESC exits.
+//
+//   pass: int removed                  1 if the last disk must be removed
+// return: int                          0 if a disk is ready, 1 if the drive
+//                                      status can't be used, -1 to exit, -2
+//                                      if the input drive can't be opened
+//==============================================================================
+static int media_wait (int removed)
+{
+ dsk_err_t dsk_err;
+ unsigned char st;
+ uint64_t ready_ms = 0;
+ int key;
+
+ if (string_search(media_wait_types, disk.itype) == -1)
+    return 1;
+
+ if (! idrive)
+    {
+     format_set("default", 0);
+     if (check_input_drive() == -1 || open_input_drive() != 0)
+        return -2;
     }
 
- if (disk.verbose)
-    printf("\n");
+ printf("Waiting for a disk in drive '%s', ENTER to start or 'e' to exit: ",
+        disk.ifile);
+ fflush(stdout);
 
- if (! disk.nofill)
+ for (;;)
     {
-     // format remaining tracks that are being skipped
-     if (trk_finish < (dg.dg_cylinders * dg.dg_heads - 1))
+     dsk_err = sim_drive_status(idrive, &dg, 0, &st);
+     if (dsk_err != DSK_ERR_OK)
         {
-         if (disk.verbose)
-            printf("\n");
-         format_track_range(trk_finish+1, (dg.dg_cylinders * dg.dg_heads - 1));
+         printf("\n");
+         return 1;
         }
-    }
 
- // output abort abort message
- if (aborted)
-    {
-     if (disk.unattended)
-        printf("\nUnattended mode aborted this disk copy as the"
-               "maximum number of sector\n"
-               "retries were exceeded.  You may need to use the"
-               " --unattended-rab option\n"
-               "to increase the maximum limit.\n");
-     else
-        printf("\nUser aborted this disk copy.\n");
+     if (! (st & DSK_ST3_READY))
+        {
+         removed = 0;
+         ready_ms = 0;
+        }
+     else if (! removed)
+        {
+         if (! ready_ms)
+            ready_ms = time_get_ms();
+         else if (time_get_ms() - ready_ms >= MEDIA_SETTLE_MS)
+            break;
+        }
+
+     key = get_key();
+     if (key == 13)
+        break;
+     if (key == ESC || toupper(key) == 'E')
+        {
+         printf("\n");
+         return -1;
+        }
+
+     sleep_ms(MEDIA_POLL_MS);
     }
 
- return create_info_file();    
+ printf("\n");
+ media_ready = 1;
+ return 0;
 }
 
 //==============================================================================
@@ -4796,15 +9516,21 @@ static int copy_one_disk (void)
 static int copy_disks (void)
 {
  char user[100];
- char b_str[1000];
- char e_str[1000];
- char *p;
+ int autodisk;
  int i;
  int l;
  int count;
  int res;
 
  overwrite_flag = -1;
+
+ // convert a batch of image files
+ if (disk.batch[0])
+    return copy_batch();
+
+ // copy from several drives at once
+ if (disk.pairs)
+    return copy_pairs();
  
  // set input and output types based on input and output names
  set_xtype_xfile(disk.ifile, disk.itype);
@@ -4852,25 +9578,13 @@ static int copy_disks (void)
 
  // prompt user for each disk to be copied (verbose has no affect here)
  count = disk.count;
- 
- p = strstr(disk.ofile, ".");
- if (p)
-    {
-     strncpy(b_str, disk.ofile, (p - disk.ofile));
-     b_str[(p - disk.ofile)] = 0;
-     strcpy(e_str, p);
-    }
- else
-    {
-     strcpy(b_str, disk.ofile);
-     e_str[0] = 0;
-    } 
+ autodisk = disk.autodisk;
 
  for (;;)
     {
      printf("\n");
 
-     sprintf(ofile_name, "%s%03d%s", b_str, count, e_str);
+     count_file_name(disk.ofile, count, ofile_name);
 
      if (strcmp(disk.ifile, ofile_name) == 0)
         {
@@ -4886,8 +9600,33 @@ static int copy_disks (void)
         putchar('=');
      printf("\n\n");
 
-     // prompt the user to insert disk or exit
+     // wait for the disk to be changed if the drive's status can be used,
+     // the first disk may already be in the drive
      user[0] = 0;
+     if (autodisk)
+        {
+         res = media_wait(count != disk.count);
+         if (res == -2)
+            {
+             close_files();
+             return -1;
+            }
+         if (res == -1)
+            {
+             close_files();
+             return 0;
+            }
+         if (res == 0)
+            strcpy(user, "\n");
+         else
+            {
+             printf(APPNAME": the drive status for '%s' can't be polled,"
+                    " --autodisk not used.\n", disk.ifile);
+             autodisk = 0;
+            }
+        }
+
+     // prompt the user to insert disk or exit
      while ((strcmp("\n", user) != 0) && (strcmp("e\n", user) != 0) &&
         (strcmp("E\n", user) != 0))
         {
@@ -4911,11 +9650,18 @@ static int copy_disks (void)
              printf("       Retry total: %d\n", sect_retries_tot);
             }
          
-         close_files();
+         // --autodisk keeps the input drive open for the next disk
+         if (autodisk)
+            close_output_files();
+         else
+            close_files();
          count++;
         }
      else
-        return 0;
+        {
+         close_files();
+         return 0;
+        }
     } 
 }
 
@@ -5070,6 +9816,24 @@ int main (int argc, char *argv[])
     printf(APPNAME": Warning - The configuration file is an older "
     "version: %s\n", config_vers);
 
+ // open the events stream for a supervising program
+ if (exitstatus == 0 && *disk.events && events_open(disk.events) == -1)
+    exitstatus = -1;
+
+ // record or replay a trace of the LibDsk calls
+ if (exitstatus == 0 && (*disk.trace || ! strcmp(disk.itype, "replay")) &&
+ (disk.pairs || *disk.batch))
+    {
+     printf(APPNAME": --trace and --itype=replay can not be used with --pair"
+     " or --batch\n");
+     exitstatus = -1;
+    }
+ if (exitstatus == 0 && *disk.trace && trace_record_open(disk.trace) == -1)
+    exitstatus = -1;
+ if (exitstatus == 0 && ! strcmp(disk.itype, "replay") &&
+ trace_replay_open(disk.ifile) == -1)
+    exitstatus = -1;
+
  if (exitstatus != 0)
     res = EXIT_FAILURE;
  else
@@ -5100,11 +9864,24 @@ int main (int argc, char *argv[])
          case UBEEDISK_CLEAN : // disk head clean
             res = disk_clean('c', 0);
             break;
+         case UBEEDISK_BENCH : // benchmarks
+            res = disk_bench();
+            break;
+         case UBEEDISK_PLAN : // skew planning
+            res = disk_plan();
+            break;
+         case UBEEDISK_CALIBRATE : // skew calibration
+            res = disk_calibrate();
+            break;
         }
 
      res = (res == 0)? EXIT_SUCCESS:EXIT_FAILURE;
     }
 
+ // all events are written out before exiting
+ events_close();
+ trace_close();
+
  // de-initialise the functions module
  functions_deinit();
 
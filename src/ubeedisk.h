@@ -5,6 +5,21 @@
 
 #include <libdsk.h>
 
+#include "infomap.h"
+#include "profile.h"
+
+#ifndef WIN32
+#include <pthread.h>
+#endif
+
+// storage class for the state owned by a copy/scan/detect session.  Each
+// thread has it's own instance so sessions can run concurrently.
+#if defined(__GNUC__) || defined(__clang__)
+#define SESSION_LOCAL __thread
+#else
+#define SESSION_LOCAL _Thread_local
+#endif
+
 void report_dg (DSK_GEOMETRY *dg);
 void close_files (void);
 dsk_err_t override_values (void);
@@ -34,8 +49,18 @@ void close_reopen_pc_floppy_input_drive (void);
 #endif
 
 #define SSIZE1 512
-#define INFO_SIZE 100000
 #define PSKEW_SIZE 256
+#define BUFFERED_ERRORS_MAX 3
+#define PIPELINE_MAX 64
+#define BATCH_JOBS_MAX 256
+#define FAST_COPY_BLOCK 1048576
+#define CKPT_RECORD_SIZE 65536
+#define CKPT_ID "UBEEDISK CHECKPOINT 2"
+#define VOTE_MAX 15
+#define PAIRS_MAX 8
+#define MEDIA_POLL_MS 250
+#define MEDIA_SETTLE_MS 1000
+#define PROGRESS_MS 100
 
 #define DESC_LINES 100
 #define DESC_CHARS 100
@@ -50,7 +75,49 @@ enum
  UBEEDISK_SCAN,
  UBEEDISK_FORMAT,
  UBEEDISK_SPEED,
- UBEEDISK_CLEAN
+ UBEEDISK_CLEAN,
+ UBEEDISK_BENCH,
+ UBEEDISK_PLAN,
+ UBEEDISK_CALIBRATE
+};
+
+// --disk=bench helper microbenchmarks
+enum
+{
+ BENCH_SKEW,
+ BENCH_FORMAT,
+ BENCH_TRACK_SIZE,
+ BENCH_MD5
+};
+
+#define BENCH_MIN_NS 50000000     // shortest batch of operations timed
+#define BENCH_BLOCK 65536         // bytes per md5_process_block() operation
+
+// --disk=plan rotational model
+#define PLAN_TURNAROUND_US 1000   // default host/controller turnaround time
+#define PLAN_STEP_US 6000         // step to the next cylinder
+#define PLAN_SETTLE_US 15000      // head settle time after stepping
+
+#define CALIBRATE_READS 3         // --disk=calibrate reads of each skew
+
+enum
+{
+ FAST_COPY_NONE,
+ FAST_COPY_TRACK,
+ FAST_COPY_FILE
+};
+
+enum
+{
+ VOTE_RETRIED,
+ VOTE_TRACK
+};
+
+enum
+{
+ PAIR_WAIT,
+ PAIR_COPY,
+ PAIR_DONE
 };
 
 typedef struct ubd_t
@@ -62,26 +129,37 @@ typedef struct ubd_t
 typedef struct disk_t
 {
  int append_error;
+ int autodisk;
+ char batch[1000];
+ char batch_report[1000];
  int iautorate;
  int oautorate;
  int cacher;
  int cachew;
+ int checkpoint;
  int count;
+ int deferred;
  int detect;
  int disk;
  int enter_desc;
  int erase;
+ char events[1000];
+ int fastcopy;
+ int turnaround;
+ int skewprof;
  int write_error_count;
  int finish;
  int first_read;
  int force;
  int forceside;
+ int hash;
  int head_s;
  int head_f;
  int idrive_type;
  int ignore_errors;
  int info_file;
  int iside;
+ int jobs;
  int iside_not_support;
  int idstep;
  int idstep_used;
@@ -89,14 +167,20 @@ typedef struct disk_t
  int mediadesc;
  int nofill;
  int noformat;
+ int obuffer;
  int odrive_type;
  int odstep;
  int odstep_used;
  int oside;
  int oside_not_support;
  int overwrite;
+ int pairs;
+ int pipeline;
+ int profile;
+ int resume;
  int retries_l1;
  int retries_l2;
+ int sidecar;
  int start;
  int sfmode;
  int support_xread;
@@ -105,6 +189,8 @@ typedef struct disk_t
  int fd_workaround1;
  int fd_workaround2;
  int verbose;
+ int vote;
+ int vote_mode;
  int unattended;
  int unattended_retry_abort_max;
  int unattended_retry_sector_max;
@@ -117,10 +203,13 @@ typedef struct disk_t
  char otype[1000];
  char outcomp[1000];
  char signature[1000];
+ char sim[1000];
+ char trace[1000];
  int pskew0[PSKEW_SIZE];
  int pskew1[PSKEW_SIZE];
  int pskew0_opt;
  int pskew1_opt;
+ char pair[PAIRS_MAX][2000];
 }disk_t;
 
 typedef struct dg_opts_t
@@ -191,11 +280,106 @@ typedef struct info_t
 {
  int cyl_last;
  int head_last;
- int pos_trk;
- int pos_sec;
- int buf[INFO_SIZE];
+ int trk;              // map index of the last track, -1 if none
+ info_map_t map;
 }info_t;
 
+typedef struct track_plan_t
+{
+ int valid;
+ int side;             // side ID the format structure was made with
+ dsk_psect_t sectors;  // geometry values the entry was made with
+ size_t secsize;
+ dsk_psect_t secbase;
+ int fm;
+ dsk_gap_t fmtgap;
+ dsk_gap_t rwgap;
+ DSK_FORMAT *format;
+}track_plan_t;
+
+typedef struct rot_model_t
+{
+ double rev_ns;        // one revolution
+ double byte_ns;       // one byte under the head
+ double turn_ns;       // host/controller turnaround between sector reads
+ int header;           // bytes from the index to the first sector
+ int slot;             // bytes per sector including it's gaps
+ int busy;             // bytes from a sector's ID to the end of it's data
+ int *pos;             // physical position of each sector
+}rot_model_t;
+
+typedef struct retry_entry_t
+{
+ dsk_pcyl_t cyl;
+ dsk_phead_t head;
+ dsk_phead_t xhead;
+ int lsect;
+ dsk_psect_t sectors;  // track geometry when the sector failed
+ dsk_psect_t secbase;
+ size_t secsize;
+ int info_trk;         // info map track and sector of the status, -1 if none
+ int info_sec;
+}retry_entry_t;
+
+typedef struct vote_entry_t
+{
+ dsk_pcyl_t cyl;
+ dsk_phead_t head;
+ int psect;
+ int reads;            // number of good reads voted on
+ int agree;            // reads identical to the voted data
+ int differ;           // byte positions where the reads did not all agree
+ int min_votes;        // smallest majority for any byte
+ int fixed;            // bytes changed from the first good read
+}vote_entry_t;
+
+typedef struct pipe_slot_t
+{
+ dsk_pcyl_t cyl;
+ dsk_phead_t head;
+ dsk_phead_t xhead;
+ int fside;            // format side ID value, -1 if no format required
+ DSK_GEOMETRY dg;      // geometry snapshot taken when track was read
+ int *skew;
+ int skew_size;
+ uint8_t *buf;
+ size_t buf_size;
+ char *ckpt;           // checkpoint record written after the track
+ int info_trk;         // info map track, -1 if none
+ int failed;           // set by the writer if the track wasn't written
+}pipe_slot_t;
+
+typedef struct progress_t
+{
+ uint64_t start_ms;
+ uint64_t last_ms;     // time the progress line was last shown
+ int trk_start;        // first track of the disk
+ int trk_first;        // first track copied in this run (--resume)
+ int trk_finish;
+ int trk;              // current track
+ dsk_pcyl_t cyl;
+ dsk_phead_t head;
+ int lsect;
+ uint64_t sectors;     // sectors read and their size in bytes
+ uint64_t bytes;
+}progress_t;
+
+typedef struct batch_res_t
+{
+ int status;           // 0 converted, 1 skipped, -1 failed
+ int errors;
+ int retries;
+}batch_res_t;
+
+typedef struct batch_sum_t
+{
+ int done;
+ int ok;
+ int skipped;
+ int failed;
+ int errors;
+}batch_sum_t;
+
 typedef struct sup_t
 {
  int psecid;
@@ -207,6 +391,69 @@ typedef struct sup_t
  char version[101];
 }sup_t;
 
+typedef struct session_t
+{
+ disk_t disk;
+ dg_opts_t dg_opts;
+ xdg_t xdg;
+ DSK_GEOMETRY dg;
+ DSK_GEOMETRY cdg;
+ DSK_PDRIVER idrive;
+ DSK_PDRIVER odrive;
+ sup_t input_sup;
+ sup_t output_sup;
+ FILE *infof;
+ FILE *errorf;
+}session_t;
+
+#ifndef WIN32
+typedef struct pipe_t
+{
+ pipe_slot_t slots[PIPELINE_MAX];
+ session_t session;    // reader session the writer thread runs with
+ pthread_t thread;
+ pthread_mutex_t mutex;
+ pthread_cond_t cond_used;
+ pthread_cond_t cond_free;
+ int size;
+ int put;
+ int get;
+ int count;
+ int done;
+ int write_error_count;
+ FILE *ckptf;          // checkpoint journal
+ profile_t *prof;      // reader's profile (--profile) or NULL
+}pipe_t;
+#endif
+
+typedef struct pair_t
+{
+ int num;              // number the operator selects the pair with
+ char ifile[1000];
+ char ofile[1000];
+ char ofile_name[1000];  // output file of the current disk
+ session_t session;    // configured session the worker thread starts with
+#ifndef WIN32
+ pthread_t thread;
+#endif
+ int state;            // PAIR_* value
+ int start;            // operator has asked for the next disk to be copied
+ int stop;             // no more disks are to be copied
+ int abort;            // operator has asked for the current copy to abort
+ int trk;              // progress of the current disk
+ int trks;
+ int errors;
+ int disks;            // totals for the summary
+ int ok;
+ int skipped;
+ int failed;
+ int errors_tot;
+ int retries_tot;
+}pair_t;
+
+void session_save (session_t *s);
+void session_load (session_t *s);
+
 // gap flags
 #define FDC_DG_FMTGAP 0x3ffe
 #define FDC_AUTO_GAP 0x3fff